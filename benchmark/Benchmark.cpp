@@ -0,0 +1,386 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "pgmCompare.h"
+
+using namespace std;
+
+const int WARMUP_RUNS = 1;
+const int TIMED_RUNS = 5;
+
+//Command line flags
+struct BenchmarkOptions{
+
+	int warmup;
+	int runs;
+	string backend;
+	string config;
+	string imageName;
+	string outName;
+	string referenceName;
+	string outputName;
+	string heatmapName;
+	int tolerance;
+
+};
+
+//Summary of the timed runs of one command
+struct BenchmarkResult{
+
+	int width;
+	int height;
+	int bytesPerSample;
+	double min;
+	double median;
+	double p95;
+	double mean;
+	double megapixels;
+	double gigabytes;
+	bool verified;
+	Comparison comparison;
+
+};
+
+//Monotonic wall clock in seconds
+double wallTime(){
+
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec * 1e-9;
+
+}
+
+//Reads width, height and sample size from the PGM header, the engines
+//themselves are never linked in
+void readDimensions(const string &imageName, BenchmarkResult &result){
+
+	ifstream inFile;
+
+	inFile.open(imageName.c_str(), ios::binary | ios::in);
+
+	PGMImage image;
+	bool binary;
+
+	if(!inFile || !readPGMHeader(inFile, image, binary)){
+
+		cerr << "Error: " << imageName << " is not a PGM image." << endl;
+
+		exit(1002);
+
+	}
+
+	inFile.close();
+
+	result.width = image.width;
+	result.height = image.height;
+	result.bytesPerSample = image.maxPixelValue > 255 ? 2 : 1;
+
+}
+
+//Runs the command once with stdout discarded, returns its wall time.
+//A command that fails makes every number meaningless, so it stops the run
+double timeCommand(char **command){
+
+	double start = wallTime();
+
+	pid_t pid = fork();
+
+	if(pid < 0){
+
+		cerr << "Error: cannot start " << command[0] << endl;
+
+		exit(1);
+
+	}
+
+	if(pid == 0){
+
+		int devNull = open("/dev/null", O_WRONLY);
+
+		if(devNull >= 0) dup2(devNull, STDOUT_FILENO);
+
+		execvp(command[0], command);
+
+		cerr << "Error: cannot execute " << command[0] << endl;
+
+		_exit(127);
+
+	}
+
+	int status = 0;
+
+	waitpid(pid, &status, 0);
+
+	double elapsed = wallTime() - start;
+
+	if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+
+		cerr << "Error: " << command[0] << " failed with status "
+				<< (WIFEXITED(status) ? WEXITSTATUS(status) : -1) << endl;
+
+		exit(1);
+
+	}
+
+	return elapsed;
+
+}
+
+//Nearest rank percentile of sorted times
+double percentile(const vector<double> &sorted, double fraction){
+
+	int rank = (int)(fraction * sorted.size() + 0.999999);
+
+	if(rank < 1) rank = 1;
+
+	return sorted[rank - 1];
+
+}
+
+void benchmark(char **command, BenchmarkOptions &options, BenchmarkResult &result){
+
+	for(int w = 0; w < options.warmup; w++){
+
+		timeCommand(command);
+
+	}
+
+	vector<double> times(options.runs);
+
+	double total = 0.0;
+
+	for(int r = 0; r < options.runs; r++){
+
+		times[r] = timeCommand(command);
+
+		total += times[r];
+
+	}
+
+	sort(times.begin(), times.end());
+
+	int middle = options.runs / 2;
+
+	result.min = times[0];
+	result.median = options.runs % 2 == 1 ? times[middle] : (times[middle - 1] + times[middle]) / 2.0;
+	result.p95 = percentile(times, 0.95);
+	result.mean = total / options.runs;
+
+	//Every pixel is read once from the input and written once to the output
+	double pixels = (double)result.width * result.height;
+
+	result.megapixels = pixels / result.median * 1e-6;
+	result.gigabytes = 2.0 * pixels * result.bytesPerSample / result.median * 1e-9;
+
+	//The output of the last run is checked against the reference image
+	result.verified = !options.referenceName.empty();
+
+	if(result.verified){
+
+		PGMImage reference;
+		PGMImage output;
+
+		readPGM(options.referenceName, reference);
+		readPGM(options.outputName, output);
+
+		result.comparison = compareImages(reference, output);
+
+		if(!options.heatmapName.empty()) writeHeatmap(options.heatmapName, reference, output, result.comparison);
+
+	}
+
+}
+
+//Appends one record per command. Files ending in .json get one JSON object
+//per line, any other name a semicolon separated CSV with its header written
+//once, so every backend script can share the same results file
+void writeResult(BenchmarkOptions &options, BenchmarkResult &result){
+
+	bool json = options.outName.size() >= 5
+			&& options.outName.compare(options.outName.size() - 5, 5, ".json") == 0;
+
+	FILE *fp = options.outName.empty() ? stdout : fopen(options.outName.c_str(), "a");
+
+	if(!fp){
+
+		cerr << "Error: cannot write " << options.outName << endl;
+
+		exit(1);
+
+	}
+
+	if(json){
+
+		fprintf(fp, "{\"backend\": \"%s\", \"config\": \"%s\", \"image\": \"%s\", \"width\": %d, \"height\": %d,"
+				" \"warmup\": %d, \"runs\": %d, \"min_s\": %.6f, \"median_s\": %.6f, \"p95_s\": %.6f,"
+				" \"mean_s\": %.6f, \"mpix_s\": %.3f, \"gb_s\": %.6f",
+				options.backend.c_str(), options.config.c_str(), options.imageName.c_str(),
+				result.width, result.height, options.warmup, options.runs, result.min, result.median,
+				result.p95, result.mean, result.megapixels, result.gigabytes);
+
+		//Identical images have no finite PSNR, JSON gets null for it
+		if(result.verified){
+
+			fprintf(fp, ", \"exact_pct\": %.4f, \"max_diff\": %d, \"psnr_db\": ",
+					result.comparison.exactPercent(), result.comparison.maxDiff);
+
+			if(isinf(result.comparison.psnr)) fprintf(fp, "null");
+			else fprintf(fp, "%.2f", result.comparison.psnr);
+
+		}
+
+		fprintf(fp, "}\n");
+
+	}else{
+
+		if(fp != stdout) fseek(fp, 0, SEEK_END);
+
+		if(fp == stdout || ftell(fp) == 0){
+
+			fprintf(fp, "backend;config;image;width;height;warmup;runs;min_s;median_s;p95_s;mean_s;mpix_s;gb_s;"
+					"exact_pct;max_diff;psnr_db\n");
+
+		}
+
+		fprintf(fp, "%s;%s;%s;%d;%d;%d;%d;%.6f;%.6f;%.6f;%.6f;%.3f;%.6f;",
+				options.backend.c_str(), options.config.c_str(), options.imageName.c_str(),
+				result.width, result.height, options.warmup, options.runs, result.min, result.median,
+				result.p95, result.mean, result.megapixels, result.gigabytes);
+
+		//Verification columns stay empty without -reference
+		if(result.verified){
+
+			fprintf(fp, "%.4f;%d;%.2f\n", result.comparison.exactPercent(), result.comparison.maxDiff,
+					result.comparison.psnr);
+
+		}else{
+
+			fprintf(fp, ";;\n");
+
+		}
+
+	}
+
+	if(fp != stdout) fclose(fp);
+
+}
+
+int main(int argc, char **argv){
+
+	string usage = "Usage: Benchmark -backend name -image imageName.pgm [-config label] [-warmup runs]"
+			" [-runs runs] [-out results.csv|results.json] [-reference reference.pgm -output output.pgm"
+			" [-tolerance maxDiff] [-heatmap diff.pgm]] -- command [arguments ...]\n";
+
+	BenchmarkOptions options;
+
+	options.warmup = WARMUP_RUNS;
+	options.runs = TIMED_RUNS;
+	options.tolerance = 0;
+
+	int arg = 1;
+
+	//Everything after -- is the engine command line
+	while(arg < argc && strcmp(argv[arg], "--") != 0){
+
+		if(arg + 1 >= argc){
+
+			cerr << usage;
+
+			return 1;
+
+		}
+
+		if(strcmp(argv[arg], "-backend") == 0){
+
+			options.backend = argv[arg + 1];
+
+		}else if(strcmp(argv[arg], "-config") == 0){
+
+			options.config = argv[arg + 1];
+
+		}else if(strcmp(argv[arg], "-image") == 0){
+
+			options.imageName = argv[arg + 1];
+
+		}else if(strcmp(argv[arg], "-warmup") == 0){
+
+			options.warmup = atoi(argv[arg + 1]);
+
+		}else if(strcmp(argv[arg], "-runs") == 0){
+
+			options.runs = atoi(argv[arg + 1]);
+
+		}else if(strcmp(argv[arg], "-out") == 0){
+
+			options.outName = argv[arg + 1];
+
+		}else if(strcmp(argv[arg], "-reference") == 0){
+
+			options.referenceName = argv[arg + 1];
+
+		}else if(strcmp(argv[arg], "-output") == 0){
+
+			options.outputName = argv[arg + 1];
+
+		}else if(strcmp(argv[arg], "-tolerance") == 0){
+
+			options.tolerance = atoi(argv[arg + 1]);
+
+		}else if(strcmp(argv[arg], "-heatmap") == 0){
+
+			options.heatmapName = argv[arg + 1];
+
+		}else{
+
+			cerr << usage;
+
+			return 1;
+
+		}
+
+		arg += 2;
+
+	}
+
+	if(arg + 1 >= argc || options.backend.empty() || options.imageName.empty()
+			|| options.warmup < 0 || options.runs < 1
+			|| options.referenceName.empty() != options.outputName.empty()){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	BenchmarkResult result;
+
+	readDimensions(options.imageName, result);
+
+	benchmark(&argv[arg + 1], options, result);
+
+	writeResult(options, result);
+
+	//The record is kept, but a wrong output fails the script that ran it
+	if(result.verified && result.comparison.maxDiff > options.tolerance){
+
+		cerr << "Error: " << options.backend << " differs from " << options.referenceName
+				<< " by up to " << result.comparison.maxDiff << endl;
+
+		return 1;
+
+	}
+
+	return 0;
+}
@@ -0,0 +1,245 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+using namespace std;
+
+const int CHECKER_CELL = 32;
+const int FRACTAL_CELL = 256;
+const int FRACTAL_OCTAVES = 6;
+const int ASCII_VALUES_PER_LINE = 16;
+
+//Test image content
+enum Pattern{NOISE, GRADIENT, CHECKER, FRACTAL};
+
+//Command line flags
+struct GenerateOptions{
+
+	int width;
+	int height;
+	string outName;
+	Pattern pattern;
+	uint64_t seed;
+	int cell;
+	bool ascii;
+
+};
+
+//Stateless 64 bit mix of a lattice point, the same inputs always give the
+//same value so any row can be produced without the previous ones
+uint64_t hashPoint(uint64_t x, uint64_t y, uint64_t seed){
+
+	uint64_t z = seed + x * 0x9E3779B97F4A7C15ULL + y * 0xC2B2AE3D27D4EB4FULL;
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+	return z ^ (z >> 31);
+
+}
+
+//Lattice value in [0, 1)
+double latticeValue(int64_t x, int64_t y, uint64_t seed){
+
+	return (hashPoint(x, y, seed) >> 11) * (1.0 / 9007199254740992.0);
+
+}
+
+//Value noise summed over octaves, each one with half the cell size and half
+//the amplitude of the previous one, gives a cloud-like natural texture
+double fractalValue(int x, int y, int cell, uint64_t seed){
+
+	double value = 0.0;
+	double amplitude = 0.5;
+	double total = 0.0;
+
+	for(int octave = 0; octave < FRACTAL_OCTAVES && cell > 0; octave++){
+
+		int64_t cx = x / cell;
+		int64_t cy = y / cell;
+
+		double fx = (double)(x % cell) / cell;
+		double fy = (double)(y % cell) / cell;
+
+		//Smoothstep hides the lattice
+		fx = fx * fx * (3.0 - 2.0 * fx);
+		fy = fy * fy * (3.0 - 2.0 * fy);
+
+		uint64_t octaveSeed = seed + octave;
+
+		double top = latticeValue(cx, cy, octaveSeed) * (1.0 - fx) + latticeValue(cx + 1, cy, octaveSeed) * fx;
+		double bottom = latticeValue(cx, cy + 1, octaveSeed) * (1.0 - fx) + latticeValue(cx + 1, cy + 1, octaveSeed) * fx;
+
+		value += amplitude * (top * (1.0 - fy) + bottom * fy);
+		total += amplitude;
+
+		amplitude /= 2.0;
+		cell /= 2;
+
+	}
+
+	return value / total;
+
+}
+
+int pixelValue(int x, int y, GenerateOptions &options){
+
+	switch(options.pattern){
+
+	case NOISE:
+
+		return hashPoint(x, y, options.seed) & 255;
+
+	case GRADIENT:
+
+		//Diagonal ramp from 0 in the top left corner to 255 in the bottom right
+		return (int)(((int64_t)x * 255 / (options.width > 1 ? options.width - 1 : 1)
+				+ (int64_t)y * 255 / (options.height > 1 ? options.height - 1 : 1)) / 2);
+
+	case CHECKER:
+
+		return ((x / options.cell + y / options.cell) & 1) * 255;
+
+	default:
+
+		return (int)(fractalValue(x, y, options.cell, options.seed) * 255.0 + 0.5);
+
+	}
+
+}
+
+//Writes the image one row at a time so sizes far beyond memory can be produced
+void generate(GenerateOptions &options){
+
+	FILE *fp = fopen(options.outName.c_str(), "wb");
+
+	if(!fp){
+
+		cerr << "Error: cannot write " << options.outName << endl;
+
+		exit(1);
+
+	}
+
+	fprintf(fp, "%s\n# Created by GeneratePGM\n%d %d\n255\n", options.ascii ? "P2" : "P5",
+			options.width, options.height);
+
+	unsigned char * row = new unsigned char[options.width];
+
+	for(int y = 0; y < options.height; y++){
+
+		for(int x = 0; x < options.width; x++){
+
+			row[x] = (unsigned char)pixelValue(x, y, options);
+
+		}
+
+		if(options.ascii){
+
+			for(int x = 0; x < options.width; x++){
+
+				//Plain PGM lines should stay under 70 characters
+				fprintf(fp, "%d%c", row[x],
+						(x + 1) % ASCII_VALUES_PER_LINE == 0 || x + 1 == options.width ? '\n' : ' ');
+
+			}
+
+		}else if(fwrite(row, 1, options.width, fp) != (size_t)options.width){
+
+			cerr << "Error: cannot write " << options.outName << endl;
+
+			exit(1);
+
+		}
+
+	}
+
+	delete[] row;
+
+	fclose(fp);
+
+}
+
+int main(int argc, char **argv){
+
+	string usage = "Usage: GeneratePGM width height output.pgm [-pattern noise|gradient|checker|fractal]"
+			" [-seed n] [-cell pixels] [-ascii]\n";
+
+	if(argc < 4){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	GenerateOptions options;
+
+	options.width = atoi(argv[1]);
+	options.height = atoi(argv[2]);
+	options.outName = argv[3];
+	options.pattern = FRACTAL;
+	options.seed = 1;
+	options.cell = 0;
+	options.ascii = false;
+
+	//Optional flags follow the positional arguments
+	for(int arg = 4; arg < argc; arg++){
+
+		if(strcmp(argv[arg], "-pattern") == 0 && arg + 1 < argc){
+
+			string pattern = argv[++arg];
+
+			if(pattern == "noise") options.pattern = NOISE;
+			else if(pattern == "gradient") options.pattern = GRADIENT;
+			else if(pattern == "checker") options.pattern = CHECKER;
+			else if(pattern == "fractal") options.pattern = FRACTAL;
+			else{
+
+				cerr << usage;
+
+				return 1;
+
+			}
+
+		}else if(strcmp(argv[arg], "-seed") == 0 && arg + 1 < argc){
+
+			options.seed = strtoull(argv[++arg], NULL, 10);
+
+		}else if(strcmp(argv[arg], "-cell") == 0 && arg + 1 < argc){
+
+			options.cell = atoi(argv[++arg]);
+
+		}else if(strcmp(argv[arg], "-ascii") == 0){
+
+			options.ascii = true;
+
+		}else{
+
+			cerr << usage;
+
+			return 1;
+
+		}
+
+	}
+
+	if(options.cell <= 0) options.cell = options.pattern == CHECKER ? CHECKER_CELL : FRACTAL_CELL;
+
+	if(options.width <= 0 || options.height <= 0){
+
+		cerr << "Error: width and height must be positive" << endl;
+
+		return 1;
+
+	}
+
+	generate(options);
+
+	return 0;
+}
@@ -0,0 +1,319 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "pgmCompare.h"
+#include "../openmp/edgeKernels.h"
+#include "../openmp/magnitude.h"
+
+using namespace std;
+
+//Largest Sobel gradient of an 8 bit image, 4 * 255
+const int MAX_GRADIENT = 1020;
+
+//Command line flags
+struct AccuracyOptions{
+
+	string imageName;
+	int threshold;
+	string outName;
+
+};
+
+//Error of one mode over every gradient, and on the image when one is given
+struct ModeAccuracy{
+
+	MagnitudeMode mode;
+	const char *name;
+
+	//Relative to the real valued sqrt, over nonzero gradients
+	double maxOverPercent;
+	double maxUnderPercent;
+	double meanAbsPercent;
+
+	//Scaled output against the exact output
+	bool image;
+	Comparison comparison;
+	double edgeAgreePercent;
+
+};
+
+//Every (xG, yG) with |xG|, |yG| <= MAX_GRADIENT. Errors are against the
+//real root, so exact shows the truncation to int alone, 29% at (1, 1). The
+//lut mode is measured on the root its table holds
+void gradientAccuracy(ModeAccuracy &accuracy){
+
+	double maxOver = 0.0;
+	double maxUnder = 0.0;
+	double sumAbs = 0.0;
+	long long count = 0;
+
+	#pragma omp parallel for reduction(max:maxOver) reduction(max:maxUnder) reduction(+:sumAbs) reduction(+:count)
+	for(int xG = -MAX_GRADIENT; xG <= MAX_GRADIENT; xG++){
+
+		for(int yG = -MAX_GRADIENT; yG <= MAX_GRADIENT; yG++){
+
+			if(xG == 0 && yG == 0) continue;
+
+			double real = sqrt((double)xG * xG + (double)yG * yG);
+
+			int value = magnitudePixel(xG, yG, accuracy.mode);
+
+			if(accuracy.mode == MAGNITUDE_LUT) value = (int)sqrt((double)value);
+
+			double error = (value - real) / real;
+
+			if(error > maxOver) maxOver = error;
+			if(-error > maxUnder) maxUnder = -error;
+
+			sumAbs += fabs(error);
+			count++;
+
+		}
+
+	}
+
+	accuracy.maxOverPercent = 100.0 * maxOver;
+	accuracy.maxUnderPercent = 100.0 * maxUnder;
+	accuracy.meanAbsPercent = 100.0 * sumAbs / count;
+
+}
+
+//Sobel and scaling as the OpenMP engine runs them for the mode
+void scaledOutput(const PGMImage &input, MagnitudeMode mode, PGMImage &output){
+
+	int width = input.width;
+	int height = input.height;
+	unsigned int count = width * height;
+
+	output.width = width;
+	output.height = height;
+	output.maxPixelValue = 255;
+	output.pixels.resize(count);
+
+	int *pixels = &output.pixels[0];
+
+	sobelMagnitude(mode, &input.pixels[0], pixels, width, height, omp_get_max_threads());
+
+	if(mode == MAGNITUDE_LUT){
+
+		int minSquared = 255 * 255;
+		int maxSquared = 0;
+
+		findMinMaxOpenMP(pixels, count, minSquared, maxSquared, omp_get_max_threads());
+
+		scaleSquaredOpenMP(pixels, count, maxSquared, (int)sqrt((double)minSquared), (int)sqrt((double)maxSquared),
+				omp_get_max_threads());
+
+	}else{
+
+		int minpix = 255;
+		int maxpix = 0;
+
+		findMinMaxOpenMP(pixels, count, minpix, maxpix, omp_get_max_threads());
+
+		scaleSimd(pixels, count, minpix, maxpix, omp_get_max_threads());
+
+	}
+
+}
+
+//Scaled images against exact, and the share of pixels on the same side of
+//the edge threshold
+void imageAccuracy(ModeAccuracy &accuracy, const PGMImage &input, const PGMImage &exact, int threshold){
+
+	PGMImage output;
+
+	scaledOutput(input, accuracy.mode, output);
+
+	accuracy.image = true;
+	accuracy.comparison = compareImages(exact, output);
+
+	long long agree = 0;
+
+	for(unsigned int i = 0; i < output.pixels.size(); i++){
+
+		agree += (exact.pixels[i] >= threshold) == (output.pixels[i] >= threshold);
+
+	}
+
+	accuracy.edgeAgreePercent = 100.0 * agree / output.pixels.size();
+
+}
+
+void writeResults(const AccuracyOptions &options, const vector<ModeAccuracy> &results){
+
+	printf("%-8s %10s %10s %10s %10s %8s %10s\n", "mode", "over_pct", "under_pct", "mean_pct",
+			"exact_pct", "max_diff", "agree_pct");
+
+	for(unsigned int m = 0; m < results.size(); m++){
+
+		const ModeAccuracy &result = results[m];
+
+		printf("%-8s %10.3f %10.3f %10.3f", result.name, result.maxOverPercent, result.maxUnderPercent,
+				result.meanAbsPercent);
+
+		if(result.image){
+
+			printf(" %10.3f %8d %10.3f", result.comparison.exactPercent(), result.comparison.maxDiff,
+					result.edgeAgreePercent);
+
+		}
+
+		printf("\n");
+
+	}
+
+	if(options.outName.empty()) return;
+
+	bool json = options.outName.size() >= 5
+			&& options.outName.compare(options.outName.size() - 5, 5, ".json") == 0;
+
+	FILE *fp = fopen(options.outName.c_str(), "a");
+
+	if(!fp){
+
+		cerr << "Error: cannot write " << options.outName << endl;
+
+		exit(1);
+
+	}
+
+	fseek(fp, 0, SEEK_END);
+
+	if(!json && ftell(fp) == 0){
+
+		fprintf(fp, "mode;max_over_pct;max_under_pct;mean_abs_pct;image;exact_pct;max_diff;psnr_db;"
+				"threshold;edge_agree_pct\n");
+
+	}
+
+	for(unsigned int m = 0; m < results.size(); m++){
+
+		const ModeAccuracy &result = results[m];
+
+		if(json){
+
+			fprintf(fp, "{\"mode\": \"%s\", \"max_over_pct\": %.4f, \"max_under_pct\": %.4f,"
+					" \"mean_abs_pct\": %.4f", result.name, result.maxOverPercent, result.maxUnderPercent,
+					result.meanAbsPercent);
+
+			//Identical images have no finite PSNR, JSON gets null for it
+			if(result.image){
+
+				fprintf(fp, ", \"image\": \"%s\", \"exact_pct\": %.4f, \"max_diff\": %d, \"psnr_db\": ",
+						options.imageName.c_str(), result.comparison.exactPercent(), result.comparison.maxDiff);
+
+				if(isinf(result.comparison.psnr)) fprintf(fp, "null");
+				else fprintf(fp, "%.2f", result.comparison.psnr);
+
+				fprintf(fp, ", \"threshold\": %d, \"edge_agree_pct\": %.4f", options.threshold,
+						result.edgeAgreePercent);
+
+			}
+
+			fprintf(fp, "}\n");
+
+		}else{
+
+			fprintf(fp, "%s;%.4f;%.4f;%.4f;", result.name, result.maxOverPercent, result.maxUnderPercent,
+					result.meanAbsPercent);
+
+			//Image columns stay empty without -image
+			if(result.image){
+
+				fprintf(fp, "%s;%.4f;%d;%.2f;%d;%.4f\n", options.imageName.c_str(),
+						result.comparison.exactPercent(), result.comparison.maxDiff, result.comparison.psnr,
+						options.threshold, result.edgeAgreePercent);
+
+			}else{
+
+				fprintf(fp, ";;;;;\n");
+
+			}
+
+		}
+
+	}
+
+	fclose(fp);
+
+}
+
+int main(int argc, char **argv){
+
+	string usage = "Usage: MagnitudeAccuracy [-image image.pgm] [-threshold value]"
+			" [-out results.csv|results.json]\n";
+
+	AccuracyOptions options;
+
+	options.threshold = 64;
+
+	for(int arg = 1; arg < argc; arg++){
+
+		if(strcmp(argv[arg], "-image") == 0 && arg + 1 < argc){
+
+			options.imageName = argv[++arg];
+
+		}else if(strcmp(argv[arg], "-threshold") == 0 && arg + 1 < argc){
+
+			options.threshold = atoi(argv[++arg]);
+
+		}else if(strcmp(argv[arg], "-out") == 0 && arg + 1 < argc){
+
+			options.outName = argv[++arg];
+
+		}else{
+
+			cerr << usage;
+
+			return 1;
+
+		}
+
+	}
+
+	const MagnitudeMode modes[] = {MAGNITUDE_EXACT, MAGNITUDE_L1, MAGNITUDE_MAXMIN, MAGNITUDE_LUT};
+	const char *names[] = {ExactMagnitude::NAME, L1Magnitude::NAME, MaxMinMagnitude::NAME, SquaredMagnitude::NAME};
+
+	PGMImage input;
+	PGMImage exact;
+
+	if(!options.imageName.empty()){
+
+		readPGM(options.imageName, input);
+
+		if(input.maxPixelValue > 255 || input.width < 3 || input.height < 3){
+
+			cerr << "Error: " << options.imageName << " is not an 8 bit image of at least 3x3" << endl;
+
+			return 1;
+
+		}
+
+		scaledOutput(input, MAGNITUDE_EXACT, exact);
+
+	}
+
+	vector<ModeAccuracy> results(4);
+
+	for(int m = 0; m < 4; m++){
+
+		results[m].mode = modes[m];
+		results[m].name = names[m];
+		results[m].image = false;
+
+		gradientAccuracy(results[m]);
+
+		if(!options.imageName.empty()) imageAccuracy(results[m], input, exact, options.threshold);
+
+	}
+
+	writeResults(options, results);
+
+	return 0;
+}
@@ -0,0 +1,795 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <omp.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#ifdef USE_OPENCL
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
+#include <CL/cl.h>
+#endif
+#include "../openmp/edgeKernels.h"
+#include "../openmp/stencil.h"
+#include "../openmp/blur.h"
+#include "../openmp/magnitude.h"
+
+using namespace std;
+
+//Every measurement repeats its kernel until it has run this long
+const double MIN_TIME = 0.2;
+const int DEFAULT_SIZES[3][2] = {{256, 256}, {1024, 1024}, {4096, 4096}};
+
+//Command line flags
+struct MicroOptions{
+
+	vector<int> widths;
+	vector<int> heights;
+	int threads;
+	string filter;
+	string outName;
+
+};
+
+//One kernel, implementation and size
+struct Measurement{
+
+	string kernel;
+	string implementation;
+	int width;
+	int height;
+	int threads;
+	long long iterations;
+	double nsPerPixel;
+	double bytesPerCycle;
+	bool matches;
+
+};
+
+//Monotonic wall clock in seconds
+double wallTime(){
+
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec * 1e-9;
+
+}
+
+//Time stamp counter, constant rate reference cycles on x86, 0 elsewhere
+uint64_t cycleCount(){
+
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+
+}
+
+//Deterministic 8 bit noise, the worst case for branch prediction
+void fillNoise(int *pixels, unsigned int count){
+
+	uint32_t state = 12345;
+
+	for(unsigned int i = 0; i < count; i++){
+
+		state = state * 1664525u + 1013904223u;
+
+		pixels[i] = state >> 24;
+
+	}
+
+}
+
+//Interface every measured kernel implements. prepare restores the input
+//when the kernel works in place and is not part of the time
+class MicroKernel{
+
+public:
+
+	virtual ~MicroKernel(){}
+
+	virtual void prepare(){}
+	virtual void run() = 0;
+
+	//Bytes the kernel has to move per pixel at the least
+	virtual double bytesPerPixel() = 0;
+
+};
+
+//Runs the kernel with doubling iteration counts until MIN_TIME is reached
+void measure(MicroKernel &kernel, Measurement &measurement){
+
+	long long iterations = 1;
+
+	double elapsed = 0.0;
+	uint64_t cycles = 0;
+
+	kernel.prepare();
+	kernel.run();
+
+	while(true){
+
+		elapsed = 0.0;
+		cycles = 0;
+
+		for(long long i = 0; i < iterations; i++){
+
+			kernel.prepare();
+
+			double start = wallTime();
+			uint64_t startCycles = cycleCount();
+
+			kernel.run();
+
+			cycles += cycleCount() - startCycles;
+			elapsed += wallTime() - start;
+
+		}
+
+		if(elapsed >= MIN_TIME || iterations >= (1LL << 30)) break;
+
+		iterations *= 2;
+
+	}
+
+	double pixels = (double)measurement.width * measurement.height * iterations;
+
+	measurement.iterations = iterations;
+	measurement.nsPerPixel = elapsed * 1e9 / pixels;
+	measurement.bytesPerCycle = cycles > 0 ? kernel.bytesPerPixel() * pixels / cycles : -1.0;
+
+}
+
+//Sobel kernels read the image and write the gradient image
+class SobelKernel: public MicroKernel{
+
+public:
+
+	SobelKernel(const string &i, const int *in, int *o, int w, int h, int t):
+		implementation(i), input(in), output(o), width(w), height(h), threads(t){}
+
+	void run(){
+
+		if(implementation == "scalar") sobelScalar(input, output, width, height);
+		else if(implementation == "openmp") sobelOpenMP(input, output, width, height, threads);
+		else if(implementation == "separable") sobelSeparable(input, output, width, height, threads);
+		else if(implementation == "stencil") stencilOpenMP<SobelOperator>(input, output, width, height, threads);
+		else sobelSimd(input, output, width, height, threads);
+
+	}
+
+	double bytesPerPixel(){return 2 * sizeof(int);}
+
+private:
+
+	string implementation;
+	const int *input;
+	int *output;
+	int width;
+	int height;
+	int threads;
+
+};
+
+//Sobel with an approximate magnitude, the scalar loop picks the mode per
+//pixel and the simd one has it inlined
+class MagnitudeKernel: public MicroKernel{
+
+public:
+
+	MagnitudeKernel(MagnitudeMode m, bool s, const int *in, int *o, int w, int h, int t):
+		mode(m), scalar(s), input(in), output(o), width(w), height(h), threads(t){}
+
+	void run(){
+
+		if(scalar) sobelMagnitudeScalar(input, output, width, height, mode);
+		else sobelMagnitude(mode, input, output, width, height, threads);
+
+	}
+
+	double bytesPerPixel(){return 2 * sizeof(int);}
+
+private:
+
+	MagnitudeMode mode;
+	bool scalar;
+	const int *input;
+	int *output;
+	int width;
+	int height;
+	int threads;
+
+};
+
+//In place box blur on a copy of the input, one implementation per sigma
+//to show the cost does not grow with it
+class BlurKernel: public MicroKernel{
+
+public:
+
+	BlurKernel(double s, const int *in, int *o, int w, int h, int t):
+		sigma(s), input(in), output(o), width(w), height(h), threads(t){}
+
+	void prepare(){memcpy(output, input, width * height * sizeof(int));}
+
+	void run(){boxBlurOpenMP(output, width, height, sigma, threads);}
+
+	double bytesPerPixel(){return 2 * sizeof(int);}
+
+private:
+
+	double sigma;
+	const int *input;
+	int *output;
+	int width;
+	int height;
+	int threads;
+
+};
+
+//Min and max, scalar runs findMin and findMax as two passes like the engine
+class MinMaxKernel: public MicroKernel{
+
+public:
+
+	MinMaxKernel(const string &i, const int *in, unsigned int c, int t):
+		implementation(i), input(in), count(c), threads(t), minpix(0), maxpix(0){}
+
+	void run(){
+
+		if(implementation == "scalar"){
+
+			minpix = findMinimum(input, count, 255);
+			maxpix = findMaximum(input, count, 0);
+
+		}else{
+
+			minpix = 255;
+			maxpix = 0;
+
+			findMinMaxOpenMP(input, count, minpix, maxpix, threads);
+
+		}
+
+	}
+
+	double bytesPerPixel(){return sizeof(int);}
+
+	const string implementation;
+	const int *input;
+	unsigned int count;
+	int threads;
+	int minpix;
+	int maxpix;
+
+};
+
+//Scaling works in place on a copy of the gradient image
+class ScaleKernel: public MicroKernel{
+
+public:
+
+	ScaleKernel(const string &i, const int *in, int *o, unsigned int c, int mn, int mx, int t):
+		implementation(i), input(in), output(o), count(c), minpix(mn), maxpix(mx), threads(t){}
+
+	void prepare(){memcpy(output, input, count * sizeof(int));}
+
+	void run(){
+
+		if(implementation == "scalar") scaleScalar(output, count, minpix, maxpix);
+		else if(implementation == "openmp") scaleOpenMP(output, count, minpix, maxpix, threads);
+		else scaleSimd(output, count, minpix, maxpix, threads);
+
+	}
+
+	double bytesPerPixel(){return 2 * sizeof(int);}
+
+private:
+
+	string implementation;
+	const int *input;
+	int *output;
+	unsigned int count;
+	int minpix;
+	int maxpix;
+	int threads;
+
+};
+
+//The in-memory part of readImage and writeImage, without the stream
+class PackKernel: public MicroKernel{
+
+public:
+
+	PackKernel(bool u, unsigned char *b, int *p, unsigned int c):
+		unpack(u), bytes(b), pixels(p), count(c){}
+
+	void run(){
+
+		if(unpack) unpackPixels(bytes, pixels, count);
+		else packPixels(pixels, bytes, count);
+
+	}
+
+	double bytesPerPixel(){return 1 + sizeof(int);}
+
+private:
+
+	bool unpack;
+	unsigned char *bytes;
+	int *pixels;
+	unsigned int count;
+
+};
+
+#ifdef USE_OPENCL
+//The Sobel kernel of the OpenCL engine on the first CPU device, buffers stay
+//on the device so only the kernel is timed
+class OpenCLSobelKernel: public MicroKernel{
+
+public:
+
+	OpenCLSobelKernel(const int *input, int w, int h):
+		width(w), height(h), context(NULL), queue(NULL), program(NULL), kernel(NULL),
+		d_pixels(NULL), d_tempImage(NULL), available(false){
+
+		cl_platform_id platforms[8];
+		cl_uint numPlatforms = 0;
+		cl_device_id device = NULL;
+
+		clGetPlatformIDs(8, platforms, &numPlatforms);
+
+		for(cl_uint p = 0; p < numPlatforms && device == NULL; p++){
+
+			if(clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_CPU, 1, &device, NULL) != CL_SUCCESS) device = NULL;
+
+		}
+
+		FILE *fp = fopen("../opencl/EdgeDetectionOpenCL.cl", "r");
+
+		if(device == NULL || !fp){
+
+			if(fp) fclose(fp);
+
+			cerr << "Warning: no OpenCL CPU device or kernel source, skipping opencl_cpu." << endl;
+
+			return;
+
+		}
+
+		vector<char> source(0x100000);
+		size_t sourceSize = fread(&source[0], 1, source.size(), fp);
+		fclose(fp);
+
+		const char *sourcePointer = &source[0];
+		size_t size = (size_t)width * height * sizeof(int);
+		imageSize = width * height;
+		cl_int ret;
+
+		context = clCreateContext(NULL, 1, &device, NULL, NULL, &ret);
+		queue = clCreateCommandQueue(context, device, 0, &ret);
+		program = clCreateProgramWithSource(context, 1, &sourcePointer, &sourceSize, &ret);
+
+		if(clBuildProgram(program, 1, &device, NULL, NULL, NULL) != CL_SUCCESS){
+
+			cerr << "Warning: cannot build the OpenCL kernels, skipping opencl_cpu." << endl;
+
+			return;
+
+		}
+
+		kernel = clCreateKernel(program, "edgeDetectionOpenCL", &ret);
+		d_pixels = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, size, (void *)input, &ret);
+		d_tempImage = clCreateBuffer(context, CL_MEM_WRITE_ONLY, size, NULL, &ret);
+
+		clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_pixels);
+		clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_tempImage);
+		clSetKernelArg(kernel, 2, sizeof(int), &width);
+		clSetKernelArg(kernel, 3, sizeof(int), &height);
+		clSetKernelArg(kernel, 4, sizeof(int), &imageSize);
+
+		available = true;
+
+	}
+	~OpenCLSobelKernel(){
+
+		if(d_pixels) clReleaseMemObject(d_pixels);
+		if(d_tempImage) clReleaseMemObject(d_tempImage);
+		if(kernel) clReleaseKernel(kernel);
+		if(program) clReleaseProgram(program);
+		if(queue) clReleaseCommandQueue(queue);
+		if(context) clReleaseContext(context);
+
+	}
+
+	void run(){
+
+		size_t local = 256;
+		size_t global = ((imageSize + local - 1) / local) * local;
+
+		clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global, &local, 0, NULL, NULL);
+		clFinish(queue);
+
+	}
+
+	void read(int *output){
+
+		clEnqueueReadBuffer(queue, d_tempImage, CL_TRUE, 0, (size_t)imageSize * sizeof(int), output, 0, NULL, NULL);
+
+	}
+
+	double bytesPerPixel(){return 2 * sizeof(int);}
+
+	int width;
+	int height;
+	int imageSize;
+	cl_context context;
+	cl_command_queue queue;
+	cl_program program;
+	cl_kernel kernel;
+	cl_mem d_pixels;
+	cl_mem d_tempImage;
+	bool available;
+
+};
+#endif
+
+void report(Measurement &measurement, MicroOptions &options){
+
+	char name[128];
+
+	snprintf(name, sizeof(name), "%s/%s/%dx%d/%d", measurement.kernel.c_str(), measurement.implementation.c_str(),
+			measurement.width, measurement.height, measurement.threads);
+
+	printf("%-40s %12.4f %14.4f %12lld %s\n", name, measurement.nsPerPixel, measurement.bytesPerCycle,
+			measurement.iterations, measurement.matches ? "" : "MISMATCH");
+
+	if(options.outName.empty()) return;
+
+	bool json = options.outName.size() >= 5
+			&& options.outName.compare(options.outName.size() - 5, 5, ".json") == 0;
+
+	FILE *fp = fopen(options.outName.c_str(), "a");
+
+	if(!fp){
+
+		cerr << "Error: cannot write " << options.outName << endl;
+
+		exit(1);
+
+	}
+
+	fseek(fp, 0, SEEK_END);
+
+	if(json){
+
+		fprintf(fp, "{\"kernel\": \"%s\", \"implementation\": \"%s\", \"width\": %d, \"height\": %d, \"threads\": %d,"
+				" \"iterations\": %lld, \"ns_per_pixel\": %.6f, \"bytes_per_cycle\": %.6f, \"matches\": %s}\n",
+				measurement.kernel.c_str(), measurement.implementation.c_str(), measurement.width, measurement.height,
+				measurement.threads, measurement.iterations, measurement.nsPerPixel, measurement.bytesPerCycle,
+				measurement.matches ? "true" : "false");
+
+	}else{
+
+		if(ftell(fp) == 0){
+
+			fprintf(fp, "kernel;implementation;width;height;threads;iterations;ns_per_pixel;bytes_per_cycle;matches\n");
+
+		}
+
+		fprintf(fp, "%s;%s;%d;%d;%d;%lld;%.6f;%.6f;%d\n", measurement.kernel.c_str(),
+				measurement.implementation.c_str(), measurement.width, measurement.height, measurement.threads,
+				measurement.iterations, measurement.nsPerPixel, measurement.bytesPerCycle, measurement.matches ? 1 : 0);
+
+	}
+
+	fclose(fp);
+
+}
+
+bool selected(MicroOptions &options, const string &kernel){
+
+	return options.filter.empty() || kernel.find(options.filter) != string::npos;
+
+}
+
+//Every kernel and implementation on one image size, results are checked
+//against the scalar implementation
+void runSize(int width, int height, MicroOptions &options){
+
+	unsigned int count = width * height;
+
+	vector<int> input(count);
+	vector<int> reference(count);
+	vector<int> output(count);
+	vector<unsigned char> bytes(count);
+
+	fillNoise(&input[0], count);
+
+	sobelScalar(&input[0], &reference[0], width, height);
+
+	const char *implementations[3] = {"scalar", "openmp", "simd"};
+	const char *sobelImplementations[5] = {"scalar", "openmp", "separable", "simd", "stencil"};
+
+	Measurement measurement;
+
+	measurement.width = width;
+	measurement.height = height;
+
+	if(selected(options, "sobel")){
+
+		for(int i = 0; i < 5; i++){
+
+			SobelKernel kernel(sobelImplementations[i], &input[0], &output[0], width, height, options.threads);
+
+			measurement.kernel = "sobel";
+			measurement.implementation = sobelImplementations[i];
+			measurement.threads = i == 0 ? 1 : options.threads;
+
+			measure(kernel, measurement);
+
+			measurement.matches = output == reference;
+
+			report(measurement, options);
+
+		}
+
+#ifdef USE_OPENCL
+		OpenCLSobelKernel kernel(&input[0], width, height);
+
+		if(kernel.available){
+
+			measurement.implementation = "opencl_cpu";
+			measurement.threads = 0;
+
+			measure(kernel, measurement);
+
+			kernel.read(&output[0]);
+
+			measurement.matches = output == reference;
+
+			report(measurement, options);
+
+		}
+#endif
+
+	}
+
+	//The gradient image is the real input of min/max and scaling
+	int minpix = findMinimum(&reference[0], count, 255);
+	int maxpix = findMaximum(&reference[0], count, 0);
+
+	if(selected(options, "blur")){
+
+		const double sigmas[3] = {1.0, 5.0, 10.0};
+
+		for(int i = 0; i < 3; i++){
+
+			vector<int> blurred(input);
+
+			boxBlurOpenMP(&blurred[0], width, height, sigmas[i], 1);
+
+			BlurKernel kernel(sigmas[i], &input[0], &output[0], width, height, options.threads);
+
+			char name[32];
+
+			snprintf(name, sizeof(name), "sigma%g", sigmas[i]);
+
+			measurement.kernel = "blur";
+			measurement.implementation = name;
+			measurement.threads = options.threads;
+
+			measure(kernel, measurement);
+
+			measurement.matches = output == blurred;
+
+			report(measurement, options);
+
+		}
+
+	}
+
+	if(selected(options, "magnitude")){
+
+		const MagnitudeMode modes[3] = {MAGNITUDE_L1, MAGNITUDE_MAXMIN, MAGNITUDE_LUT};
+		const char *names[3] = {L1Magnitude::NAME, MaxMinMagnitude::NAME, SquaredMagnitude::NAME};
+
+		for(int m = 0; m < 3; m++){
+
+			vector<int> expected(count);
+
+			sobelMagnitudeScalar(&input[0], &expected[0], width, height, modes[m]);
+
+			for(int i = 0; i < 2; i++){
+
+				MagnitudeKernel kernel(modes[m], i == 0, &input[0], &output[0], width, height, options.threads);
+
+				string name = string(names[m]) + (i == 0 ? "_scalar" : "_simd");
+
+				measurement.kernel = "magnitude";
+				measurement.implementation = name;
+				measurement.threads = i == 0 ? 1 : options.threads;
+
+				measure(kernel, measurement);
+
+				measurement.matches = output == expected;
+
+				report(measurement, options);
+
+			}
+
+		}
+
+	}
+
+	if(selected(options, "minmax")){
+
+		for(int i = 0; i < 2; i++){
+
+			MinMaxKernel kernel(implementations[i], &reference[0], count, options.threads);
+
+			measurement.kernel = "minmax";
+			measurement.implementation = implementations[i];
+			measurement.threads = i == 0 ? 1 : options.threads;
+
+			measure(kernel, measurement);
+
+			measurement.matches = kernel.minpix == minpix && kernel.maxpix == maxpix;
+
+			report(measurement, options);
+
+		}
+
+	}
+
+	if(selected(options, "scale")){
+
+		vector<int> scaled(count);
+
+		ScaleKernel scalar("scalar", &reference[0], &scaled[0], count, minpix, maxpix, 1);
+
+		scalar.prepare();
+		scalar.run();
+
+		for(int i = 0; i < 3; i++){
+
+			ScaleKernel kernel(implementations[i], &reference[0], &output[0], count, minpix, maxpix, options.threads);
+
+			measurement.kernel = "scale";
+			measurement.implementation = implementations[i];
+			measurement.threads = i == 0 ? 1 : options.threads;
+
+			measure(kernel, measurement);
+
+			measurement.matches = output == scaled;
+
+			report(measurement, options);
+
+		}
+
+	}
+
+	if(selected(options, "unpack") || selected(options, "pack")){
+
+		packPixels(&input[0], &bytes[0], count);
+
+		PackKernel unpack(true, &bytes[0], &output[0], count);
+		PackKernel pack(false, &bytes[0], &input[0], count);
+
+		measurement.implementation = "scalar";
+		measurement.threads = 1;
+
+		if(selected(options, "unpack")){
+
+			measurement.kernel = "unpack";
+
+			measure(unpack, measurement);
+
+			measurement.matches = output == input;
+
+			report(measurement, options);
+
+		}
+
+		if(selected(options, "pack")){
+
+			measurement.kernel = "pack";
+
+			measure(pack, measurement);
+
+			measurement.matches = true;
+
+			report(measurement, options);
+
+		}
+
+	}
+
+}
+
+int main(int argc, char **argv){
+
+	string usage = "Usage: MicroBenchmark [-size WIDTHxHEIGHT ...] [-threads n] [-filter sobel|blur|magnitude|minmax|scale|pack]"
+			" [-out results.csv|results.json]\n";
+
+	MicroOptions options;
+
+	options.threads = omp_get_max_threads();
+
+	for(int arg = 1; arg < argc; arg++){
+
+		if(strcmp(argv[arg], "-size") == 0 && arg + 1 < argc){
+
+			int width = 0, height = 0;
+
+			if(sscanf(argv[++arg], "%dx%d", &width, &height) != 2 || width < 3 || height < 3){
+
+				cerr << usage;
+
+				return 1;
+
+			}
+
+			options.widths.push_back(width);
+			options.heights.push_back(height);
+
+		}else if(strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc){
+
+			options.threads = atoi(argv[++arg]);
+
+		}else if(strcmp(argv[arg], "-filter") == 0 && arg + 1 < argc){
+
+			options.filter = argv[++arg];
+
+		}else if(strcmp(argv[arg], "-out") == 0 && arg + 1 < argc){
+
+			options.outName = argv[++arg];
+
+		}else{
+
+			cerr << usage;
+
+			return 1;
+
+		}
+
+	}
+
+	if(options.threads < 1){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	//Wide, tall and square shapes of the same area exercise different layouts
+	if(options.widths.empty()){
+
+		for(int s = 0; s < 3; s++){
+
+			options.widths.push_back(DEFAULT_SIZES[s][0]);
+			options.heights.push_back(DEFAULT_SIZES[s][1]);
+
+		}
+
+	}
+
+	printf("%-40s %12s %14s %12s\n", "kernel/implementation/size/threads", "ns/pixel", "bytes/cycle", "iterations");
+
+	for(unsigned int s = 0; s < options.widths.size(); s++){
+
+		runSize(options.widths[s], options.heights[s], options);
+
+	}
+
+	return 0;
+}
@@ -0,0 +1,528 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <omp.h>
+#include "../openmp/edgeKernels.h"
+
+using namespace std;
+
+//Best of this many repetitions is kept, as STREAM does
+const int REPETITIONS = 5;
+const long DEFAULT_ELEMENTS = 1L << 24;
+const int DEFAULT_WIDTH = 4096;
+const int DEFAULT_HEIGHT = 4096;
+const long COMPUTE_ITERATIONS = 1L << 24;
+
+//Operation and byte counts per pixel of the engine passes. Sobel does
+//2 multiplies and 5 adds for each gradient, 2 multiplies and an add for
+//the squares, then the sqrt and its two conversions. Scaling subtracts,
+//converts, divides, multiplies and rounds. Every pass reads and writes
+//one int per pixel at the least, the neighbour rows come from cache
+const double SOBEL_OPS = 20.0;
+const double SOBEL_BYTES = 2 * sizeof(int);
+const double MINMAX_OPS = 2.0;
+const double MINMAX_BYTES = sizeof(int);
+const double SCALE_OPS = 5.0;
+const double SCALE_BYTES = 2 * sizeof(int);
+
+//Command line flags
+struct RooflineOptions{
+
+	int threads;
+	long elements;
+	int width;
+	int height;
+	string outName;
+
+};
+
+//Ceilings of the host
+struct Roofs{
+
+	double bandwidth;
+	double intOps;
+	double floatOps;
+
+};
+
+//One pass of one engine placed on the roofline
+struct RooflinePoint{
+
+	string engine;
+	string pass;
+	double intensity;
+	double seconds;
+	double opsPerSecond;
+	double attainable;
+	bool memoryBound;
+
+};
+
+//Monotonic wall clock in seconds
+double wallTime(){
+
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec + now.tv_nsec * 1e-9;
+
+}
+
+//STREAM triad a = b + s * c, 24 bytes per element without write allocate
+double measureBandwidth(long elements, int threads){
+
+	double *a = (double *) malloc(elements * sizeof(double));
+	double *b = (double *) malloc(elements * sizeof(double));
+	double *c = (double *) malloc(elements * sizeof(double));
+
+	if(!a || !b || !c){
+
+		cerr << "Error: cannot allocate the triad arrays." << endl;
+
+		exit(1);
+
+	}
+
+	//First touch by the threads that use the pages later
+	#pragma omp parallel for num_threads(threads) schedule(static)
+	for(long i = 0; i < elements; i++){
+
+		a[i] = 0.0;
+		b[i] = 1.0;
+		c[i] = 2.0;
+
+	}
+
+	double best = 1e30;
+	double scalar = 3.0;
+
+	for(int r = 0; r < REPETITIONS; r++){
+
+		double start = wallTime();
+
+		#pragma omp parallel for num_threads(threads) schedule(static)
+		for(long i = 0; i < elements; i++){
+
+			a[i] = b[i] + scalar * c[i];
+
+		}
+
+		double elapsed = wallTime() - start;
+
+		if(elapsed < best) best = elapsed;
+
+	}
+
+	if(a[elements / 2] != 7.0) cerr << "Warning: triad produced a wrong result." << endl;
+
+	free(a);
+	free(b);
+	free(c);
+
+	return 3.0 * sizeof(double) * elements / best;
+
+}
+
+//Independent multiply-add chains, wide enough to fill the vector units and
+//hide their latency. Two operations per chain and iteration
+template <typename T>
+double measureCompute(int threads, T multiplier, T addend){
+
+	const int CHAINS = 32;
+
+	double best = 1e30;
+	T sink = 0;
+
+	for(int r = 0; r < REPETITIONS; r++){
+
+		double start = wallTime();
+
+		#pragma omp parallel num_threads(threads) reduction(+:sink)
+		{
+			T acc[CHAINS];
+
+			for(int j = 0; j < CHAINS; j++) acc[j] = (T)(j + omp_get_thread_num());
+
+			for(long i = 0; i < COMPUTE_ITERATIONS; i++){
+
+				#pragma omp simd
+				for(int j = 0; j < CHAINS; j++){
+
+					acc[j] = acc[j] * multiplier + addend;
+
+				}
+
+			}
+
+			for(int j = 0; j < CHAINS; j++) sink += acc[j];
+		}
+
+		double elapsed = wallTime() - start;
+
+		if(elapsed < best) best = elapsed;
+
+	}
+
+	//Keeps the chains alive
+	if(sink == (T)12345) cerr << " ";
+
+	return 2.0 * CHAINS * COMPUTE_ITERATIONS * threads / best;
+
+}
+
+//Interface of a timed engine pass, prepare is not part of the time
+class Pass{
+
+public:
+
+	virtual ~Pass(){}
+
+	virtual void prepare(){}
+	virtual void run() = 0;
+
+};
+
+class SobelPass: public Pass{
+
+public:
+
+	SobelPass(int v, const int *in, int *o, int w, int h, int t):
+		variant(v), input(in), output(o), width(w), height(h), threads(t){}
+
+	void run(){
+
+		if(variant == 0) sobelScalar(input, output, width, height);
+		else if(variant == 1) sobelOpenMP(input, output, width, height, threads);
+		else sobelSimd(input, output, width, height, threads);
+
+	}
+
+private:
+
+	int variant;
+	const int *input;
+	int *output;
+	int width;
+	int height;
+	int threads;
+
+};
+
+class MinMaxPass: public Pass{
+
+public:
+
+	MinMaxPass(int v, const int *in, unsigned int c, int t):
+		variant(v), input(in), count(c), threads(t){}
+
+	void run(){
+
+		int minpix = 255;
+		int maxpix = 0;
+
+		if(variant == 0){
+
+			minpix = findMinimum(input, count, minpix);
+			maxpix = findMaximum(input, count, maxpix);
+
+		}else{
+
+			findMinMaxOpenMP(input, count, minpix, maxpix, threads);
+
+		}
+
+		result = maxpix - minpix;
+
+	}
+
+	int result;
+
+private:
+
+	int variant;
+	const int *input;
+	unsigned int count;
+	int threads;
+
+};
+
+//Scaling is in place, the gradient image is copied back before every run
+class ScalePass: public Pass{
+
+public:
+
+	ScalePass(int v, const int *in, int *o, unsigned int c, int mn, int mx, int t):
+		variant(v), input(in), output(o), count(c), minpix(mn), maxpix(mx), threads(t){}
+
+	void prepare(){memcpy(output, input, count * sizeof(int));}
+
+	void run(){
+
+		if(variant == 0) scaleScalar(output, count, minpix, maxpix);
+		else if(variant == 1) scaleOpenMP(output, count, minpix, maxpix, threads);
+		else scaleSimd(output, count, minpix, maxpix, threads);
+
+	}
+
+private:
+
+	int variant;
+	const int *input;
+	int *output;
+	unsigned int count;
+	int minpix;
+	int maxpix;
+	int threads;
+
+};
+
+double timePass(Pass &pass){
+
+	double best = 1e30;
+
+	pass.prepare();
+	pass.run();
+
+	for(int r = 0; r < REPETITIONS; r++){
+
+		pass.prepare();
+
+		double start = wallTime();
+
+		pass.run();
+
+		double elapsed = wallTime() - start;
+
+		if(elapsed < best) best = elapsed;
+
+	}
+
+	return best;
+
+}
+
+//Attainable throughput is min(peak, intensity * bandwidth)
+void placePoint(RooflinePoint &point, double ops, double bytes, double pixels, double peak, Roofs &roofs){
+
+	point.intensity = ops / bytes;
+	point.opsPerSecond = ops * pixels / point.seconds;
+
+	double memoryRoof = point.intensity * roofs.bandwidth;
+
+	point.memoryBound = memoryRoof < peak;
+	point.attainable = point.memoryBound ? memoryRoof : peak;
+
+}
+
+void writePoints(vector<RooflinePoint> &points, Roofs &roofs, RooflineOptions &options){
+
+	printf("bandwidth %.2f GB/s, int %.2f Gop/s, float %.2f Gflop/s, ridge %.2f/%.2f op/byte\n",
+			roofs.bandwidth * 1e-9, roofs.intOps * 1e-9, roofs.floatOps * 1e-9,
+			roofs.intOps / roofs.bandwidth, roofs.floatOps / roofs.bandwidth);
+
+	printf("%-12s %-8s %10s %12s %12s %8s %8s\n", "engine", "pass", "op/byte", "Gop/s", "roof Gop/s",
+			"% roof", "bound");
+
+	for(unsigned int p = 0; p < points.size(); p++){
+
+		RooflinePoint &point = points[p];
+
+		printf("%-12s %-8s %10.3f %12.3f %12.3f %8.1f %8s\n", point.engine.c_str(), point.pass.c_str(),
+				point.intensity, point.opsPerSecond * 1e-9, point.attainable * 1e-9,
+				100.0 * point.opsPerSecond / point.attainable, point.memoryBound ? "memory" : "compute");
+
+	}
+
+	if(options.outName.empty()) return;
+
+	bool json = options.outName.size() >= 5
+			&& options.outName.compare(options.outName.size() - 5, 5, ".json") == 0;
+
+	FILE *fp = fopen(options.outName.c_str(), "a");
+
+	if(!fp){
+
+		cerr << "Error: cannot write " << options.outName << endl;
+
+		exit(1);
+
+	}
+
+	fseek(fp, 0, SEEK_END);
+
+	if(!json && ftell(fp) == 0){
+
+		fprintf(fp, "engine;pass;threads;width;height;intensity;seconds;gops;roof_gops;roof_pct;bound;"
+				"bandwidth_gb_s;peak_int_gops;peak_float_gflops\n");
+
+	}
+
+	for(unsigned int p = 0; p < points.size(); p++){
+
+		RooflinePoint &point = points[p];
+
+		if(json){
+
+			fprintf(fp, "{\"engine\": \"%s\", \"pass\": \"%s\", \"threads\": %d, \"width\": %d, \"height\": %d,"
+					" \"intensity\": %.4f, \"seconds\": %.6f, \"gops\": %.4f, \"roof_gops\": %.4f,"
+					" \"roof_pct\": %.2f, \"bound\": \"%s\", \"bandwidth_gb_s\": %.4f,"
+					" \"peak_int_gops\": %.4f, \"peak_float_gflops\": %.4f}\n",
+					point.engine.c_str(), point.pass.c_str(), options.threads, options.width, options.height,
+					point.intensity, point.seconds, point.opsPerSecond * 1e-9, point.attainable * 1e-9,
+					100.0 * point.opsPerSecond / point.attainable, point.memoryBound ? "memory" : "compute",
+					roofs.bandwidth * 1e-9, roofs.intOps * 1e-9, roofs.floatOps * 1e-9);
+
+		}else{
+
+			fprintf(fp, "%s;%s;%d;%d;%d;%.4f;%.6f;%.4f;%.4f;%.2f;%s;%.4f;%.4f;%.4f\n",
+					point.engine.c_str(), point.pass.c_str(), options.threads, options.width, options.height,
+					point.intensity, point.seconds, point.opsPerSecond * 1e-9, point.attainable * 1e-9,
+					100.0 * point.opsPerSecond / point.attainable, point.memoryBound ? "memory" : "compute",
+					roofs.bandwidth * 1e-9, roofs.intOps * 1e-9, roofs.floatOps * 1e-9);
+
+		}
+
+	}
+
+	fclose(fp);
+
+}
+
+int main(int argc, char **argv){
+
+	string usage = "Usage: Roofline [-threads n] [-elements n] [-size WIDTHxHEIGHT]"
+			" [-out results.csv|results.json]\n";
+
+	RooflineOptions options;
+
+	options.threads = omp_get_max_threads();
+	options.elements = DEFAULT_ELEMENTS;
+	options.width = DEFAULT_WIDTH;
+	options.height = DEFAULT_HEIGHT;
+
+	for(int arg = 1; arg < argc; arg++){
+
+		if(strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc){
+
+			options.threads = atoi(argv[++arg]);
+
+		}else if(strcmp(argv[arg], "-elements") == 0 && arg + 1 < argc){
+
+			options.elements = atol(argv[++arg]);
+
+		}else if(strcmp(argv[arg], "-size") == 0 && arg + 1 < argc){
+
+			if(sscanf(argv[++arg], "%dx%d", &options.width, &options.height) != 2){
+
+				cerr << usage;
+
+				return 1;
+
+			}
+
+		}else if(strcmp(argv[arg], "-out") == 0 && arg + 1 < argc){
+
+			options.outName = argv[++arg];
+
+		}else{
+
+			cerr << usage;
+
+			return 1;
+
+		}
+
+	}
+
+	if(options.threads < 1 || options.elements < 1 || options.width < 3 || options.height < 3
+			|| options.width > INT_MAX / options.height){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	Roofs roofs;
+
+	roofs.bandwidth = measureBandwidth(options.elements, options.threads);
+	roofs.intOps = measureCompute<unsigned int>(options.threads, 1664525u, 1013904223u);
+	roofs.floatOps = measureCompute<double>(options.threads, 0.999999, 1e-7);
+
+	unsigned int count = options.width * options.height;
+
+	vector<int> input(count);
+	vector<int> gradient(count);
+	vector<int> output(count);
+
+	//Deterministic 8 bit noise
+	uint32_t state = 12345;
+
+	for(unsigned int i = 0; i < count; i++){
+
+		state = state * 1664525u + 1013904223u;
+
+		input[i] = state >> 24;
+
+	}
+
+	sobelScalar(&input[0], &gradient[0], options.width, options.height);
+
+	int minpix = findMinimum(&gradient[0], count, 255);
+	int maxpix = findMaximum(&gradient[0], count, 0);
+
+	//The sequential engine runs the scalar loops, OpenMP the banded and
+	//simd loops on the requested threads
+	const char *engines[3] = {"sequential", "openmp", "openmp_simd"};
+
+	vector<RooflinePoint> points;
+
+	for(int e = 0; e < 3; e++){
+
+		int threads = e == 0 ? 1 : options.threads;
+
+		RooflinePoint point;
+
+		point.engine = engines[e];
+
+		SobelPass sobel(e, &input[0], &output[0], options.width, options.height, threads);
+
+		point.pass = "sobel";
+		point.seconds = timePass(sobel);
+		placePoint(point, SOBEL_OPS, SOBEL_BYTES, count, roofs.intOps / options.threads * threads, roofs);
+		points.push_back(point);
+
+		//There is no separate simd min/max, the reduction already vectorizes
+		if(e < 2){
+
+			MinMaxPass minmax(e, &gradient[0], count, threads);
+
+			point.pass = "minmax";
+			point.seconds = timePass(minmax);
+			placePoint(point, MINMAX_OPS, MINMAX_BYTES, count, roofs.intOps / options.threads * threads, roofs);
+			points.push_back(point);
+
+		}
+
+		//Only the simd variant scales in integers, the others use doubles
+		ScalePass scale(e, &gradient[0], &output[0], count, minpix, maxpix, threads);
+
+		point.pass = "scale";
+		point.seconds = timePass(scale);
+		placePoint(point, SCALE_OPS, SCALE_BYTES, count,
+				(e == 2 ? roofs.intOps : roofs.floatOps) / options.threads * threads, roofs);
+		points.push_back(point);
+
+	}
+
+	writePoints(points, roofs, options);
+
+	return 0;
+}
@@ -0,0 +1,273 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "pgmCompare.h"
+#include "../openmp/tiled.h"
+
+using namespace std;
+
+//Command line flags
+struct ConvertOptions{
+
+	string inName;
+	string outName;
+	int tileSize;
+	bool compress;
+
+};
+
+void failWrite(const string &fileName){
+
+	cerr << "Error: cannot write " << fileName << endl;
+
+	exit(1);
+
+}
+
+//PGM to container one row of tiles at a time, so only a band of tileSize
+//rows is in memory. The index is written last, once the offsets are known
+void pgmToTiled(const ConvertOptions &options){
+
+	ifstream inFile(options.inName.c_str(), ios::binary | ios::in);
+
+	PGMImage image;
+
+	bool binary = false;
+
+	if(!inFile || !readPGMHeader(inFile, image, binary)){
+
+		cerr << "Error: " << options.inName << " is not a PGM image." << endl;
+
+		exit(1002);
+
+	}
+
+	TiledHeader header;
+
+	header.width = image.width;
+	header.height = image.height;
+	header.maxPixelValue = image.maxPixelValue;
+	header.tileSize = options.tileSize;
+
+	initTiledHeader(header);
+
+	FILE *fp = fopen(options.outName.c_str(), "wb");
+
+	//Room for the header and index, rewritten at the end
+	if(!fp || !writeTiledHeader(fp, header)) failWrite(options.outName);
+
+	int sampleBytes = tileSampleBytes(header);
+	size_t rowBytes = (size_t)header.width * sampleBytes;
+
+	unsigned long long offset = TILED_HEADER_BYTES + header.index.size() * TILED_ENTRY_BYTES;
+
+	vector<unsigned char> band(rowBytes * header.tileSize);
+	vector< vector<unsigned char> > tiles(header.tilesX);
+	vector<unsigned int> compression(header.tilesX);
+
+	for(int tileY = 0; tileY < header.tilesY; tileY++){
+
+		int rows = tileRegion(header, tileY * header.tilesX).height;
+
+		if(binary){
+
+			inFile.read((char *)&band[0], rowBytes * rows);
+
+		}else{
+
+			for(size_t i = 0; i < (size_t)header.width * rows; i++){
+
+				int value = 0;
+
+				inFile >> value;
+
+				if(sampleBytes == 2){
+
+					band[2 * i] = value >> 8;
+					band[2 * i + 1] = value & 0xff;
+
+				}else{
+
+					band[i] = value;
+
+				}
+
+			}
+
+		}
+
+		if(!inFile){
+
+			cerr << "Error: " << options.inName << " is truncated." << endl;
+
+			exit(1002);
+
+		}
+
+		//Tiles of the band are cut out and compressed in parallel
+		#pragma omp parallel
+		{
+			vector<unsigned char> packed;
+
+			#pragma omp for schedule(dynamic)
+			for(int tileX = 0; tileX < header.tilesX; tileX++){
+
+				Region tile = tileRegion(header, tileY * header.tilesX + tileX);
+
+				size_t tileRowBytes = (size_t)tile.width * sampleBytes;
+
+				vector<unsigned char> &samples = tiles[tileX];
+
+				samples.resize(tileRowBytes * tile.height);
+
+				for(int y = 0; y < tile.height; y++){
+
+					memcpy(&samples[y * tileRowBytes], &band[y * rowBytes + (size_t)tile.x * sampleBytes], tileRowBytes);
+
+				}
+
+				compression[tileX] = TILE_RAW;
+
+				if(options.compress){
+
+					packBits(&samples[0], samples.size(), packed);
+
+					if(packed.size() < samples.size()){
+
+						samples.swap(packed);
+
+						compression[tileX] = TILE_PACKBITS;
+
+					}
+
+				}
+
+			}
+		}
+
+		for(int tileX = 0; tileX < header.tilesX; tileX++){
+
+			TileEntry &entry = header.index[tileY * header.tilesX + tileX];
+
+			entry.offset = offset;
+			entry.size = tiles[tileX].size();
+			entry.compression = compression[tileX];
+
+			if(fwrite(&tiles[tileX][0], 1, entry.size, fp) != entry.size) failWrite(options.outName);
+
+			offset += entry.size;
+
+		}
+
+	}
+
+	if(!writeTiledHeader(fp, header) || fclose(fp) != 0) failWrite(options.outName);
+
+}
+
+//Container to P5 one row of tiles at a time
+void tiledToPgm(const ConvertOptions &options){
+
+	TiledHeader header;
+
+	int fd = open(options.inName.c_str(), O_RDONLY);
+
+	if(fd < 0 || !readTiledHeader(fd, header)){
+
+		cerr << "Error: cannot read the tile index of " << options.inName << endl;
+
+		exit(1002);
+
+	}
+
+	FILE *fp = fopen(options.outName.c_str(), "wb");
+
+	if(!fp) failWrite(options.outName);
+
+	fprintf(fp, "P5\n%d %d\n%d\n", header.width, header.height, header.maxPixelValue);
+
+	int sampleBytes = tileSampleBytes(header);
+
+	vector<int> pixels((size_t)header.width * header.tileSize);
+	vector<unsigned char> bytes(pixels.size() * sampleBytes);
+
+	for(int tileY = 0; tileY < header.tilesY; tileY++){
+
+		Region band = {0, tileY * header.tileSize, header.width, tileRegion(header, tileY * header.tilesX).height};
+
+		unsigned int count = band.width * band.height;
+
+		readTiledRegion(fd, header, band, &pixels[0], omp_get_max_threads());
+
+		if(sampleBytes == 2) packPixels16(&pixels[0], &bytes[0], count);
+		else packPixels(&pixels[0], &bytes[0], count);
+
+		if(fwrite(&bytes[0], sampleBytes, count, fp) != count) failWrite(options.outName);
+
+	}
+
+	close(fd);
+
+	if(fclose(fp) != 0) failWrite(options.outName);
+
+}
+
+int main(int argc, char **argv){
+
+	string usage = "Usage: TiledConvert input output [-tile pixels] [-compress]\n"
+			"A PGM input is written as a tiled container, a tiled input as a P5 image\n";
+
+	if(argc < 3){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	ConvertOptions options;
+
+	options.inName = argv[1];
+	options.outName = argv[2];
+	options.tileSize = DEFAULT_TILE_SIZE;
+	options.compress = false;
+
+	//Optional flags follow the positional arguments
+	for(int arg = 3; arg < argc; arg++){
+
+		if(strcmp(argv[arg], "-tile") == 0 && arg + 1 < argc){
+
+			options.tileSize = atoi(argv[++arg]);
+
+		}else if(strcmp(argv[arg], "-compress") == 0){
+
+			options.compress = true;
+
+		}else{
+
+			cerr << usage;
+
+			return 1;
+
+		}
+
+	}
+
+	if(options.tileSize < 1){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	if(isTiled(options.inName.c_str())) tiledToPgm(options);
+	else pgmToTiled(options);
+
+	return 0;
+}
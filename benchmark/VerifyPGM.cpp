@@ -0,0 +1,63 @@
+#include <iostream>
+#include <string>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pgmCompare.h"
+
+using namespace std;
+
+int main(int argc, char **argv){
+
+	string usage = "Usage: VerifyPGM reference.pgm candidate.pgm [-heatmap diff.pgm] [-tolerance maxDiff]\n";
+
+	if(argc < 3){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	string heatmapName;
+
+	int tolerance = 0;
+
+	//Optional flags follow the positional arguments
+	for(int arg = 3; arg < argc; arg++){
+
+		if(strcmp(argv[arg], "-heatmap") == 0 && arg + 1 < argc){
+
+			heatmapName = argv[++arg];
+
+		}else if(strcmp(argv[arg], "-tolerance") == 0 && arg + 1 < argc){
+
+			tolerance = atoi(argv[++arg]);
+
+		}else{
+
+			cerr << usage;
+
+			return 1;
+
+		}
+
+	}
+
+	PGMImage reference;
+	PGMImage candidate;
+
+	readPGM(argv[1], reference);
+	readPGM(argv[2], candidate);
+
+	Comparison comparison = compareImages(reference, candidate);
+
+	if(!heatmapName.empty()) writeHeatmap(heatmapName, reference, candidate, comparison);
+
+	printf("exact=%.4f%% maxdiff=%d psnr=%.2f %s\n", comparison.exactPercent(), comparison.maxDiff,
+			comparison.psnr, comparison.maxDiff <= tolerance ? "PASS" : "FAIL");
+
+	//Any difference above the tolerance is a failure for scripts
+	return comparison.maxDiff <= tolerance ? 0 : 1;
+}
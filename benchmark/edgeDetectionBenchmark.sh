@@ -0,0 +1,60 @@
+#!/bin/bash
+# Runs every backend that builds on a CPU host against the same images and
+# collects them in a single results file with one schema. The sequential
+# output is the reference every other backend is verified against. The
+# roofline of the host and the kernels goes next to it as <results>_roofline,
+# the error of the approximate magnitudes as <results>_magnitude.
+# Usage: ./edgeDetectionBenchmark.sh [results.csv|results.json] [image.pgm ...]
+echo "EDGE DETECTION - BENCHMARK - START"
+results=${1:-results_benchmark.csv}
+shift
+images=${@:-../sequential/image_1.pgm}
+roofline=${results%.*}_roofline.${results##*.}
+magnitude=${results%.*}_magnitude.${results##*.}
+rm -f ${results} ${roofline} ${magnitude}
+g++ Benchmark.cpp -o Benchmark -O3
+g++ Roofline.cpp -o Roofline -O3 -march=native -fopenmp
+g++ MagnitudeAccuracy.cpp -o MagnitudeAccuracy -O3 -fopenmp
+g++ TiledConvert.cpp -o TiledConvert -O3 -fopenmp
+g++ ../sequential/EdgeDetection.cpp -o EdgeDetectionSequential -O3
+g++ ../openmp/EdgeDetection.cpp -o EdgeDetectionOmp -O3 -fopenmp
+if command -v mpiCC > /dev/null; then
+	mpiCC ../mpi/EdgeDetectionMPI.cpp -o EdgeDetectionMPI -O3
+fi
+for image in ${images};
+do
+	./Benchmark -backend sequential -image ${image} -out ${results} -- ./EdgeDetectionSequential ${image} out_seq.pgm
+	for (( i=2; i<=8; i=i*2 ));
+	do
+		./Benchmark -backend openmp -config "${i}" -image ${image} -out ${results} -reference out_seq.pgm -output out_omp.pgm -heatmap diff_omp_"${i}".pgm -- ./EdgeDetectionOmp ${image} out_omp.pgm "${i}"
+	done
+	for method in separable simd;
+	do
+		./Benchmark -backend openmp_${method} -config 8 -image ${image} -out ${results} -reference out_seq.pgm -output out_omp.pgm -- ./EdgeDetectionOmp ${image} out_omp.pgm 8 -sobel ${method}
+	done
+	# Approximate magnitudes differ from the reference by design, their
+	# difference is reported without failing the run
+	for mode in l1 maxmin lut;
+	do
+		./Benchmark -backend openmp_${mode} -config 8 -image ${image} -out ${results} -reference out_seq.pgm -output out_omp.pgm -tolerance 255 -- ./EdgeDetectionOmp ${image} out_omp.pgm 8 -magnitude ${mode}
+	done
+	./MagnitudeAccuracy -image ${image} -out ${magnitude}
+	for normalization in percentile equalize;
+	do
+		./Benchmark -backend openmp_${normalization} -config 8 -image ${image} -out ${results} -- ./EdgeDetectionOmp ${image} out_omp.pgm 8 -normalize ${normalization}
+	done
+	# The tiled container gives the same image as the PGM it was made from
+	./TiledConvert ${image} image.tiled -compress
+	./Benchmark -backend openmp_tiled -config 8 -image ${image} -out ${results} -reference out_seq.pgm -output out_omp.pgm -- ./EdgeDetectionOmp image.tiled out_omp.pgm 8
+	./Benchmark -backend openmp_canny -config 8 -image ${image} -out ${results} -- ./EdgeDetectionOmp ${image} out_canny.pgm 8 -canny 40 100
+	# The MPI engine is known to differ from the reference, its difference
+	# is reported without failing the run until that engine is fixed
+	if [ -x EdgeDetectionMPI ]; then
+		for (( k=3; k<=12; k=k*2 ));
+		do
+			./Benchmark -backend mpi_single -config "${k}" -image ${image} -out ${results} -reference out_seq.pgm -output out_mpi.pgm -tolerance 255 -heatmap diff_mpi_"${k}".pgm -- mpirun -np "${k}" --oversubscribe ./EdgeDetectionMPI ${image} out_mpi.pgm
+		done
+	fi
+done
+./Roofline -threads $(nproc) -out ${roofline}
+echo "EDGE DETECTION - BENCHMARK - END"
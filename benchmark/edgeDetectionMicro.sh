@@ -0,0 +1,12 @@
+#!/bin/bash
+# Times every kernel of the OpenMP engine in isolation on in-memory images,
+# scalar, OpenMP and SIMD versions side by side. Pass -DUSE_OPENCL in CFLAGS
+# to add the OpenCL kernel on a CPU device.
+# Usage: ./edgeDetectionMicro.sh [results.csv|results.json] [threads]
+echo "EDGE DETECTION - MICROBENCHMARK - START"
+results=${1:-results_micro.csv}
+threads=${2:-$(nproc)}
+rm -f ${results}
+g++ MicroBenchmark.cpp -o MicroBenchmark -O3 -march=native -fopenmp ${CFLAGS}
+./MicroBenchmark -threads ${threads} -size 256x256 -size 1024x1024 -size 4096x4096 -size 16384x256 -size 256x16384 -out ${results}
+echo "EDGE DETECTION - MICROBENCHMARK - END"
@@ -0,0 +1,212 @@
+#ifndef PGMCOMPARE_H_
+#define PGMCOMPARE_H_
+
+//Adding header files
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+//A whole P2 or P5 image in memory
+struct PGMImage{
+
+	int width;
+	int height;
+	int maxPixelValue;
+	vector<int> pixels;
+
+};
+
+//Differences between a candidate image and its reference
+struct Comparison{
+
+	long long pixels;
+	long long exact;
+	int maxDiff;
+	double mse;
+	double psnr;
+
+	double exactPercent() const {return pixels > 0 ? 100.0 * exact / pixels : 100.0;}
+
+};
+
+//Reads magic number, width, height and max value, skipping comments.
+//Returns false when the file is not a PGM image
+inline bool readPGMHeader(ifstream &inFile, PGMImage &image, bool &binary){
+
+	string token;
+	int values[3];
+	int count = 0;
+
+	if(!(inFile >> token) || (token != "P2" && token != "P5")) return false;
+
+	binary = token == "P5";
+
+	while(count < 3 && inFile >> token){
+
+		if(token[0] == '#'){
+
+			getline(inFile, token);
+
+			continue;
+
+		}
+
+		values[count++] = atoi(token.c_str());
+
+	}
+
+	if(count < 3 || values[0] <= 0 || values[1] <= 0) return false;
+
+	image.width = values[0];
+	image.height = values[1];
+	image.maxPixelValue = values[2];
+
+	//A single whitespace separates the header from binary samples
+	inFile.get();
+
+	return true;
+
+}
+
+inline void readPGM(const string &fileName, PGMImage &image){
+
+	ifstream inFile;
+
+	inFile.open(fileName.c_str(), ios::binary | ios::in);
+
+	bool binary = false;
+
+	if(!inFile || !readPGMHeader(inFile, image, binary)){
+
+		cerr << "Error: " << fileName << " is not a PGM image." << endl;
+
+		exit(1002);
+
+	}
+
+	long long imageSize = (long long)image.width * image.height;
+
+	image.pixels.resize(imageSize);
+
+	int bytesPerSample = image.maxPixelValue > 255 ? 2 : 1;
+
+	for(long long i = 0; i < imageSize; i++){
+
+		if(binary){
+
+			unsigned char sample[2] = {0, 0};
+
+			inFile.read((char *)sample, bytesPerSample);
+
+			//16 bit samples are big endian
+			image.pixels[i] = bytesPerSample == 2 ? (sample[0] << 8) | sample[1] : sample[0];
+
+		}else{
+
+			inFile >> image.pixels[i];
+
+		}
+
+		if(!inFile){
+
+			cerr << "Error: " << fileName << " is truncated." << endl;
+
+			exit(1002);
+
+		}
+
+	}
+
+	inFile.close();
+
+}
+
+//Exact matches, largest absolute difference and PSNR against the peak value
+//of the reference. Identical images have an infinite PSNR
+inline Comparison compareImages(const PGMImage &reference, const PGMImage &candidate){
+
+	if(reference.width != candidate.width || reference.height != candidate.height){
+
+		cerr << "Error: images have different sizes, " << reference.width << "x" << reference.height
+				<< " and " << candidate.width << "x" << candidate.height << endl;
+
+		exit(1);
+
+	}
+
+	Comparison comparison;
+
+	comparison.pixels = reference.pixels.size();
+	comparison.exact = 0;
+	comparison.maxDiff = 0;
+
+	double squared = 0.0;
+
+	for(long long i = 0; i < comparison.pixels; i++){
+
+		int diff = abs(reference.pixels[i] - candidate.pixels[i]);
+
+		if(diff == 0) comparison.exact++;
+
+		if(diff > comparison.maxDiff) comparison.maxDiff = diff;
+
+		squared += (double)diff * diff;
+
+	}
+
+	comparison.mse = comparison.pixels > 0 ? squared / comparison.pixels : 0.0;
+
+	int peak = reference.maxPixelValue > 0 ? reference.maxPixelValue : 255;
+
+	comparison.psnr = comparison.mse > 0.0 ? 10.0 * log10((double)peak * peak / comparison.mse) : INFINITY;
+
+	return comparison;
+
+}
+
+//Writes |reference - candidate| as a P5 image stretched so the largest
+//difference is white, identical images give a black heatmap
+inline void writeHeatmap(const string &fileName, const PGMImage &reference, const PGMImage &candidate,
+		const Comparison &comparison){
+
+	FILE *fp = fopen(fileName.c_str(), "wb");
+
+	if(!fp){
+
+		cerr << "Error: cannot write " << fileName << endl;
+
+		exit(1);
+
+	}
+
+	fprintf(fp, "P5\n# Difference heatmap\n%d %d\n255\n", reference.width, reference.height);
+
+	vector<unsigned char> row(reference.width);
+
+	for(int y = 0; y < reference.height; y++){
+
+		for(int x = 0; x < reference.width; x++){
+
+			long long i = (long long)y * reference.width + x;
+
+			int diff = abs(reference.pixels[i] - candidate.pixels[i]);
+
+			row[x] = comparison.maxDiff > 0 ? (unsigned char)((diff * 255 + comparison.maxDiff - 1) / comparison.maxDiff) : 0;
+
+		}
+
+		fwrite(&row[0], 1, reference.width, fp);
+
+	}
+
+	fclose(fp);
+
+}
+
+#endif /* PGMCOMPARE_H_ */
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <math.h>
+#include <limits.h>
 #include <fstream>
 #include <vector>
 #include <sstream>
@@ -16,17 +17,33 @@ using namespace std;
  */ 
 /*****************************************************************************/
 
+/* floor(sqrt(n)), which is what the sequential version gets by truncating a
+double sqrt. The single precision estimate is corrected to the exact integer
+root so the kernels need no double precision */
+__device__ int isqrtCuda (int n) {
+	int root = __float2int_rz(sqrtf(__int2float_rn(n)));
+	while (root * root > n) root--;
+	while ((root + 1) * (root + 1) <= n) root++;
+	return root;
+}
+
+/* round(((value - minpix) / (maxpix - minpix)) * 255) with round half up in
+integers, identical to the double precision scaling for every pixel */
+__device__ int scalePixelCuda (int value, int minpix, int maxpix) {
+	int range = maxpix - minpix;
+	if (range <= 0) return 0;
+	return ((value - minpix) * 510 + range) / (2 * range);
+}
+
 __global__ void scaleImageCuda (int *pixels, int minpix, int maxpix, int imageSize) {
 	/* blockDim.x gives the number of threads per block, combining it
 	with threadIdx.x and blockIdx.x gives the index of each global
 	thread in the device */
 	int index = (blockDim.x * blockIdx.x) + threadIdx.x;
-	int value;
 	/* Typical problems are not friendly multiples of blockDim.x.
 	Avoid accesing data beyond the end of the arrays */
 	if (index < imageSize) {
-		value = round(((double)(pixels[index] - minpix) / (maxpix - minpix)) * 255);
-		pixels[index] = value;
+		pixels[index] = scalePixelCuda(pixels[index], minpix, maxpix);
 	}
 
     __syncthreads();
@@ -45,9 +62,7 @@ __global__ void edgeDetectionCuda (int *pixels, int *tempImage, int width, int h
 	if (index < imageSize) {
 		x = index % width;
 
-		if (index != 0) {
-			y = __double2int_rd((__int2double_rn(index) / __int2double_rn(width)));	
-		}
+		y = index / width;
 		
 		if (x < (width - 1) && y < (height - 1)
 				&& (y > 0) && (x > 0)) {
@@ -68,7 +83,7 @@ __global__ void edgeDetectionCuda (int *pixels, int *tempImage, int width, int h
 								  - pixels[(x-1) + ((y-1) * width)]
 										   - (2 * pixels[(x) + ((y-1) * width)])
 										   - pixels[(x+1) + ((y-1) * width)]);
-			tempImage[index] = __double2int_rn(sqrt(__int2double_rn(xG * xG) + __int2double_rn(yG * yG)));
+			tempImage[index] = isqrtCuda((xG * xG) + (yG * yG));
 
 		} else {
 
@@ -409,6 +424,15 @@ void Image::readHeader(ifstream &inFile){
 
 	}
 
+	//Pixels are indexed with int, larger images would overflow it
+	if(width > INT_MAX / height){
+
+		cerr << "Error: image too large, width * height must fit in an int" << endl;
+
+		exit(1002);
+
+	}
+
 	//Check if there are any comments between height/width and maxPixelValue
 	while(getline(inFile, line)){
 
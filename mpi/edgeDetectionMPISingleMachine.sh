@@ -1,16 +1,11 @@
 #!/bin/bash
 echo "EDGE DETECTION - MPI - SINGLE MACHINE - START"
-echo "run;image;threadsperblock;time" > results_mpi_single.csv
-for (( i=1; i<=5; i++ ));
+rm -f results_mpi_single.csv
+for (( k=3; k<=12; k=k*2 ));
 do
 	for (( j=1; j<=3; j=j+1 ));
 	do
-		for (( k=3; k<=12; k=k*2 ));
-		do
-			output=$(eval "time mpirun -np "${k}" -mca btl ^openib EdgeDetectionMPI image_"${j}".pgm image_"${j}"_out_mpi.pgm" 2>&1)
-			realTime=${output:8:5}
-			echo ""$i";"$j";"$k";"$output >> results_mpi_single.csv
-		done
+		../benchmark/Benchmark -backend mpi_single -config "${k}" -image image_"${j}".pgm -runs 5 -out results_mpi_single.csv -- mpirun -np "${k}" -mca btl ^openib EdgeDetectionMPI image_"${j}".pgm image_"${j}"_out_mpi.pgm
 	done
 done
 echo "EDGE DETECTION - MPI - SINGLE MACHINE - END"
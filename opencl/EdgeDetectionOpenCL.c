@@ -1,20 +1,152 @@
 #include <iostream>
 #include <math.h>
+#include <limits.h>
 #include <fstream>
 #include <vector>
 #include <sstream>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 #define CL_USE_DEPRECATED_OPENCL_1_2_APIS
 #include <CL/cl.h>
 #include <sys/types.h>
 #include "err_code.h"
+#include "normalize.h"
 
 using namespace std;
 
 const int THREADS_PER_BLOCK = 256;
+const int PIPELINE_DEPTH = 2;
+const int PAGE_ALIGNMENT = 4096;
+const int HALO_ROWS = 1;
+const int CALIBRATION_ROWS = 128;
+//Largest squared gradient and gradient magnitude of an 8 bit image
+const int MAX_SQUARED_GRADIENT = 2 * (4 * 255) * (4 * 255);
+const int MAX_GRADIENT = 1442;
+//Pixels counted by each work item of histogramOpenCL, which pays for
+//clearing and merging its local histogram once per work-group
+const int HISTOGRAM_PIXELS_PER_ITEM = 64;
 #define MAX_SOURCE_SIZE (0x100000)
 
+//Stage durations collected with -profile. Device stages are read from the
+//queue profiling counters of their events, host stages are timed with wallTime
+class Profiler{
+
+public:
+
+	Profiler(){}
+	~Profiler(){}
+
+	void addTime(int frame, int device, const string &stage, double seconds);
+	void addEvent(int frame, int device, const string &stage, cl_event event);
+
+	//One record per frame and stage, or with aggregate one summary per stage
+	//over every frame. Files ending in .json are written as JSON, any other
+	//name as a semicolon separated CSV like the results files
+	void write(const string &fileName, bool aggregate);
+
+	//Names of the devices, indexed like the device field of the records
+	vector<string> devices;
+
+private:
+
+	struct StageTime{
+
+		int frame;
+		int device;
+		string stage;
+		double milliseconds;
+
+	};
+
+	vector<StageTime> times;
+
+};
+
+//OpenCL objects created once per run and shared by every kernel launch
+class OpenCLEngine{
+
+public:
+
+	//Command queues used by the pipelined stream mode
+	enum{UPLOAD_QUEUE = 0, COMPUTE_QUEUE = 1, DOWNLOAD_QUEUE = 2, QUEUE_COUNT = 3};
+
+	OpenCLEngine():
+		device_id(NULL),
+		context(NULL),
+		program(NULL),
+		edgeKernel(NULL),
+		scaleKernel(NULL),
+		minMaxKernel(NULL),
+		scaleMinMaxKernel(NULL),
+		magnitudeTableKernel(NULL),
+		scaleTableKernel(NULL),
+		gaussianRowsKernel(NULL),
+		gaussianColumnsKernel(NULL),
+		sobelDirectionKernel(NULL),
+		nonMaxSuppressionKernel(NULL),
+		hysteresisKernel(NULL),
+		cannyOutputKernel(NULL),
+		histogramKernel(NULL),
+		applyTableKernel(NULL),
+		localSize(THREADS_PER_BLOCK),
+		zeroCopy(false),
+		profiler(NULL),
+		index(0){
+
+		for(int q = 0; q < QUEUE_COUNT; q++) queues[q] = NULL;
+
+	}
+	~OpenCLEngine(){}
+
+	void init(cl_device_id device);
+	void release();
+	bool hostUnifiedMemory();
+
+	//Hand a finished command to the profiler, if any, and release its event
+	void record(const char *stage, cl_event event, int frame = 0);
+	//Hand the host time elapsed since start to the profiler, if any
+	void recordHost(const char *stage, double start, int frame = 0);
+
+	cl_device_id device_id;
+	cl_context context;
+	cl_command_queue queues[QUEUE_COUNT];
+	cl_program program;
+	cl_kernel edgeKernel;
+	cl_kernel scaleKernel;
+	cl_kernel minMaxKernel;
+	cl_kernel scaleMinMaxKernel;
+	cl_kernel magnitudeTableKernel;
+	cl_kernel scaleTableKernel;
+	cl_kernel gaussianRowsKernel;
+	cl_kernel gaussianColumnsKernel;
+	cl_kernel sobelDirectionKernel;
+	cl_kernel nonMaxSuppressionKernel;
+	cl_kernel hysteresisKernel;
+	cl_kernel cannyOutputKernel;
+	cl_kernel histogramKernel;
+	cl_kernel applyTableKernel;
+
+	//Work-group size, THREADS_PER_BLOCK or the largest power of two the device allows
+	size_t localSize;
+
+	//Wrap host arrays with CL_MEM_USE_HOST_PTR and map them instead of copying
+	bool zeroCopy;
+
+	//Set before init to create the queues with profiling enabled
+	Profiler * profiler;
+
+	//Position of the device in the profiler records
+	int index;
+
+	//Set before init to take the edge kernel from a GenerateStencilCL source
+	string stencilName;
+
+	//Set before init to pick the Sobel magnitude, exact, l1 or maxmin
+	string magnitudeName;
+
+};
+
 //Creating image class (base class)
 class Image{
 
@@ -26,25 +158,36 @@ public:
 		maxPixelValue(0),
 		minpix(0),
 		maxpix(0),
-		imageSize(0){}
+		imageSize(0),
+		pixels(NULL){}
 	virtual ~Image(){}
 
 	virtual void readImage(ifstream &inFile) = 0;
 	virtual void writeImage(ofstream &outFile) = 0;
 
 	void readHeader(ifstream &inFile);
-	void scaleImage();
-	void edgeDection();
+	void scaleImage(OpenCLEngine &engine);
+	void edgeDection(OpenCLEngine &engine);
+	void cannyEdgeDetection(OpenCLEngine &engine, int low, int high);
+	void normalizeImage(OpenCLEngine &engine, const Normalization &normalization);
+
+	//Multi-device versions, device d processes bandRows[d] rows
+	void balanceBands(OpenCLEngine *engines, int count, int *bandRows);
+	void scaleImageBands(OpenCLEngine *engines, int count, int *bandRows);
+	void edgeDectionBands(OpenCLEngine *engines, int count, int *bandRows);
 
 	//Accessor methods
 	int getHeight(){return height;}
 	int getWidth(){return width;}
 	int getMaxPixelValue(){return maxPixelValue;}
+	unsigned int getImageSize(){return imageSize;}
+	int * getPixels(){return pixels;}
 
 	//Mutator methods
 	void setHeight(int h){height = h;}
 	void setWidth(int w){width = w;}
 	void setMaxPixelValue(int mpv){maxPixelValue = mpv;}
+	void setPixels(int *p){pixels = p;}
 
 	//Member variables
 protected:
@@ -103,6 +246,26 @@ bool isComment(string comment){
 	return true;
 }
 
+//Allocates a page aligned pixel array whose size is a multiple of 64 bytes,
+//which is what drivers need to use it in place with CL_MEM_USE_HOST_PTR
+int * allocPixels(unsigned int count){
+
+	void * buffer = NULL;
+
+	size_t size = ((count * sizeof(int) + 63) / 64) * 64;
+
+	if(posix_memalign(&buffer, PAGE_ALIGNMENT, size) != 0){
+
+		cerr << "Error: cannot allocate pixels." << endl;
+
+		exit(1000);
+
+	}
+
+	return (int *)buffer;
+
+}
+
 //Reads binary pixel values in image
 void BinaryImage::readImage(ifstream &inFile){
 
@@ -134,7 +297,7 @@ void BinaryImage::readImage(ifstream &inFile){
 	byteArray[imageSize] = '\0';
 
 	//Put the data read from file into pixels
-	pixels = (int *)malloc(imageSize * sizeof(int));
+	pixels = allocPixels(imageSize);
 	for(unsigned int i = 0; i < imageSize; i++){
 
 		pixels[i] = static_cast<int>
@@ -205,9 +368,11 @@ void AsciiImage::readImage(ifstream &inFile){
 
 	int pixelValue;
 
+	pixels = allocPixels(imageSize);
+
 	//Read in the Ascii values from file
-	int i = 0;
-	while(inFile >> pixelValue){
+	unsigned int i = 0;
+	while(i < imageSize && inFile >> pixelValue){
 
 		pixels[i] = pixelValue;
 		i++;
@@ -343,6 +508,15 @@ void Image::readHeader(ifstream &inFile){
 
 	}
 
+	//Pixels are indexed with int, larger images would overflow it
+	if(width > INT_MAX / height){
+
+		cerr << "Error: image too large, width * height must fit in an int" << endl;
+
+		exit(1002);
+
+	}
+
 	//Check if there are any comments between height/width and maxPixelValue
 	while(getline(inFile, line)){
 
@@ -431,410 +605,2003 @@ void Image::findMin(){
 
 }
 
-//Scales image so that the maximum pixel value is 255
-void Image::scaleImage(){
+//Monotonic wall clock in seconds
+double wallTime(){
 
-	findMin();
+	struct timespec now;
 
-	findMax();
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
-	size_t size = imageSize * sizeof(int);
+	return now.tv_sec + now.tv_nsec * 1e-9;
 
-	/******************************************************************************/
-	/* declare opencl variables */
-	cl_device_id device_id = NULL;
-	cl_context context = NULL;
-	cl_command_queue command_queue = NULL;
-	cl_mem d_pixels = NULL;
-	cl_program program = NULL;
-	cl_kernel kernel = NULL;
-	cl_platform_id platform_id = NULL;
-	cl_uint ret_num_devices;
-	cl_uint ret_num_platforms;
-	cl_int ret;
+}
 
-	/******************************************************************************/
-	/* open kernel */
-	FILE *fp;
-	char fileName[] = "./EdgeDetectionOpenCL.cl";
-	char *source_str;
-	size_t source_size;
+void Profiler::addTime(int frame, int device, const string &stage, double seconds){
 
-	/* Load the source code containing the kernel*/
-	fp = fopen(fileName, "r");
-	if (!fp) {
-		fprintf(stderr, "Failed to load kernel.\n");
-		exit(1);
-	}
-	source_str = (char*)malloc(MAX_SOURCE_SIZE);
-	source_size = fread(source_str, 1, MAX_SOURCE_SIZE, fp);
-	fclose(fp);
+	StageTime time;
 
-	//printf("the source is open\n");
+	time.frame = frame;
+	time.device = device;
+	time.stage = stage;
+	time.milliseconds = seconds * 1e3;
 
-	/******************************************************************************/
-	/* create objects */
+	times.push_back(time);
 
-	/* Get Platform and Device Info */
-	ret = clGetPlatformIDs(1, &platform_id, &ret_num_platforms);
-	checkError(ret, "Getting platform");
-	ret = clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_GPU, 1, &device_id, &ret_num_devices);
-	checkError(ret, "Getting device");
-	
-	//printf("device and platform are ok\n");
+}
 
-	/* Create OpenCL context */
-	context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &ret);
-	checkError(ret, "Creating context");
+//The event must have completed, START and END are in nanoseconds
+void Profiler::addEvent(int frame, int device, const string &stage, cl_event event){
 
-	//printf("context created\n");
+	cl_ulong start = 0;
+	cl_ulong end = 0;
 
-	/* Create Command Queue */
-	command_queue = clCreateCommandQueue(context, device_id, 0, &ret);
-	checkError(ret, "Creating queue");
+	cl_int ret = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+	checkError(ret, "Getting profiling info");
+	ret = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+	checkError(ret, "Getting profiling info");
 
-	//print kernel
-	//printf("\n%s\n%i bytes\n", source_str, (int)source_size); fflush(stdout);
-	/******************************************************************************/
+	addTime(frame, device, stage, (end - start) * 1e-9);
 
-	/* create build program */
+}
 
-	/* Create Kernel Program from the source */
-	program = clCreateProgramWithSource(context, 1, (const char **)&source_str,
-	(const size_t *)&source_size, &ret);
-	checkError(ret, "Creating program");
+//Device names may contain quotes
+string jsonString(const string &text){
 
-	/* Build Kernel Program */
-	ret = clBuildProgram(program, 1, &device_id, NULL, NULL, NULL);
-	if (ret != CL_SUCCESS)
-	{
-		size_t len;
-		char buffer[2048];
+	string escaped = "\"";
 
-		printf("Error: Failed to build program executable!\n%s\n", err_code(ret));
-		clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &len);
-		printf("%s\n", buffer);
-		//return EXIT_FAILURE;
-		exit(1);
-	}
-	/* Create OpenCL Kernel */
-	kernel = clCreateKernel(program, "scaleImageOpenCL", &ret);
-	checkError(ret, "Creating kernel");
+	for(unsigned int c = 0; c < text.size(); c++){
 
-	/* Create Memory Buffer */
-	d_pixels = clCreateBuffer(context, CL_MEM_READ_WRITE, size, NULL, &ret);
-	checkError(ret, "Creating buffer d_pixels");
+		if(text[c] == '"' || text[c] == '\\') escaped += '\\';
 
-    // Write a and b vectors into compute device memory
-    ret = clEnqueueWriteBuffer(command_queue, d_pixels, CL_TRUE, 0, size, pixels, 0, NULL, NULL);
-    checkError(ret, "Error Copying h_a to device at d_a");
+		escaped += text[c];
 
-	/* Set OpenCL Kernel Parameters */
-	ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&d_pixels);
-	checkError(ret, "Setting kernel arguments");
-	ret = clSetKernelArg(kernel, 1, sizeof(int), &minpix);
-	checkError(ret, "Setting kernel arguments");
-	ret = clSetKernelArg(kernel, 2, sizeof(int), &maxpix);
-	checkError(ret, "Setting kernel arguments");
-	ret = clSetKernelArg(kernel, 3, sizeof(int), &imageSize);
-	checkError(ret, "Setting kernel arguments");
+	}
 
-	//clEnqueueWriteBuffer(command_queue, pi, CL_TRUE, 0, 1, &h_pi, 0, NULL, NULL);
-	int blocks = (imageSize + (THREADS_PER_BLOCK - 1)) / THREADS_PER_BLOCK;
-	int threadsPerblock = THREADS_PER_BLOCK;
-	size_t global_work_size = blocks * threadsPerblock;
-	size_t local_work_size = threadsPerblock;
-	cl_uint work_dim = 1;
-	/* Execute OpenCL Kernel */
-	//ret = clEnqueueTask(command_queue, kernel, 0, NULL,NULL);  //single work item
-	ret = clEnqueueNDRangeKernel(command_queue, kernel, work_dim,
-			0, &global_work_size, &local_work_size, 0, NULL, NULL);
-	checkError(ret, "Enqueueing kernel");
-	ret = clFinish(command_queue);
-	checkError(ret, "Waiting for commands to finish");
-	/******************************************************************************/
-	/* Copy results from the memory buffer */
-	ret = clEnqueueReadBuffer(command_queue, d_pixels, CL_TRUE, 0, size, pixels, 0, NULL, NULL);
-	checkError(ret, "Getting results");
+	return escaped + "\"";
 
-	/* Finalization */
-	ret = clFlush(command_queue);
-	ret = clFinish(command_queue);
-	ret = clReleaseKernel(kernel);
-	ret = clReleaseProgram(program);
-	ret = clReleaseMemObject(d_pixels);
-	ret = clReleaseCommandQueue(command_queue);
-	ret = clReleaseContext(context);
+}
 
-	free(source_str);
+void Profiler::write(const string &fileName, bool aggregate){
 
-	maxPixelValue = 255;
-}
+	bool json = fileName.size() >= 5 && fileName.compare(fileName.size() - 5, 5, ".json") == 0;
 
-//Sobel edge detection function - detects edges and draws an outline
-void Image::edgeDection() {
-	size_t size = imageSize * sizeof(int);
-	int * tempImage = (int *)malloc(size);
+	FILE *fp = fopen(fileName.c_str(), "w");
 
-	/******************************************************************************/
-	/* declare opencl variables */
-	cl_device_id device_id = NULL;
-	cl_context context = NULL;
-	cl_command_queue command_queue = NULL;
-	cl_mem d_pixels = NULL;
-	cl_mem d_tempImage = NULL;
-	cl_program program = NULL;
-	cl_kernel kernel = NULL;
-	cl_platform_id platform_id = NULL;
-	cl_uint ret_num_devices;
-	cl_uint ret_num_platforms;
-	cl_int ret;
+	if(!fp){
 
-	/******************************************************************************/
-	/* open kernel */
-	FILE *fp;
-	char fileName[] = "./EdgeDetectionOpenCL.cl";
-	char *source_str;
-	size_t source_size;
+		cerr << "Error: cannot write profile " << fileName << endl;
 
-	/* Load the source code containing the kernel*/
-	fp = fopen(fileName, "r");
-	if (!fp) {
-		fprintf(stderr, "Failed to load kernel.\n");
 		exit(1);
+
 	}
-	source_str = (char*)malloc(MAX_SOURCE_SIZE);
-	source_size = fread(source_str, 1, MAX_SOURCE_SIZE, fp);
-	fclose(fp);
 
-	//printf("the source is open\n");
+	//Summaries keep the order in which stages first appear
+	struct StageSummary{
 
-	/******************************************************************************/
-	/* create objects */
+		int device;
+		string stage;
+		int count;
+		double total;
+		double min;
+		double max;
 
-	/* Get Platform and Device Info */
-	ret = clGetPlatformIDs(1, &platform_id, &ret_num_platforms);
-	checkError(ret, "Getting platform");
-	ret = clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_GPU, 1, &device_id, &ret_num_devices);
-	checkError(ret, "Getting device");
-	
-	//printf("device and platform are ok\n");
+	};
 
-	/* Create OpenCL context */
-	context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &ret);
-	checkError(ret, "Creating context");
+	vector<StageSummary> summaries;
 
-	//printf("context created\n");
+	if(aggregate){
 
-	/* Create Command Queue */
-	command_queue = clCreateCommandQueue(context, device_id, 0, &ret);
-	checkError(ret, "Creating queue");
+		for(unsigned int t = 0; t < times.size(); t++){
 
-	//print kernel
-	//printf("\n%s\n%i bytes\n", source_str, (int)source_size); fflush(stdout);
-	/******************************************************************************/
+			unsigned int s = 0;
 
-	/* create build program */
+			while(s < summaries.size() && (summaries[s].device != times[t].device
+					|| summaries[s].stage != times[t].stage)) s++;
 
-	/* Create Kernel Program from the source */
-	program = clCreateProgramWithSource(context, 1, (const char **)&source_str,
-	(const size_t *)&source_size, &ret);
-	checkError(ret, "Creating program");
+			if(s == summaries.size()){
 
-	/* Build Kernel Program */
-	ret = clBuildProgram(program, 1, &device_id, NULL, NULL, NULL);
-	if (ret != CL_SUCCESS)
-	{
-		size_t len;
-		char buffer[2048];
+				StageSummary summary;
+
+				summary.device = times[t].device;
+				summary.stage = times[t].stage;
+				summary.count = 0;
+				summary.total = 0.0;
+				summary.min = times[t].milliseconds;
+				summary.max = times[t].milliseconds;
+
+				summaries.push_back(summary);
+
+			}
+
+			StageSummary &summary = summaries[s];
+
+			summary.count++;
+			summary.total += times[t].milliseconds;
+			if(times[t].milliseconds < summary.min) summary.min = times[t].milliseconds;
+			if(times[t].milliseconds > summary.max) summary.max = times[t].milliseconds;
+
+		}
 
-		printf("Error: Failed to build program executable!\n%s\n", err_code(ret));
-		clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &len);
-		printf("%s\n", buffer);
-		//return EXIT_FAILURE;
-		exit(1);
 	}
-	/* Create OpenCL Kernel */
-	kernel = clCreateKernel(program, "edgeDetectionOpenCL", &ret);
-	checkError(ret, "Creating kernel");
 
-	/* Create Memory Buffer */
-	d_pixels = clCreateBuffer(context, CL_MEM_READ_ONLY, size, NULL, &ret);
-	checkError(ret, "Creating buffer d_pixels");
-	d_tempImage = clCreateBuffer(context, CL_MEM_WRITE_ONLY, size, NULL, &ret);
-	checkError(ret, "Creating buffer d_tempImage");
+	if(json){
 
-    // Write a and b vectors into compute device memory
-    ret = clEnqueueWriteBuffer(command_queue, d_pixels, CL_TRUE, 0, size, pixels, 0, NULL, NULL);
-    checkError(ret, "Error Copying pixels to device at d_pixels");
+		fprintf(fp, "{\n\t\"devices\": [");
 
-	/* Set OpenCL Kernel Parameters */
-	ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&d_pixels);
-	checkError(ret, "Setting kernel arguments");
-	ret = clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&d_tempImage);
-	checkError(ret, "Setting kernel arguments");
-	ret = clSetKernelArg(kernel, 2, sizeof(int), &width);
-	checkError(ret, "Setting kernel arguments");
-	ret = clSetKernelArg(kernel, 3, sizeof(int), &height);
-	checkError(ret, "Setting kernel arguments");
-	ret = clSetKernelArg(kernel, 4, sizeof(int), &imageSize);
-	checkError(ret, "Setting kernel arguments");
+		for(unsigned int d = 0; d < devices.size(); d++){
 
-	//clEnqueueWriteBuffer(command_queue, pi, CL_TRUE, 0, 1, &h_pi, 0, NULL, NULL);
-	int blocks = (imageSize + (THREADS_PER_BLOCK - 1)) / THREADS_PER_BLOCK;
-	int threadsPerblock = THREADS_PER_BLOCK;
-	size_t global_work_size = blocks * threadsPerblock;
-	size_t local_work_size = threadsPerblock;
-	cl_uint work_dim = 1;
-	/* Execute OpenCL Kernel */
-	//ret = clEnqueueTask(command_queue, kernel, 0, NULL,NULL);  //single work item
-	ret = clEnqueueNDRangeKernel(command_queue, kernel, work_dim,
-			0, &global_work_size, &local_work_size, 0, NULL, NULL);
-	checkError(ret, "Enqueueing kernel");
-	ret = clFinish(command_queue);
-	checkError(ret, "Waiting for commands to finish");
-	/******************************************************************************/
-	/* Copy results from the memory buffer */
-	ret = clEnqueueReadBuffer(command_queue, d_tempImage, CL_TRUE, 0, size, tempImage, 0, NULL, NULL);
-	checkError(ret, "Getting results");
+			fprintf(fp, "%s%s", d > 0 ? ", " : "", jsonString(devices[d]).c_str());
 
-	/* Finalization */
-	ret = clFlush(command_queue);
-	ret = clFinish(command_queue);
-	ret = clReleaseKernel(kernel);
-	ret = clReleaseProgram(program);
-	ret = clReleaseMemObject(d_pixels);
-	ret = clReleaseMemObject(d_tempImage);
-	ret = clReleaseCommandQueue(command_queue);
-	ret = clReleaseContext(context);
+		}
 
-	free(source_str);
+		fprintf(fp, "],\n\t\"%s\": [\n", aggregate ? "summary" : "stages");
 
-	maxPixelValue = 255;
+		if(aggregate){
+
+			for(unsigned int s = 0; s < summaries.size(); s++){
+
+				fprintf(fp, "\t\t{\"device\": %d, \"stage\": \"%s\", \"count\": %d, \"total_ms\": %.6f,"
+						" \"mean_ms\": %.6f, \"min_ms\": %.6f, \"max_ms\": %.6f}%s\n",
+						summaries[s].device, summaries[s].stage.c_str(), summaries[s].count,
+						summaries[s].total, summaries[s].total / summaries[s].count,
+						summaries[s].min, summaries[s].max, s + 1 < summaries.size() ? "," : "");
+
+			}
+
+		}else{
+
+			for(unsigned int t = 0; t < times.size(); t++){
+
+				fprintf(fp, "\t\t{\"frame\": %d, \"device\": %d, \"stage\": \"%s\", \"ms\": %.6f}%s\n",
+						times[t].frame, times[t].device, times[t].stage.c_str(), times[t].milliseconds,
+						t + 1 < times.size() ? "," : "");
+
+			}
+
+		}
+
+		fprintf(fp, "\t]\n}\n");
+
+	}else if(aggregate){
+
+		fprintf(fp, "device;stage;count;total_ms;mean_ms;min_ms;max_ms\n");
+
+		for(unsigned int s = 0; s < summaries.size(); s++){
+
+			fprintf(fp, "%d;%s;%d;%.6f;%.6f;%.6f;%.6f\n", summaries[s].device, summaries[s].stage.c_str(),
+					summaries[s].count, summaries[s].total, summaries[s].total / summaries[s].count,
+					summaries[s].min, summaries[s].max);
+
+		}
+
+	}else{
+
+		fprintf(fp, "frame;device;stage;ms\n");
+
+		for(unsigned int t = 0; t < times.size(); t++){
+
+			fprintf(fp, "%d;%d;%s;%.6f\n", times[t].frame, times[t].device,
+					times[t].stage.c_str(), times[t].milliseconds);
+
+		}
 
-	for(unsigned int i = 0; i < imageSize; i++){
-		pixels[i] = tempImage[i];
 	}
 
-	/* Clean-up host */
-	free(tempImage);
+	fclose(fp);
+
 }
 
-bool isBinary(ifstream &inFile);
+//Every device of every platform, in platform order
+vector<cl_device_id> listDevices(){
 
-void run(char **argv);
+	vector<cl_device_id> devices;
 
-int main(int argc, char **argv){
+	cl_uint numPlatforms = 0;
 
-	if(argc != 3){
+	cl_int ret = clGetPlatformIDs(0, NULL, &numPlatforms);
+	checkError(ret, "Getting platforms");
 
-		cerr << "Usage: EdgeDetection imageName.pgm output.pgm";
+	vector<cl_platform_id> platforms(numPlatforms);
 
-		return 1;
+	ret = clGetPlatformIDs(numPlatforms, &platforms[0], NULL);
+	checkError(ret, "Getting platforms");
 
-	}
+	for(cl_uint p = 0; p < numPlatforms; p++){
 
-	//long start, end;
+		cl_uint numDevices = 0;
 
-	//double total;
+		//A platform without devices is not an error
+		if(clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, 0, NULL, &numDevices) != CL_SUCCESS
+				|| numDevices == 0) continue;
 
-	//start = clock();
+		vector<cl_device_id> platformDevices(numDevices);
 
-	run(argv);
+		ret = clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, numDevices, &platformDevices[0], NULL);
+		checkError(ret, "Getting devices");
 
-	//end = clock();
+		devices.insert(devices.end(), platformDevices.begin(), platformDevices.end());
 
-	//total = (double)(end - start)/1000;
+	}
 
-	//cout << "Execution time: " << total << endl;
+	return devices;
 
-	return 0;
 }
 
+string deviceName(cl_device_id device){
 
-bool isBinary(ifstream &inFile){
+	char name[256] = "";
 
-	char readChar = ' ';
+	clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name), name, NULL);
 
-	string errorMessage = "Error: incorrect picture format.";
+	return string(name);
 
-	//If there is no character or the character is not equal to 'P'
-	//then return an error
-	if(!(inFile >> readChar) || ( readChar != 'P' )){
+}
 
-		cerr << errorMessage << endl;
-		cerr << "P" << endl;
+cl_device_type deviceType(cl_device_id device){
 
-		exit(1002);
+	cl_device_type type = 0;
+
+	clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(type), &type, NULL);
+
+	return type;
+
+}
+
+//Prints the index, type and name used by -device
+void printDevices(){
+
+	vector<cl_device_id> devices = listDevices();
+
+	for(unsigned int d = 0; d < devices.size(); d++){
+
+		cl_device_type type = deviceType(devices[d]);
+
+		printf("%u\t%s\t%s\n", d,
+				(type & CL_DEVICE_TYPE_GPU) ? "gpu" : (type & CL_DEVICE_TYPE_CPU) ? "cpu" : "accelerator",
+				deviceName(devices[d]).c_str());
 
 	}
 
-	//If there is no character or the second character is not a 2 or 5
-	//then return an error
-	if(!(inFile >> readChar) || ( readChar != '2' && readChar != '5')){
+}
 
-		cerr << errorMessage << endl;
-		cerr << readChar << endl;
+//Picks devices by type (gpu, cpu, accelerator, all), by index in listDevices
+//or by a substring of the device name. Without a spec every GPU is used,
+//falling back to the CPUs and then to whatever the platforms expose
+vector<cl_device_id> selectDevices(const string &spec){
 
-		exit(1002);
+	vector<cl_device_id> devices = listDevices();
+	vector<cl_device_id> selected;
+
+	if(devices.empty()){
+
+		cerr << "Error: no OpenCL devices found." << endl;
+
+		exit(1);
 
 	}
 
-	if(readChar == '5') return true;
+	if(spec.empty()){
 
-	return false;
+		cl_device_type fallback[3] = {CL_DEVICE_TYPE_GPU, CL_DEVICE_TYPE_CPU, CL_DEVICE_TYPE_ALL};
 
-}
+		for(int f = 0; f < 3 && selected.empty(); f++){
 
-void run(char **argv){
+			for(unsigned int d = 0; d < devices.size(); d++){
 
-	ifstream inFile;
+				if(deviceType(devices[d]) & fallback[f]) selected.push_back(devices[d]);
 
-	inFile.open(argv[1], ios::binary | ios::in);
+			}
 
-	ofstream outFile;
+		}
 
-	outFile.open(argv[2], ios::binary
-			            | ios::out
-						| ios::trunc);
+		return selected;
 
-	//int blocks = strtol(argv[3], NULL, 10);
-	//int threadsPerblock = strtol(argv[4], NULL, 10);
+	}
 
-	//printf("blocks=%d\n", blocks);
-	//printf("threadsPerblock=%d\n", threadsPerblock);
+	cl_device_type type = 0;
 
-	if(isBinary(inFile)){
+	if(spec == "gpu") type = CL_DEVICE_TYPE_GPU;
+	else if(spec == "cpu") type = CL_DEVICE_TYPE_CPU;
+	else if(spec == "accelerator") type = CL_DEVICE_TYPE_ACCELERATOR;
+	else if(spec == "all") type = CL_DEVICE_TYPE_ALL;
 
-		BinaryImage binaryImage;
+	bool isIndex = spec.find_first_not_of("0123456789") == string::npos;
 
-		binaryImage.readHeader(inFile);
+	for(unsigned int d = 0; d < devices.size(); d++){
 
-		binaryImage.readImage(inFile);
+		if(type != 0){
 
-		binaryImage.edgeDection();
+			if(deviceType(devices[d]) & type) selected.push_back(devices[d]);
 
-		binaryImage.scaleImage();
+		}else if(isIndex){
 
-		binaryImage.writeImage(outFile);
+			if(d == (unsigned int)atoi(spec.c_str())) selected.push_back(devices[d]);
 
-	}else{
+		}else if(deviceName(devices[d]).find(spec) != string::npos){
 
-		AsciiImage asciiImage;
+			selected.push_back(devices[d]);
 
-		asciiImage.readHeader(inFile);
+		}
 
-		asciiImage.readImage(inFile);
+	}
 
-		asciiImage.edgeDection();
+	if(selected.empty()){
 
-		asciiImage.scaleImage();
+		cerr << "Error: no OpenCL device matches '" << spec << "'." << endl;
 
-		asciiImage.writeImage(outFile);
+		exit(1);
 
 	}
 
-	inFile.close();
-	outFile.close();
+	return selected;
+
+}
+
+//Loads the kernel source, builds the program and creates the queues and kernels
+void OpenCLEngine::init(cl_device_id device){
+
+	cl_int ret;
+
+	device_id = device;
+
+	/******************************************************************************/
+	/* open kernel */
+	FILE *fp;
+	char fileName[] = "./EdgeDetectionOpenCL.cl";
+	char *source_str[2];
+	size_t source_size[2];
+	cl_uint sources = stencilName.empty() ? 1 : 2;
+
+	/* Load the source code containing the kernels, a generated stencil
+	source comes second since it calls isqrtOpenCL */
+	for(cl_uint s = 0; s < sources; s++){
+		fp = fopen(s == 0 ? fileName : stencilName.c_str(), "r");
+		if (!fp) {
+			fprintf(stderr, "Failed to load kernel.\n");
+			exit(1);
+		}
+		source_str[s] = (char*)malloc(MAX_SOURCE_SIZE);
+		source_size[s] = fread(source_str[s], 1, MAX_SOURCE_SIZE, fp);
+		fclose(fp);
+	}
+
+	/******************************************************************************/
+	/* create objects */
+
+	/* Largest power of two work-group up to THREADS_PER_BLOCK, CPU devices
+	may allow fewer work items */
+	size_t maxWorkGroup = THREADS_PER_BLOCK;
+	clGetDeviceInfo(device_id, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &maxWorkGroup, NULL);
+	localSize = 1;
+	while(localSize * 2 <= (size_t)THREADS_PER_BLOCK && localSize * 2 <= maxWorkGroup) localSize *= 2;
+
+	/* Create OpenCL context */
+	context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &ret);
+	checkError(ret, "Creating context");
+
+	/* Create Command Queues, transfers get their own queues so they can
+	overlap with kernels of another frame */
+	cl_command_queue_properties properties = profiler != NULL ? CL_QUEUE_PROFILING_ENABLE : 0;
+	for(int q = 0; q < QUEUE_COUNT; q++){
+		queues[q] = clCreateCommandQueue(context, device_id, properties, &ret);
+		checkError(ret, "Creating queue");
+	}
+
+	/******************************************************************************/
+	/* create build program */
+
+	/* Create Kernel Program from the source */
+	program = clCreateProgramWithSource(context, sources, (const char **)source_str,
+	(const size_t *)source_size, &ret);
+	checkError(ret, "Creating program");
+
+	/* Build Kernel Program */
+	double buildStart = wallTime();
+	ret = clBuildProgram(program, 1, &device_id, NULL, NULL, NULL);
+	if (ret != CL_SUCCESS)
+	{
+		size_t len;
+		char buffer[2048];
+
+		printf("Error: Failed to build program executable!\n%s\n", err_code(ret));
+		clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, sizeof(buffer), buffer, &len);
+		printf("%s\n", buffer);
+		exit(1);
+	}
+	recordHost("build", buildStart);
+
+	/* Create OpenCL Kernels */
+	const char *edgeName = "edgeDetectionOpenCL";
+	if(!stencilName.empty()) edgeName = "stencilOpenCL";
+	else if(magnitudeName == "l1") edgeName = "edgeDetectionL1OpenCL";
+	else if(magnitudeName == "maxmin") edgeName = "edgeDetectionMaxMinOpenCL";
+	edgeKernel = clCreateKernel(program, edgeName, &ret);
+	checkError(ret, (string("Creating kernel ") + edgeName).c_str());
+	scaleKernel = clCreateKernel(program, "scaleImageOpenCL", &ret);
+	checkError(ret, "Creating kernel scaleImageOpenCL");
+	minMaxKernel = clCreateKernel(program, "minMaxOpenCL", &ret);
+	checkError(ret, "Creating kernel minMaxOpenCL");
+	scaleMinMaxKernel = clCreateKernel(program, "scaleImageMinMaxOpenCL", &ret);
+	checkError(ret, "Creating kernel scaleImageMinMaxOpenCL");
+	magnitudeTableKernel = clCreateKernel(program, "magnitudeTableOpenCL", &ret);
+	checkError(ret, "Creating kernel magnitudeTableOpenCL");
+	scaleTableKernel = clCreateKernel(program, "scaleTableOpenCL", &ret);
+	checkError(ret, "Creating kernel scaleTableOpenCL");
+	gaussianRowsKernel = clCreateKernel(program, "gaussianRowsOpenCL", &ret);
+	checkError(ret, "Creating kernel gaussianRowsOpenCL");
+	gaussianColumnsKernel = clCreateKernel(program, "gaussianColumnsOpenCL", &ret);
+	checkError(ret, "Creating kernel gaussianColumnsOpenCL");
+	sobelDirectionKernel = clCreateKernel(program, "sobelDirectionOpenCL", &ret);
+	checkError(ret, "Creating kernel sobelDirectionOpenCL");
+	nonMaxSuppressionKernel = clCreateKernel(program, "nonMaxSuppressionOpenCL", &ret);
+	checkError(ret, "Creating kernel nonMaxSuppressionOpenCL");
+	hysteresisKernel = clCreateKernel(program, "hysteresisOpenCL", &ret);
+	checkError(ret, "Creating kernel hysteresisOpenCL");
+	cannyOutputKernel = clCreateKernel(program, "cannyOutputOpenCL", &ret);
+	checkError(ret, "Creating kernel cannyOutputOpenCL");
+	histogramKernel = clCreateKernel(program, "histogramOpenCL", &ret);
+	checkError(ret, "Creating kernel histogramOpenCL");
+	applyTableKernel = clCreateKernel(program, "applyTableOpenCL", &ret);
+	checkError(ret, "Creating kernel applyTableOpenCL");
+
+	for(cl_uint s = 0; s < sources; s++) free(source_str[s]);
+
+}
+
+//Releases every object created by init
+void OpenCLEngine::release(){
+
+	for(int q = 0; q < QUEUE_COUNT; q++){
+		clFlush(queues[q]);
+		clFinish(queues[q]);
+	}
+
+	clReleaseKernel(edgeKernel);
+	clReleaseKernel(scaleKernel);
+	clReleaseKernel(minMaxKernel);
+	clReleaseKernel(scaleMinMaxKernel);
+	clReleaseKernel(magnitudeTableKernel);
+	clReleaseKernel(scaleTableKernel);
+	clReleaseKernel(gaussianRowsKernel);
+	clReleaseKernel(gaussianColumnsKernel);
+	clReleaseKernel(sobelDirectionKernel);
+	clReleaseKernel(nonMaxSuppressionKernel);
+	clReleaseKernel(hysteresisKernel);
+	clReleaseKernel(cannyOutputKernel);
+	clReleaseKernel(histogramKernel);
+	clReleaseKernel(applyTableKernel);
+	clReleaseProgram(program);
+
+	for(int q = 0; q < QUEUE_COUNT; q++){
+		clReleaseCommandQueue(queues[q]);
+	}
+
+	clReleaseContext(context);
+
+}
+
+//True for CPU and integrated devices, where CL_MEM_USE_HOST_PTR buffers are
+//used in place and mapping them costs nothing
+bool OpenCLEngine::hostUnifiedMemory(){
+
+	cl_bool unified = CL_FALSE;
+
+	clGetDeviceInfo(device_id, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &unified, NULL);
+
+	return unified == CL_TRUE;
+
+}
+
+void OpenCLEngine::record(const char *stage, cl_event event, int frame){
+
+	if(profiler != NULL) profiler->addEvent(frame, index, stage, event);
+
+	clReleaseEvent(event);
+
+}
+
+void OpenCLEngine::recordHost(const char *stage, double start, int frame){
+
+	if(profiler != NULL) profiler->addTime(frame, index, stage, wallTime() - start);
+
+}
+
+//Scales image so that the maximum pixel value is 255
+void Image::scaleImage(OpenCLEngine &engine){
+
+	double start = wallTime();
+
+	findMin();
+
+	findMax();
+
+	engine.recordHost("host_minmax", start);
+
+	size_t size = imageSize * sizeof(int);
+
+	cl_command_queue command_queue = engine.queues[OpenCLEngine::COMPUTE_QUEUE];
+	cl_kernel kernel = engine.scaleKernel;
+	cl_mem d_pixels = NULL;
+	cl_event event;
+	cl_int ret;
+
+	/* Create Memory Buffer */
+	if(engine.zeroCopy){
+
+		d_pixels = clCreateBuffer(engine.context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, size, pixels, &ret);
+		checkError(ret, "Creating buffer d_pixels");
+
+	}else{
+
+		d_pixels = clCreateBuffer(engine.context, CL_MEM_READ_WRITE, size, NULL, &ret);
+		checkError(ret, "Creating buffer d_pixels");
+
+	    // Write a and b vectors into compute device memory
+	    ret = clEnqueueWriteBuffer(command_queue, d_pixels, CL_TRUE, 0, size, pixels, 0, NULL, &event);
+	    checkError(ret, "Error Copying h_a to device at d_a");
+	    engine.record("h2d", event);
+
+	}
+
+	/* Set OpenCL Kernel Parameters */
+	ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&d_pixels);
+	checkError(ret, "Setting kernel arguments");
+	ret = clSetKernelArg(kernel, 1, sizeof(int), &minpix);
+	checkError(ret, "Setting kernel arguments");
+	ret = clSetKernelArg(kernel, 2, sizeof(int), &maxpix);
+	checkError(ret, "Setting kernel arguments");
+	ret = clSetKernelArg(kernel, 3, sizeof(int), &imageSize);
+	checkError(ret, "Setting kernel arguments");
+
+	int threadsPerblock = engine.localSize;
+	int blocks = (imageSize + (threadsPerblock - 1)) / threadsPerblock;
+	size_t global_work_size = blocks * threadsPerblock;
+	size_t local_work_size = threadsPerblock;
+	cl_uint work_dim = 1;
+	/* Execute OpenCL Kernel */
+	ret = clEnqueueNDRangeKernel(command_queue, kernel, work_dim,
+			0, &global_work_size, &local_work_size, 0, NULL, &event);
+	checkError(ret, "Enqueueing kernel");
+	ret = clFinish(command_queue);
+	checkError(ret, "Waiting for commands to finish");
+	engine.record("kernel_scale", event);
+	/******************************************************************************/
+	/* Copy results from the memory buffer, mapping only synchronizes pixels
+	and is free when the device shares memory with the host */
+	if(engine.zeroCopy){
+
+		void * mapped = clEnqueueMapBuffer(command_queue, d_pixels, CL_TRUE, CL_MAP_READ,
+				0, size, 0, NULL, &event, &ret);
+		checkError(ret, "Mapping results");
+		engine.record("d2h", event);
+		ret = clEnqueueUnmapMemObject(command_queue, d_pixels, mapped, 0, NULL, NULL);
+		checkError(ret, "Unmapping results");
+
+	}else{
+
+		ret = clEnqueueReadBuffer(command_queue, d_pixels, CL_TRUE, 0, size, pixels, 0, NULL, &event);
+		checkError(ret, "Getting results");
+		engine.record("d2h", event);
+
+	}
+
+	/* Finalization */
+	ret = clReleaseMemObject(d_pixels);
+
+	maxPixelValue = 255;
+}
+
+//Sobel edge detection function - detects edges and draws an outline
+void Image::edgeDection(OpenCLEngine &engine) {
+	size_t size = imageSize * sizeof(int);
+	int * tempImage = allocPixels(imageSize);
+
+	cl_command_queue command_queue = engine.queues[OpenCLEngine::COMPUTE_QUEUE];
+	cl_kernel kernel = engine.edgeKernel;
+	cl_mem d_pixels = NULL;
+	cl_mem d_tempImage = NULL;
+	cl_event event;
+	cl_int ret;
+
+	/* Create Memory Buffer */
+	if(engine.zeroCopy){
+
+		d_pixels = clCreateBuffer(engine.context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, size, pixels, &ret);
+		checkError(ret, "Creating buffer d_pixels");
+		d_tempImage = clCreateBuffer(engine.context, CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR, size, tempImage, &ret);
+		checkError(ret, "Creating buffer d_tempImage");
+
+	}else{
+
+		d_pixels = clCreateBuffer(engine.context, CL_MEM_READ_ONLY, size, NULL, &ret);
+		checkError(ret, "Creating buffer d_pixels");
+		d_tempImage = clCreateBuffer(engine.context, CL_MEM_WRITE_ONLY, size, NULL, &ret);
+		checkError(ret, "Creating buffer d_tempImage");
+
+	    // Write a and b vectors into compute device memory
+	    ret = clEnqueueWriteBuffer(command_queue, d_pixels, CL_TRUE, 0, size, pixels, 0, NULL, &event);
+	    checkError(ret, "Error Copying pixels to device at d_pixels");
+	    engine.record("h2d", event);
+
+	}
+
+	/* Set OpenCL Kernel Parameters */
+	ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&d_pixels);
+	checkError(ret, "Setting kernel arguments");
+	ret = clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&d_tempImage);
+	checkError(ret, "Setting kernel arguments");
+	ret = clSetKernelArg(kernel, 2, sizeof(int), &width);
+	checkError(ret, "Setting kernel arguments");
+	ret = clSetKernelArg(kernel, 3, sizeof(int), &height);
+	checkError(ret, "Setting kernel arguments");
+	ret = clSetKernelArg(kernel, 4, sizeof(int), &imageSize);
+	checkError(ret, "Setting kernel arguments");
+
+	int threadsPerblock = engine.localSize;
+	int blocks = (imageSize + (threadsPerblock - 1)) / threadsPerblock;
+	size_t global_work_size = blocks * threadsPerblock;
+	size_t local_work_size = threadsPerblock;
+	cl_uint work_dim = 1;
+	/* Execute OpenCL Kernel */
+	ret = clEnqueueNDRangeKernel(command_queue, kernel, work_dim,
+			0, &global_work_size, &local_work_size, 0, NULL, &event);
+	checkError(ret, "Enqueueing kernel");
+	ret = clFinish(command_queue);
+	checkError(ret, "Waiting for commands to finish");
+	engine.record("kernel_edge", event);
+	/******************************************************************************/
+	/* Copy results from the memory buffer */
+	if(engine.zeroCopy){
+
+		void * mapped = clEnqueueMapBuffer(command_queue, d_tempImage, CL_TRUE, CL_MAP_READ,
+				0, size, 0, NULL, &event, &ret);
+		checkError(ret, "Mapping results");
+		engine.record("d2h", event);
+		ret = clEnqueueUnmapMemObject(command_queue, d_tempImage, mapped, 0, NULL, NULL);
+		checkError(ret, "Unmapping results");
+
+	}else{
+
+		ret = clEnqueueReadBuffer(command_queue, d_tempImage, CL_TRUE, 0, size, tempImage, 0, NULL, &event);
+		checkError(ret, "Getting results");
+		engine.record("d2h", event);
+
+	}
+
+	/* Finalization */
+	ret = clReleaseMemObject(d_pixels);
+	ret = clReleaseMemObject(d_tempImage);
+
+	maxPixelValue = 255;
+
+	/* tempImage already holds the result, swap it in instead of copying */
+	free(pixels);
+	pixels = tempImage;
+}
+
+//Enqueues kernel over one work item per pixel on the compute queue without
+//waiting for it. The in-order queue keeps the kernels in sequence, the
+//caller records the returned event once a later blocking call finished it
+cl_event enqueuePixelKernel(OpenCLEngine &engine, cl_kernel kernel, unsigned int imageSize){
+
+	cl_command_queue command_queue = engine.queues[OpenCLEngine::COMPUTE_QUEUE];
+	cl_event event;
+	cl_int ret;
+
+	int threadsPerblock = engine.localSize;
+	int blocks = (imageSize + (threadsPerblock - 1)) / threadsPerblock;
+	size_t global_work_size = blocks * threadsPerblock;
+	size_t local_work_size = threadsPerblock;
+
+	ret = clEnqueueNDRangeKernel(command_queue, kernel, 1,
+			0, &global_work_size, &local_work_size, 0, NULL, &event);
+	checkError(ret, "Enqueueing kernel");
+
+	return event;
+
+}
+
+//Canny edge detection, every stage stays on the device and only the input
+//and the final edges cross the bus. low and high are gradient magnitudes
+//of at most MAX_GRADIENT, so their squares fit in an int
+void Image::cannyEdgeDetection(OpenCLEngine &engine, int low, int high){
+
+	size_t size = imageSize * sizeof(int);
+	int * tempImage = allocPixels(imageSize);
+	int lowSquared = low * low;
+	int highSquared = high * high;
+	int zero = 0;
+	int changed = 1;
+
+	cl_command_queue command_queue = engine.queues[OpenCLEngine::COMPUTE_QUEUE];
+	cl_event event;
+	cl_int ret;
+
+	/* Create Memory Buffers, d_temp holds the row blur then the magnitudes */
+	cl_mem d_pixels = clCreateBuffer(engine.context, CL_MEM_READ_WRITE, size, NULL, &ret);
+	checkError(ret, "Creating buffer d_pixels");
+	cl_mem d_temp = clCreateBuffer(engine.context, CL_MEM_READ_WRITE, size, NULL, &ret);
+	checkError(ret, "Creating buffer d_temp");
+	cl_mem d_blurred = clCreateBuffer(engine.context, CL_MEM_READ_WRITE, size, NULL, &ret);
+	checkError(ret, "Creating buffer d_blurred");
+	cl_mem d_sector = clCreateBuffer(engine.context, CL_MEM_READ_WRITE, imageSize, NULL, &ret);
+	checkError(ret, "Creating buffer d_sector");
+	cl_mem d_labels = clCreateBuffer(engine.context, CL_MEM_READ_WRITE, imageSize, NULL, &ret);
+	checkError(ret, "Creating buffer d_labels");
+	cl_mem d_changed = clCreateBuffer(engine.context, CL_MEM_READ_WRITE, sizeof(int), NULL, &ret);
+	checkError(ret, "Creating buffer d_changed");
+
+	ret = clEnqueueWriteBuffer(command_queue, d_pixels, CL_TRUE, 0, size, pixels, 0, NULL, &event);
+	checkError(ret, "Error Copying pixels to device at d_pixels");
+	engine.record("h2d", event);
+
+	/* Set OpenCL Kernel Parameters */
+	ret = clSetKernelArg(engine.gaussianRowsKernel, 0, sizeof(cl_mem), (void *)&d_pixels);
+	ret |= clSetKernelArg(engine.gaussianRowsKernel, 1, sizeof(cl_mem), (void *)&d_temp);
+	ret |= clSetKernelArg(engine.gaussianRowsKernel, 2, sizeof(int), &width);
+	ret |= clSetKernelArg(engine.gaussianRowsKernel, 3, sizeof(int), &height);
+	ret |= clSetKernelArg(engine.gaussianRowsKernel, 4, sizeof(int), &imageSize);
+	ret |= clSetKernelArg(engine.gaussianColumnsKernel, 0, sizeof(cl_mem), (void *)&d_temp);
+	ret |= clSetKernelArg(engine.gaussianColumnsKernel, 1, sizeof(cl_mem), (void *)&d_blurred);
+	ret |= clSetKernelArg(engine.gaussianColumnsKernel, 2, sizeof(int), &width);
+	ret |= clSetKernelArg(engine.gaussianColumnsKernel, 3, sizeof(int), &height);
+	ret |= clSetKernelArg(engine.gaussianColumnsKernel, 4, sizeof(int), &imageSize);
+	ret |= clSetKernelArg(engine.sobelDirectionKernel, 0, sizeof(cl_mem), (void *)&d_blurred);
+	ret |= clSetKernelArg(engine.sobelDirectionKernel, 1, sizeof(cl_mem), (void *)&d_temp);
+	ret |= clSetKernelArg(engine.sobelDirectionKernel, 2, sizeof(cl_mem), (void *)&d_sector);
+	ret |= clSetKernelArg(engine.sobelDirectionKernel, 3, sizeof(int), &width);
+	ret |= clSetKernelArg(engine.sobelDirectionKernel, 4, sizeof(int), &height);
+	ret |= clSetKernelArg(engine.sobelDirectionKernel, 5, sizeof(int), &imageSize);
+	ret |= clSetKernelArg(engine.nonMaxSuppressionKernel, 0, sizeof(cl_mem), (void *)&d_temp);
+	ret |= clSetKernelArg(engine.nonMaxSuppressionKernel, 1, sizeof(cl_mem), (void *)&d_sector);
+	ret |= clSetKernelArg(engine.nonMaxSuppressionKernel, 2, sizeof(cl_mem), (void *)&d_labels);
+	ret |= clSetKernelArg(engine.nonMaxSuppressionKernel, 3, sizeof(int), &width);
+	ret |= clSetKernelArg(engine.nonMaxSuppressionKernel, 4, sizeof(int), &height);
+	ret |= clSetKernelArg(engine.nonMaxSuppressionKernel, 5, sizeof(int), &imageSize);
+	ret |= clSetKernelArg(engine.nonMaxSuppressionKernel, 6, sizeof(int), &lowSquared);
+	ret |= clSetKernelArg(engine.nonMaxSuppressionKernel, 7, sizeof(int), &highSquared);
+	ret |= clSetKernelArg(engine.hysteresisKernel, 0, sizeof(cl_mem), (void *)&d_labels);
+	ret |= clSetKernelArg(engine.hysteresisKernel, 1, sizeof(cl_mem), (void *)&d_changed);
+	ret |= clSetKernelArg(engine.hysteresisKernel, 2, sizeof(int), &width);
+	ret |= clSetKernelArg(engine.hysteresisKernel, 3, sizeof(int), &imageSize);
+	ret |= clSetKernelArg(engine.cannyOutputKernel, 0, sizeof(cl_mem), (void *)&d_labels);
+	ret |= clSetKernelArg(engine.cannyOutputKernel, 1, sizeof(cl_mem), (void *)&d_pixels);
+	ret |= clSetKernelArg(engine.cannyOutputKernel, 2, sizeof(int), &imageSize);
+	checkError(ret, "Setting kernel arguments");
+
+	/* Kernel events and their stages, recorded after the final read */
+	vector<cl_event> kernelEvents;
+	vector<const char *> kernelStages;
+
+	/* The stages follow each other on the in-order queue with no host wait */
+	kernelEvents.push_back(enqueuePixelKernel(engine, engine.gaussianRowsKernel, imageSize));
+	kernelStages.push_back("kernel_blur");
+	kernelEvents.push_back(enqueuePixelKernel(engine, engine.gaussianColumnsKernel, imageSize));
+	kernelStages.push_back("kernel_blur");
+	kernelEvents.push_back(enqueuePixelKernel(engine, engine.sobelDirectionKernel, imageSize));
+	kernelStages.push_back("kernel_edge");
+	kernelEvents.push_back(enqueuePixelKernel(engine, engine.nonMaxSuppressionKernel, imageSize));
+	kernelStages.push_back("kernel_nms");
+
+	/* Sweep until no weak pixel changes. Each sweep reads back only the
+	 * flag, queued behind its kernel, and waits for that read alone */
+	while(changed){
+
+		ret = clEnqueueWriteBuffer(command_queue, d_changed, CL_FALSE, 0, sizeof(int), &zero, 0, NULL, NULL);
+		checkError(ret, "Clearing d_changed");
+
+		cl_event sweepEvent = enqueuePixelKernel(engine, engine.hysteresisKernel, imageSize);
+		cl_event flagEvent;
+
+		kernelEvents.push_back(sweepEvent);
+		kernelStages.push_back("kernel_hysteresis");
+
+		ret = clEnqueueReadBuffer(command_queue, d_changed, CL_FALSE, 0, sizeof(int), &changed, 1, &sweepEvent,
+				&flagEvent);
+		checkError(ret, "Reading d_changed");
+		ret = clWaitForEvents(1, &flagEvent);
+		checkError(ret, "Waiting for d_changed");
+		clReleaseEvent(flagEvent);
+
+	}
+
+	kernelEvents.push_back(enqueuePixelKernel(engine, engine.cannyOutputKernel, imageSize));
+	kernelStages.push_back("kernel_output");
+
+	ret = clEnqueueReadBuffer(command_queue, d_pixels, CL_TRUE, 0, size, tempImage, 0, NULL, &event);
+	checkError(ret, "Getting results");
+
+	for(unsigned int k = 0; k < kernelEvents.size(); k++) engine.record(kernelStages[k], kernelEvents[k]);
+
+	engine.record("d2h", event);
+
+	/* Finalization */
+	ret = clReleaseMemObject(d_pixels);
+	ret = clReleaseMemObject(d_temp);
+	ret = clReleaseMemObject(d_blurred);
+	ret = clReleaseMemObject(d_sector);
+	ret = clReleaseMemObject(d_labels);
+	ret = clReleaseMemObject(d_changed);
+
+	maxPixelValue = 255;
+
+	free(pixels);
+	pixels = tempImage;
+
+}
+
+//Percentile or equalized stretch. The magnitudes are uploaded again, as
+//the edge detection pass has already read them back, the histogram is
+//built on the device and read back for the host to turn into a table,
+//and the table is applied on the device
+void Image::normalizeImage(OpenCLEngine &engine, const Normalization &normalization){
+
+	size_t size = imageSize * sizeof(int);
+	int bins = HISTOGRAM_BINS;
+
+	vector<unsigned int> histogram(HISTOGRAM_BINS, 0);
+	vector<unsigned char> table(HISTOGRAM_BINS);
+
+	cl_command_queue command_queue = engine.queues[OpenCLEngine::COMPUTE_QUEUE];
+	cl_event event;
+	cl_int ret;
+
+	/* Create Memory Buffers */
+	cl_mem d_pixels = clCreateBuffer(engine.context, CL_MEM_READ_WRITE, size, NULL, &ret);
+	checkError(ret, "Creating buffer d_pixels");
+	cl_mem d_histogram = clCreateBuffer(engine.context, CL_MEM_READ_WRITE, bins * sizeof(unsigned int), NULL, &ret);
+	checkError(ret, "Creating buffer d_histogram");
+	cl_mem d_table = clCreateBuffer(engine.context, CL_MEM_READ_ONLY, bins, NULL, &ret);
+	checkError(ret, "Creating buffer d_table");
+
+	ret = clEnqueueWriteBuffer(command_queue, d_pixels, CL_TRUE, 0, size, pixels, 0, NULL, &event);
+	checkError(ret, "Error Copying pixels to device at d_pixels");
+	engine.record("h2d", event);
+
+	ret = clEnqueueWriteBuffer(command_queue, d_histogram, CL_TRUE, 0, bins * sizeof(unsigned int),
+			&histogram[0], 0, NULL, NULL);
+	checkError(ret, "Clearing d_histogram");
+
+	/* Set OpenCL Kernel Parameters */
+	ret = clSetKernelArg(engine.histogramKernel, 0, sizeof(cl_mem), (void *)&d_pixels);
+	ret |= clSetKernelArg(engine.histogramKernel, 1, sizeof(cl_mem), (void *)&d_histogram);
+	ret |= clSetKernelArg(engine.histogramKernel, 2, sizeof(int), &bins);
+	ret |= clSetKernelArg(engine.histogramKernel, 3, sizeof(int), &imageSize);
+	ret |= clSetKernelArg(engine.applyTableKernel, 0, sizeof(cl_mem), (void *)&d_pixels);
+	ret |= clSetKernelArg(engine.applyTableKernel, 1, sizeof(cl_mem), (void *)&d_table);
+	ret |= clSetKernelArg(engine.applyTableKernel, 2, sizeof(int), &bins);
+	ret |= clSetKernelArg(engine.applyTableKernel, 3, sizeof(int), &imageSize);
+	checkError(ret, "Setting kernel arguments");
+
+	/* Enough work items for HISTOGRAM_PIXELS_PER_ITEM pixels each */
+	size_t local_work_size = engine.localSize;
+	size_t items = (imageSize + HISTOGRAM_PIXELS_PER_ITEM - 1) / HISTOGRAM_PIXELS_PER_ITEM;
+	size_t global_work_size = ((items + local_work_size - 1) / local_work_size) * local_work_size;
+
+	ret = clEnqueueNDRangeKernel(command_queue, engine.histogramKernel, 1,
+			0, &global_work_size, &local_work_size, 0, NULL, &event);
+	checkError(ret, "Enqueueing kernel");
+	ret = clFinish(command_queue);
+	checkError(ret, "Waiting for commands to finish");
+	engine.record("kernel_histogram", event);
+
+	ret = clEnqueueReadBuffer(command_queue, d_histogram, CL_TRUE, 0, bins * sizeof(unsigned int),
+			&histogram[0], 0, NULL, &event);
+	checkError(ret, "Getting histogram");
+	engine.record("d2h", event);
+
+	double start = wallTime();
+
+	normalizationTable(&histogram[0], imageSize, normalization, &table[0]);
+
+	engine.recordHost("host_table", start);
+
+	ret = clEnqueueWriteBuffer(command_queue, d_table, CL_TRUE, 0, bins, &table[0], 0, NULL, &event);
+	checkError(ret, "Error Copying table to device at d_table");
+	engine.record("h2d", event);
+
+	cl_event tableEvent = enqueuePixelKernel(engine, engine.applyTableKernel, imageSize);
+
+	ret = clEnqueueReadBuffer(command_queue, d_pixels, CL_TRUE, 0, size, pixels, 0, NULL, &event);
+	checkError(ret, "Getting results");
+	engine.record("kernel_scale", tableEvent);
+	engine.record("d2h", event);
+
+	/* Finalization */
+	ret = clReleaseMemObject(d_pixels);
+	ret = clReleaseMemObject(d_histogram);
+	ret = clReleaseMemObject(d_table);
+
+	maxPixelValue = 255;
+
+}
+
+//Splits the rows between devices in proportion to the throughput each one
+//shows running Sobel over the first CALIBRATION_ROWS rows of this image
+void Image::balanceBands(OpenCLEngine *engines, int count, int *bandRows){
+
+	int calibrationRows = height < CALIBRATION_ROWS ? height : CALIBRATION_ROWS;
+	int calibrationSize = calibrationRows * width;
+	size_t size = calibrationSize * sizeof(int);
+
+	int * calibrationImage = allocPixels(calibrationSize);
+
+	vector<double> throughput(count);
+	double totalThroughput = 0.0;
+
+	cl_int ret;
+
+	for(int d = 0; d < count; d++){
+
+		OpenCLEngine &engine = engines[d];
+		cl_command_queue command_queue = engine.queues[OpenCLEngine::COMPUTE_QUEUE];
+
+		cl_mem d_pixels = clCreateBuffer(engine.context, CL_MEM_READ_ONLY, size, NULL, &ret);
+		checkError(ret, "Creating buffer d_pixels");
+		cl_mem d_tempImage = clCreateBuffer(engine.context, CL_MEM_WRITE_ONLY, size, NULL, &ret);
+		checkError(ret, "Creating buffer d_tempImage");
+
+		ret = clSetKernelArg(engine.edgeKernel, 0, sizeof(cl_mem), (void *)&d_pixels);
+		ret |= clSetKernelArg(engine.edgeKernel, 1, sizeof(cl_mem), (void *)&d_tempImage);
+		ret |= clSetKernelArg(engine.edgeKernel, 2, sizeof(int), &width);
+		ret |= clSetKernelArg(engine.edgeKernel, 3, sizeof(int), &calibrationRows);
+		ret |= clSetKernelArg(engine.edgeKernel, 4, sizeof(int), &calibrationSize);
+		checkError(ret, "Setting kernel arguments");
+
+		size_t local_work_size = engine.localSize;
+		size_t global_work_size = ((calibrationSize + local_work_size - 1) / local_work_size) * local_work_size;
+
+		//The first pass warms up the device, the second one is timed
+		double elapsed = 0.0;
+
+		for(int pass = 0; pass < 2; pass++){
+
+			double start = wallTime();
+
+			ret = clEnqueueWriteBuffer(command_queue, d_pixels, CL_FALSE, 0, size, pixels, 0, NULL, NULL);
+			checkError(ret, "Copying pixels to device at d_pixels");
+			ret = clEnqueueNDRangeKernel(command_queue, engine.edgeKernel, 1,
+					0, &global_work_size, &local_work_size, 0, NULL, NULL);
+			checkError(ret, "Enqueueing kernel");
+			ret = clEnqueueReadBuffer(command_queue, d_tempImage, CL_TRUE, 0, size, calibrationImage, 0, NULL, NULL);
+			checkError(ret, "Getting results");
+
+			elapsed = wallTime() - start;
+
+		}
+
+		clReleaseMemObject(d_pixels);
+		clReleaseMemObject(d_tempImage);
+
+		throughput[d] = calibrationRows / (elapsed > 0.0 ? elapsed : 1e-9);
+		totalThroughput += throughput[d];
+
+	}
+
+	free(calibrationImage);
+
+	//Proportional split, the last device takes the rounding remainder
+	int assigned = 0;
+
+	for(int d = 0; d < count; d++){
+
+		if(d == count - 1){
+
+			bandRows[d] = height - assigned;
+
+		}else{
+
+			bandRows[d] = (int)(height * (throughput[d] / totalThroughput));
+
+			if(bandRows[d] > height - assigned) bandRows[d] = height - assigned;
+
+		}
+
+		assigned += bandRows[d];
+
+	}
+
+}
+
+//Sobel over row bands, each device also receives HALO_ROWS rows above and
+//below its band so the stencil sees the neighbouring bands. The halo rows
+//fall on the zero padded border of the band and are not copied back
+void Image::edgeDectionBands(OpenCLEngine *engines, int count, int *bandRows){
+
+	int * tempImage = allocPixels(imageSize);
+
+	vector<cl_mem> d_pixels(count, (cl_mem)NULL);
+	vector<cl_mem> d_tempImage(count, (cl_mem)NULL);
+	vector<cl_event> writeEvents(count), kernelEvents(count), readEvents(count);
+
+	cl_int ret;
+
+	int firstRow = 0;
+
+	for(int d = 0; d < count; d++){
+
+		int rows = bandRows[d];
+
+		if(rows == 0) continue;
+
+		OpenCLEngine &engine = engines[d];
+		cl_command_queue command_queue = engine.queues[OpenCLEngine::COMPUTE_QUEUE];
+
+		int haloTop = firstRow > 0 ? HALO_ROWS : 0;
+		int haloBottom = firstRow + rows < height ? HALO_ROWS : 0;
+		int bandHeight = rows + haloTop + haloBottom;
+		int bandSize = bandHeight * width;
+		size_t size = bandSize * sizeof(int);
+
+		d_pixels[d] = clCreateBuffer(engine.context, CL_MEM_READ_ONLY, size, NULL, &ret);
+		checkError(ret, "Creating buffer d_pixels");
+		d_tempImage[d] = clCreateBuffer(engine.context, CL_MEM_WRITE_ONLY, size, NULL, &ret);
+		checkError(ret, "Creating buffer d_tempImage");
+
+		ret = clEnqueueWriteBuffer(command_queue, d_pixels[d], CL_FALSE, 0, size,
+				pixels + (firstRow - haloTop) * width, 0, NULL, &writeEvents[d]);
+		checkError(ret, "Copying pixels to device at d_pixels");
+
+		ret = clSetKernelArg(engine.edgeKernel, 0, sizeof(cl_mem), (void *)&d_pixels[d]);
+		ret |= clSetKernelArg(engine.edgeKernel, 1, sizeof(cl_mem), (void *)&d_tempImage[d]);
+		ret |= clSetKernelArg(engine.edgeKernel, 2, sizeof(int), &width);
+		ret |= clSetKernelArg(engine.edgeKernel, 3, sizeof(int), &bandHeight);
+		ret |= clSetKernelArg(engine.edgeKernel, 4, sizeof(int), &bandSize);
+		checkError(ret, "Setting kernel arguments");
+
+		size_t local_work_size = engine.localSize;
+		size_t global_work_size = ((bandSize + local_work_size - 1) / local_work_size) * local_work_size;
+
+		ret = clEnqueueNDRangeKernel(command_queue, engine.edgeKernel, 1,
+				0, &global_work_size, &local_work_size, 0, NULL, &kernelEvents[d]);
+		checkError(ret, "Enqueueing kernel");
+
+		ret = clEnqueueReadBuffer(command_queue, d_tempImage[d], CL_FALSE, haloTop * width * sizeof(int),
+				rows * width * sizeof(int), tempImage + firstRow * width, 0, NULL, &readEvents[d]);
+		checkError(ret, "Getting results");
+
+		//Start this device before queueing work on the next one
+		clFlush(command_queue);
+
+		firstRow += rows;
+
+	}
+
+	for(int d = 0; d < count; d++){
+
+		if(d_pixels[d] == NULL) continue;
+
+		ret = clFinish(engines[d].queues[OpenCLEngine::COMPUTE_QUEUE]);
+		checkError(ret, "Waiting for commands to finish");
+
+		engines[d].record("h2d", writeEvents[d]);
+		engines[d].record("kernel_edge", kernelEvents[d]);
+		engines[d].record("d2h", readEvents[d]);
+
+		clReleaseMemObject(d_pixels[d]);
+		clReleaseMemObject(d_tempImage[d]);
+
+	}
+
+	maxPixelValue = 255;
+
+	free(pixels);
+	pixels = tempImage;
+
+}
+
+//Scaling over the same bands, no halo is needed
+void Image::scaleImageBands(OpenCLEngine *engines, int count, int *bandRows){
+
+	double start = wallTime();
+
+	findMin();
+
+	findMax();
+
+	engines[0].recordHost("host_minmax", start);
+
+	vector<cl_mem> d_pixels(count, (cl_mem)NULL);
+	vector<cl_event> writeEvents(count), kernelEvents(count), readEvents(count);
+
+	cl_int ret;
+
+	int firstRow = 0;
+
+	for(int d = 0; d < count; d++){
+
+		int rows = bandRows[d];
+
+		if(rows == 0) continue;
+
+		OpenCLEngine &engine = engines[d];
+		cl_command_queue command_queue = engine.queues[OpenCLEngine::COMPUTE_QUEUE];
+
+		int bandSize = rows * width;
+		size_t size = bandSize * sizeof(int);
+
+		d_pixels[d] = clCreateBuffer(engine.context, CL_MEM_READ_WRITE, size, NULL, &ret);
+		checkError(ret, "Creating buffer d_pixels");
+
+		ret = clEnqueueWriteBuffer(command_queue, d_pixels[d], CL_FALSE, 0, size,
+				pixels + firstRow * width, 0, NULL, &writeEvents[d]);
+		checkError(ret, "Copying pixels to device at d_pixels");
+
+		ret = clSetKernelArg(engine.scaleKernel, 0, sizeof(cl_mem), (void *)&d_pixels[d]);
+		ret |= clSetKernelArg(engine.scaleKernel, 1, sizeof(int), &minpix);
+		ret |= clSetKernelArg(engine.scaleKernel, 2, sizeof(int), &maxpix);
+		ret |= clSetKernelArg(engine.scaleKernel, 3, sizeof(int), &bandSize);
+		checkError(ret, "Setting kernel arguments");
+
+		size_t local_work_size = engine.localSize;
+		size_t global_work_size = ((bandSize + local_work_size - 1) / local_work_size) * local_work_size;
+
+		ret = clEnqueueNDRangeKernel(command_queue, engine.scaleKernel, 1,
+				0, &global_work_size, &local_work_size, 0, NULL, &kernelEvents[d]);
+		checkError(ret, "Enqueueing kernel");
+
+		ret = clEnqueueReadBuffer(command_queue, d_pixels[d], CL_FALSE, 0, size,
+				pixels + firstRow * width, 0, NULL, &readEvents[d]);
+		checkError(ret, "Getting results");
+
+		clFlush(command_queue);
+
+		firstRow += rows;
+
+	}
+
+	for(int d = 0; d < count; d++){
+
+		if(d_pixels[d] == NULL) continue;
+
+		ret = clFinish(engines[d].queues[OpenCLEngine::COMPUTE_QUEUE]);
+		checkError(ret, "Waiting for commands to finish");
+
+		engines[d].record("h2d", writeEvents[d]);
+		engines[d].record("kernel_scale", kernelEvents[d]);
+		engines[d].record("d2h", readEvents[d]);
+
+		clReleaseMemObject(d_pixels[d]);
+
+	}
+
+	maxPixelValue = 255;
+
+}
+
+//Device buffers and events of one frame in flight in stream mode
+struct FrameSlot{
+
+	Image * image;
+	char * outName;
+	int frame;
+	cl_mem d_pixels;
+	cl_mem d_tempImage;
+	cl_mem d_minmax;
+	int minmaxInit[2];
+	size_t capacity;
+	void * mapped;
+	cl_event writeEvent;
+	cl_event edgeEvent;
+	cl_event resetEvent;
+	cl_event minMaxEvent;
+	cl_event scaleEvent;
+	cl_event readEvent;
+	bool busy;
+
+};
+
+//Command line flags
+struct RunOptions{
+
+	int depth;
+	bool zeroCopy;
+	string deviceSpec;
+	bool multiDevice;
+	bool verify;
+	string profileName;
+	bool aggregate;
+	string stencilName;
+	string magnitudeName;
+	Normalization normalization;
+	bool canny;
+	int cannyLow;
+	int cannyHigh;
+
+};
+
+bool isBinary(ifstream &inFile);
+
+Image * loadImage(char *inName);
+
+void referenceEdgeDetection(const int *input, int *output, int width, int height);
+
+void referenceScale(int *pixels, unsigned int imageSize);
+
+void verifyKernels(OpenCLEngine &engine);
+
+void verifyImage(const int *input, Image *image);
+
+void enqueueFrame(OpenCLEngine &engine, FrameSlot &slot);
+
+void finishFrame(OpenCLEngine &engine, FrameSlot &slot);
+
+void runStream(OpenCLEngine &engine, int frames, char **names, int depth);
+
+void run(int frames, char **names, RunOptions &options);
+
+int main(int argc, char **argv){
+
+	string usage = "Usage: EdgeDetection [-list] [-device gpu|cpu|accelerator|all|index|name] [-multidevice]"
+			" [-depth buffers] [-zerocopy] [-verify] [-profile times.csv|times.json] [-aggregate] [-stencil kernel.cl]"
+			" [-canny low high] [-magnitude exact|l1|maxmin]"
+			" [-normalize minmax|percentile|equalize] [-percentile low high]"
+			" imageName.pgm output.pgm [imageName2.pgm output2.pgm ...]";
+
+	RunOptions options;
+
+	options.depth = PIPELINE_DEPTH;
+	options.zeroCopy = false;
+	options.multiDevice = false;
+	options.verify = false;
+	options.aggregate = false;
+	options.magnitudeName = "exact";
+	options.normalization.mode = NORMALIZE_MINMAX;
+	options.normalization.lowPercent = 1.0;
+	options.normalization.highPercent = 99.0;
+	options.canny = false;
+	options.cannyLow = 0;
+	options.cannyHigh = 0;
+
+	int arg = 1;
+
+	//Flags come before the image names
+	while(arg < argc && argv[arg][0] == '-'){
+
+		if(strcmp(argv[arg], "-depth") == 0 && arg + 1 < argc){
+
+			options.depth = atoi(argv[arg + 1]);
+
+			arg += 2;
+
+		}else if(strcmp(argv[arg], "-device") == 0 && arg + 1 < argc){
+
+			options.deviceSpec = argv[arg + 1];
+
+			arg += 2;
+
+		}else if(strcmp(argv[arg], "-zerocopy") == 0){
+
+			options.zeroCopy = true;
+
+			arg++;
+
+		}else if(strcmp(argv[arg], "-multidevice") == 0){
+
+			options.multiDevice = true;
+
+			arg++;
+
+		}else if(strcmp(argv[arg], "-verify") == 0){
+
+			options.verify = true;
+
+			arg++;
+
+		}else if(strcmp(argv[arg], "-profile") == 0 && arg + 1 < argc){
+
+			options.profileName = argv[arg + 1];
+
+			arg += 2;
+
+		}else if(strcmp(argv[arg], "-canny") == 0 && arg + 2 < argc){
+
+			options.canny = true;
+			options.cannyLow = atoi(argv[arg + 1]);
+			options.cannyHigh = atoi(argv[arg + 2]);
+
+			arg += 3;
+
+		}else if(strcmp(argv[arg], "-magnitude") == 0 && arg + 1 < argc){
+
+			options.magnitudeName = argv[arg + 1];
+
+			arg += 2;
+
+		}else if(strcmp(argv[arg], "-normalize") == 0 && arg + 1 < argc){
+
+			if(!parseNormalization(argv[arg + 1], options.normalization.mode)){
+
+				cerr << usage;
+
+				return 1;
+
+			}
+
+			arg += 2;
+
+		}else if(strcmp(argv[arg], "-percentile") == 0 && arg + 2 < argc){
+
+			options.normalization.lowPercent = atof(argv[arg + 1]);
+			options.normalization.highPercent = atof(argv[arg + 2]);
+
+			arg += 3;
+
+		}else if(strcmp(argv[arg], "-stencil") == 0 && arg + 1 < argc){
+
+			options.stencilName = argv[arg + 1];
+
+			arg += 2;
+
+		}else if(strcmp(argv[arg], "-aggregate") == 0){
+
+			options.aggregate = true;
+
+			arg++;
+
+		}else if(strcmp(argv[arg], "-list") == 0){
+
+			printDevices();
+
+			return 0;
+
+		}else{
+
+			cerr << usage;
+
+			return 1;
+
+		}
+
+	}
+
+	int names = argc - arg;
+
+	//-verify compares against the Sobel reference, other operators would fail it
+	//Canny runs a single image on a single device with its own kernels
+	//Approximate magnitudes only replace the built in Sobel kernel
+	//Other normalizations run on a single image on a single device like Canny
+	//Several devices split the rows of a single image with HALO_ROWS rows of
+	//halo, enough for the built in 3x3 kernels only
+	bool exact = options.magnitudeName == "exact";
+	bool normalize = options.normalization.mode != NORMALIZE_MINMAX;
+	if(names < 2 || names % 2 != 0 || options.depth < 1
+			|| (!exact && options.magnitudeName != "l1" && options.magnitudeName != "maxmin")
+			|| (!exact && (options.verify || options.canny || !options.stencilName.empty()))
+			|| (normalize && (names != 2 || options.multiDevice || options.verify || options.canny
+					|| options.normalization.lowPercent < 0 || options.normalization.highPercent > 100
+					|| options.normalization.lowPercent >= options.normalization.highPercent))
+			|| (options.multiDevice && (names != 2 || !options.stencilName.empty()))
+			|| (options.verify && !options.stencilName.empty())
+			|| (options.canny && (names != 2 || options.multiDevice || options.verify
+					|| options.zeroCopy || !options.stencilName.empty()
+					|| options.cannyLow < 0 || options.cannyHigh < options.cannyLow
+					|| options.cannyHigh > MAX_GRADIENT))){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	run(names / 2, &argv[arg], options);
+
+	return 0;
+}
+
+
+bool isBinary(ifstream &inFile){
+
+	char readChar = ' ';
+
+	string errorMessage = "Error: incorrect picture format.";
+
+	//If there is no character or the character is not equal to 'P'
+	//then return an error
+	if(!(inFile >> readChar) || ( readChar != 'P' )){
+
+		cerr << errorMessage << endl;
+		cerr << "P" << endl;
+
+		exit(1002);
+
+	}
+
+	//If there is no character or the second character is not a 2 or 5
+	//then return an error
+	if(!(inFile >> readChar) || ( readChar != '2' && readChar != '5')){
+
+		cerr << errorMessage << endl;
+		cerr << readChar << endl;
+
+		exit(1002);
+
+	}
+
+	if(readChar == '5') return true;
+
+	return false;
+
+}
+
+//Reads header and pixels of one frame into a new image
+Image * loadImage(char *inName){
+
+	ifstream inFile;
+
+	inFile.open(inName, ios::binary | ios::in);
+
+	Image * image;
+
+	if(isBinary(inFile)){
+
+		image = new BinaryImage();
+
+	}else{
+
+		image = new AsciiImage();
+
+	}
+
+	image->readHeader(inFile);
+
+	image->readImage(inFile);
+
+	inFile.close();
+
+	return image;
+
+}
+
+//Enqueues upload, Sobel, min/max, scaling and download of a frame without
+//blocking, each stage waits on the event of the previous one
+void enqueueFrame(OpenCLEngine &engine, FrameSlot &slot){
+
+	cl_int ret;
+
+	unsigned int imageSize = slot.image->getImageSize();
+	int width = slot.image->getWidth();
+	int height = slot.image->getHeight();
+	size_t size = imageSize * sizeof(int);
+
+	//Grow the buffer set when a frame is larger than the previous ones
+	if(size > slot.capacity){
+
+		if(slot.d_tempImage != NULL){
+			clReleaseMemObject(slot.d_tempImage);
+		}
+
+		if(slot.d_pixels != NULL && !engine.zeroCopy){
+			clReleaseMemObject(slot.d_pixels);
+		}
+
+		if(!engine.zeroCopy){
+			slot.d_pixels = clCreateBuffer(engine.context, CL_MEM_READ_ONLY, size, NULL, &ret);
+			checkError(ret, "Creating buffer d_pixels");
+		}
+
+		slot.d_tempImage = clCreateBuffer(engine.context, CL_MEM_READ_WRITE, size, NULL, &ret);
+		checkError(ret, "Creating buffer d_tempImage");
+
+		slot.capacity = size;
+
+	}
+
+	//In zero-copy mode the frame pixels are used in place and also receive
+	//the scaled result, so the buffer lives as long as the frame
+	if(engine.zeroCopy){
+		slot.d_pixels = clCreateBuffer(engine.context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, size,
+				slot.image->getPixels(), &ret);
+		checkError(ret, "Creating buffer d_pixels");
+	}
+
+	if(slot.d_minmax == NULL){
+		slot.d_minmax = clCreateBuffer(engine.context, CL_MEM_READ_WRITE, 2 * sizeof(int), NULL, &ret);
+		checkError(ret, "Creating buffer d_minmax");
+	}
+
+	//Same starting values as findMin and findMax
+	slot.minmaxInit[0] = 255;
+	slot.minmaxInit[1] = 0;
+
+	cl_command_queue uploadQueue = engine.queues[OpenCLEngine::UPLOAD_QUEUE];
+	cl_command_queue computeQueue = engine.queues[OpenCLEngine::COMPUTE_QUEUE];
+	cl_command_queue downloadQueue = engine.queues[OpenCLEngine::DOWNLOAD_QUEUE];
+
+	size_t local_work_size = engine.localSize;
+	size_t global_work_size = ((imageSize + local_work_size - 1) / local_work_size) * local_work_size;
+
+	/* Upload */
+	slot.writeEvent = NULL;
+
+	if(!engine.zeroCopy){
+		ret = clEnqueueWriteBuffer(uploadQueue, slot.d_pixels, CL_FALSE, 0, size,
+				slot.image->getPixels(), 0, NULL, &slot.writeEvent);
+		checkError(ret, "Copying pixels to device at d_pixels");
+	}
+
+	/* Sobel, the compute queue is in order so only the upload has to be waited on */
+	ret = clSetKernelArg(engine.edgeKernel, 0, sizeof(cl_mem), (void *)&slot.d_pixels);
+	ret |= clSetKernelArg(engine.edgeKernel, 1, sizeof(cl_mem), (void *)&slot.d_tempImage);
+	ret |= clSetKernelArg(engine.edgeKernel, 2, sizeof(int), &width);
+	ret |= clSetKernelArg(engine.edgeKernel, 3, sizeof(int), &height);
+	ret |= clSetKernelArg(engine.edgeKernel, 4, sizeof(int), &imageSize);
+	checkError(ret, "Setting kernel arguments");
+	ret = clEnqueueNDRangeKernel(computeQueue, engine.edgeKernel, 1,
+			0, &global_work_size, &local_work_size, slot.writeEvent != NULL ? 1 : 0,
+			slot.writeEvent != NULL ? &slot.writeEvent : NULL, &slot.edgeEvent);
+	checkError(ret, "Enqueueing kernel edgeDetectionOpenCL");
+
+	/* Min and max of the gradient image */
+	ret = clEnqueueWriteBuffer(computeQueue, slot.d_minmax, CL_FALSE, 0, 2 * sizeof(int),
+			slot.minmaxInit, 0, NULL, &slot.resetEvent);
+	checkError(ret, "Resetting d_minmax");
+	ret = clSetKernelArg(engine.minMaxKernel, 0, sizeof(cl_mem), (void *)&slot.d_tempImage);
+	ret |= clSetKernelArg(engine.minMaxKernel, 1, sizeof(cl_mem), (void *)&slot.d_minmax);
+	ret |= clSetKernelArg(engine.minMaxKernel, 2, sizeof(int), &imageSize);
+	ret |= clSetKernelArg(engine.minMaxKernel, 3, local_work_size * sizeof(int), NULL);
+	ret |= clSetKernelArg(engine.minMaxKernel, 4, local_work_size * sizeof(int), NULL);
+	checkError(ret, "Setting kernel arguments");
+	ret = clEnqueueNDRangeKernel(computeQueue, engine.minMaxKernel, 1,
+			0, &global_work_size, &local_work_size, 0, NULL, &slot.minMaxEvent);
+	checkError(ret, "Enqueueing kernel minMaxOpenCL");
+
+	/* Scaling, in place unless the result goes back into the frame pixels */
+	cl_mem d_output = engine.zeroCopy ? slot.d_pixels : slot.d_tempImage;
+	ret = clSetKernelArg(engine.scaleMinMaxKernel, 0, sizeof(cl_mem), (void *)&slot.d_tempImage);
+	ret |= clSetKernelArg(engine.scaleMinMaxKernel, 1, sizeof(cl_mem), (void *)&d_output);
+	ret |= clSetKernelArg(engine.scaleMinMaxKernel, 2, sizeof(cl_mem), (void *)&slot.d_minmax);
+	ret |= clSetKernelArg(engine.scaleMinMaxKernel, 3, sizeof(int), &imageSize);
+	checkError(ret, "Setting kernel arguments");
+	ret = clEnqueueNDRangeKernel(computeQueue, engine.scaleMinMaxKernel, 1,
+			0, &global_work_size, &local_work_size, 0, NULL, &slot.scaleEvent);
+	checkError(ret, "Enqueueing kernel scaleImageMinMaxOpenCL");
+
+	/* Download straight into the host pixels of the frame */
+	if(engine.zeroCopy){
+		slot.mapped = clEnqueueMapBuffer(downloadQueue, slot.d_pixels, CL_FALSE, CL_MAP_READ,
+				0, size, 1, &slot.scaleEvent, &slot.readEvent, &ret);
+		checkError(ret, "Mapping results");
+	}else{
+		ret = clEnqueueReadBuffer(downloadQueue, slot.d_tempImage, CL_FALSE, 0, size,
+				slot.image->getPixels(), 1, &slot.scaleEvent, &slot.readEvent);
+		checkError(ret, "Getting results");
+	}
+
+	//Submit now so the device starts while the host loads the next frame
+	for(int q = 0; q < OpenCLEngine::QUEUE_COUNT; q++){
+		clFlush(engine.queues[q]);
+	}
+
+	slot.busy = true;
+
+}
+
+//Waits for the download of a frame and writes it to its output file
+void finishFrame(OpenCLEngine &engine, FrameSlot &slot){
+
+	cl_int ret = clWaitForEvents(1, &slot.readEvent);
+	checkError(ret, "Waiting for frame");
+
+	//The download waited on every other command of the frame
+	if(slot.writeEvent != NULL) engine.record("h2d", slot.writeEvent, slot.frame);
+	engine.record("kernel_edge", slot.edgeEvent, slot.frame);
+	engine.record("h2d_minmax", slot.resetEvent, slot.frame);
+	engine.record("kernel_minmax", slot.minMaxEvent, slot.frame);
+	engine.record("kernel_scale", slot.scaleEvent, slot.frame);
+	engine.record("d2h", slot.readEvent, slot.frame);
+
+	//The frame pixels must outlive the buffer that wraps them
+	if(engine.zeroCopy){
+
+		cl_event unmapEvent;
+
+		ret = clEnqueueUnmapMemObject(engine.queues[OpenCLEngine::DOWNLOAD_QUEUE], slot.d_pixels,
+				slot.mapped, 0, NULL, &unmapEvent);
+		checkError(ret, "Unmapping results");
+		ret = clWaitForEvents(1, &unmapEvent);
+		checkError(ret, "Unmapping results");
+
+		clReleaseEvent(unmapEvent);
+		clReleaseMemObject(slot.d_pixels);
+
+		slot.d_pixels = NULL;
+
+	}
+
+	slot.image->setMaxPixelValue(255);
+
+	double start = wallTime();
+
+	ofstream outFile;
+
+	outFile.open(slot.outName, ios::binary
+			            | ios::out
+						| ios::trunc);
+
+	slot.image->writeImage(outFile);
+
+	outFile.close();
+
+	engine.recordHost("write", start, slot.frame);
+
+	delete slot.image;
+
+	slot.image = NULL;
+	slot.busy = false;
+
+}
+
+//Processes a list of frames keeping up to depth of them in flight, so the
+//transfer of one frame overlaps the kernels of the previous one
+void runStream(OpenCLEngine &engine, int frames, char **names, int depth){
+
+	FrameSlot * slots = new FrameSlot[depth];
+
+	for(int s = 0; s < depth; s++){
+
+		slots[s].image = NULL;
+		slots[s].d_pixels = NULL;
+		slots[s].d_tempImage = NULL;
+		slots[s].d_minmax = NULL;
+		slots[s].capacity = 0;
+		slots[s].mapped = NULL;
+		slots[s].busy = false;
+
+	}
+
+	for(int f = 0; f < frames; f++){
+
+		FrameSlot &slot = slots[f % depth];
+
+		//Reuse the buffer set once its previous frame has been downloaded
+		if(slot.busy) finishFrame(engine, slot);
+
+		double start = wallTime();
+
+		slot.image = loadImage(names[2 * f]);
+		slot.outName = names[2 * f + 1];
+		slot.frame = f;
+
+		engine.recordHost("read", start, f);
+
+		enqueueFrame(engine, slot);
+
+	}
+
+	//Drain the frames still in flight in submission order
+	for(int f = frames; f < frames + depth; f++){
+
+		FrameSlot &slot = slots[f % depth];
+
+		if(slot.busy) finishFrame(engine, slot);
+
+	}
+
+	for(int s = 0; s < depth; s++){
+
+		if(slots[s].d_pixels != NULL) clReleaseMemObject(slots[s].d_pixels);
+
+		if(slots[s].d_tempImage != NULL) clReleaseMemObject(slots[s].d_tempImage);
+
+		if(slots[s].d_minmax != NULL) clReleaseMemObject(slots[s].d_minmax);
+
+	}
+
+	delete[] slots;
+
+}
+
+//Sobel exactly as the sequential version computes it, in double precision
+void referenceEdgeDetection(const int *input, int *output, int width, int height){
+
+	for(int y = 0; y < height; y++){
+
+		for(int x = 0; x < width; x++){
+
+			int i = x + (y * width);
+
+			if(x < (width - 1) && y < (height - 1) && (y > 0) && (x > 0)){
+
+				int xG = (input[(x+1) + ((y-1) * width)]
+						+ (2 * input[(x+1) + (y * width)])
+						+ input[(x+1) + ((y+1) * width)]
+						- input[(x-1) + ((y-1) * width)]
+						- (2 * input[(x-1) + (y * width)])
+						- input[(x-1) + ((y+1) * width)]);
+
+				int yG = (input[(x-1) + ((y+1) * width)]
+						+ (2 * input[(x) + ((y + 1) * width)])
+						+ input[(x+1) + ((y+1) * width)]
+						- input[(x-1) + ((y-1) * width)]
+						- (2 * input[(x) + ((y-1) * width)])
+						- input[(x+1) + ((y-1) * width)]);
+
+				output[i] = sqrt((xG * xG) + (yG * yG));
+
+			}else{
+
+				output[i] = 0;
+
+			}
+
+		}
+
+	}
+
+}
+
+//findMin, findMax and the double precision scaling of the sequential version
+void referenceScale(int *pixels, unsigned int imageSize){
+
+	int minpix = 255, maxpix = 0;
+
+	for(unsigned int i = 0; i < imageSize; i++){
+
+		if(pixels[i] < minpix) minpix = pixels[i];
+
+		if(pixels[i] > maxpix) maxpix = pixels[i];
+
+	}
+
+	for(unsigned int i = 0; i < imageSize; i++){
+
+		double calc = (double)(pixels[i] - minpix) / (maxpix - minpix);
+
+		pixels[i] = maxpix > minpix ? (int)round(calc * 255) : 0;
+
+	}
+
+}
+
+//Runs the integer magnitude and scaling on the device over their whole
+//input domain and checks every result against the double precision formula
+void verifyKernels(OpenCLEngine &engine){
+
+	cl_command_queue command_queue = engine.queues[OpenCLEngine::COMPUTE_QUEUE];
+	cl_int ret;
+
+	/* Magnitude, every squared gradient from 0 to MAX_SQUARED_GRADIENT */
+	int count = MAX_SQUARED_GRADIENT + 1;
+	int * roots = allocPixels(count);
+
+	cl_mem d_roots = clCreateBuffer(engine.context, CL_MEM_WRITE_ONLY, count * sizeof(int), NULL, &ret);
+	checkError(ret, "Creating buffer d_roots");
+
+	ret = clSetKernelArg(engine.magnitudeTableKernel, 0, sizeof(cl_mem), (void *)&d_roots);
+	ret |= clSetKernelArg(engine.magnitudeTableKernel, 1, sizeof(int), &count);
+	checkError(ret, "Setting kernel arguments");
+
+	size_t local_work_size = engine.localSize;
+	size_t global_work_size = ((count + local_work_size - 1) / local_work_size) * local_work_size;
+
+	ret = clEnqueueNDRangeKernel(command_queue, engine.magnitudeTableKernel, 1,
+			0, &global_work_size, &local_work_size, 0, NULL, NULL);
+	checkError(ret, "Enqueueing kernel magnitudeTableOpenCL");
+	ret = clEnqueueReadBuffer(command_queue, d_roots, CL_TRUE, 0, count * sizeof(int), roots, 0, NULL, NULL);
+	checkError(ret, "Getting results");
+
+	int magnitudeErrors = 0;
+
+	for(int n = 0; n < count; n++){
+
+		if(roots[n] != (int)sqrt((double)n)) magnitudeErrors++;
+
+	}
+
+	clReleaseMemObject(d_roots);
+	free(roots);
+
+	/* Scaling, every value 0..range for every range 1..MAX_GRADIENT */
+	int columns = MAX_GRADIENT + 1;
+	int maxRange = MAX_GRADIENT;
+	int * scaled = allocPixels(columns * maxRange);
+
+	cl_mem d_scaled = clCreateBuffer(engine.context, CL_MEM_WRITE_ONLY, columns * maxRange * sizeof(int), NULL, &ret);
+	checkError(ret, "Creating buffer d_scaled");
+
+	ret = clSetKernelArg(engine.scaleTableKernel, 0, sizeof(cl_mem), (void *)&d_scaled);
+	ret |= clSetKernelArg(engine.scaleTableKernel, 1, sizeof(int), &maxRange);
+	checkError(ret, "Setting kernel arguments");
+
+	size_t local_work_size2[2] = {engine.localSize, 1};
+	size_t global_work_size2[2] = {((columns + engine.localSize - 1) / engine.localSize) * engine.localSize,
+			(size_t)maxRange};
+
+	ret = clEnqueueNDRangeKernel(command_queue, engine.scaleTableKernel, 2,
+			0, global_work_size2, local_work_size2, 0, NULL, NULL);
+	checkError(ret, "Enqueueing kernel scaleTableOpenCL");
+	ret = clEnqueueReadBuffer(command_queue, d_scaled, CL_TRUE, 0, columns * maxRange * sizeof(int), scaled, 0, NULL, NULL);
+	checkError(ret, "Getting results");
+
+	int scaleErrors = 0;
+
+	for(int range = 1; range <= maxRange; range++){
+
+		for(int value = 0; value <= range; value++){
+
+			int expected = round(((double)value / range) * 255);
+
+			if(scaled[(range - 1) * columns + value] != expected) scaleErrors++;
+
+		}
+
+	}
+
+	clReleaseMemObject(d_scaled);
+	free(scaled);
+
+	printf("verify: magnitude %d values, %d mismatches\n", count, magnitudeErrors);
+	printf("verify: scaling %d ranges, %d mismatches\n", maxRange, scaleErrors);
+
+	if(magnitudeErrors > 0 || scaleErrors > 0){
+
+		cerr << "Error: device arithmetic differs from the sequential version." << endl;
+
+		exit(1003);
+
+	}
+
+}
+
+//Compares the device result with the sequential algorithm run on the input
+void verifyImage(const int *input, Image *image){
+
+	unsigned int imageSize = image->getImageSize();
+
+	int * expected = allocPixels(imageSize);
+
+	referenceEdgeDetection(input, expected, image->getWidth(), image->getHeight());
+
+	referenceScale(expected, imageSize);
+
+	const int * result = image->getPixels();
+
+	unsigned int differences = 0;
+
+	for(unsigned int i = 0; i < imageSize; i++){
+
+		if(result[i] != expected[i]) differences++;
+
+	}
+
+	free(expected);
+
+	printf("verify: image %d x %d, %u pixels differ from the sequential version\n",
+			image->getWidth(), image->getHeight(), differences);
+
+	if(differences > 0){
+
+		cerr << "Error: output is not bit identical to the sequential version." << endl;
+
+		exit(1003);
+
+	}
+
+}
+
+void run(int frames, char **names, RunOptions &options){
+
+	vector<cl_device_id> devices = selectDevices(options.deviceSpec);
+
+	//Without -multidevice only the first matching device is used
+	int count = options.multiDevice ? devices.size() : 1;
+
+	OpenCLEngine * engines = new OpenCLEngine[count];
+
+	Profiler profiler;
+
+	for(int d = 0; d < count; d++){
+
+		if(!options.profileName.empty()){
+
+			engines[d].profiler = &profiler;
+			engines[d].index = d;
+
+			profiler.devices.push_back(deviceName(devices[d]));
+
+		}
+
+		engines[d].stencilName = options.stencilName;
+		engines[d].magnitudeName = options.magnitudeName;
+
+		engines[d].init(devices[d]);
+
+		engines[d].zeroCopy = options.zeroCopy;
+
+	}
+
+	if(options.zeroCopy && !engines[0].hostUnifiedMemory()){
+
+		cerr << "Warning: device does not share memory with the host, "
+				<< "zero-copy buffers will still be copied by the driver." << endl;
+
+	}
+
+	if(options.verify) verifyKernels(engines[0]);
+
+	if(frames > 1){
+
+		runStream(engines[0], frames, names, options.depth);
+
+	}else{
+
+		double start = wallTime();
+
+		Image * image = loadImage(names[0]);
+
+		engines[0].recordHost("read", start);
+
+		//Keep the input to recompute it with the sequential algorithm
+		int * input = NULL;
+
+		if(options.verify){
+
+			input = allocPixels(image->getImageSize());
+
+			memcpy(input, image->getPixels(), image->getImageSize() * sizeof(int));
+
+		}
+
+		if(options.canny){
+
+			image->cannyEdgeDetection(engines[0], options.cannyLow, options.cannyHigh);
+
+		}else if(count > 1){
+
+			int * bandRows = new int[count];
+
+			image->balanceBands(engines, count, bandRows);
+
+			image->edgeDectionBands(engines, count, bandRows);
+
+			image->scaleImageBands(engines, count, bandRows);
+
+			delete[] bandRows;
+
+		}else{
+
+			image->edgeDection(engines[0]);
+
+			if(options.normalization.mode != NORMALIZE_MINMAX) image->normalizeImage(engines[0], options.normalization);
+			else image->scaleImage(engines[0]);
+
+		}
+
+		if(options.verify){
+
+			verifyImage(input, image);
+
+			free(input);
+
+		}
+
+		start = wallTime();
+
+		ofstream outFile;
+
+		outFile.open(names[1], ios::binary
+				            | ios::out
+							| ios::trunc);
+
+		image->writeImage(outFile);
+
+		outFile.close();
+
+		engines[0].recordHost("write", start);
+
+		delete image;
+
+	}
+
+	for(int d = 0; d < count; d++){
+
+		engines[d].release();
+
+	}
+
+	if(!options.profileName.empty()) profiler.write(options.profileName, options.aggregate);
+
+	delete[] engines;
 
 }
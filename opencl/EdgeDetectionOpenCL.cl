@@ -1,13 +1,70 @@
-#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+/* floor(sqrt(n)), which is what the sequential version gets by truncating a
+double sqrt. The single precision estimate is only a few ulp off for the
+gradient range, so it is corrected to the exact integer root and no
+cl_khr_fp64 is needed */
+int isqrtOpenCL(int n)
+{
+    int root = convert_int_rtz(sqrt(convert_float(n)));
+    while (root * root > n) root--;
+    while ((root + 1) * (root + 1) <= n) root++;
+    return root;
+}
+
+/* round(((value - minpix) / (maxpix - minpix)) * 255) with round half up in
+integers, identical to the double precision scaling for every pixel */
+int scalePixelOpenCL(int value, int minpix, int maxpix)
+{
+    int range = maxpix - minpix;
+    if (range <= 0) return 0;
+    return ((value - minpix) * 510 + range) / (2 * range);
+}
 
 __kernel void scaleImageOpenCL(__global int *pixels, const int minpix, const int maxpix, const int imageSize)
 {   
     int index = get_global_id(0);
-    int value;
     /* Avoid accesing data beyond the end of the arrays */
     if (index < imageSize) {
-        value = round(((double)(pixels[index] - minpix) / (maxpix - minpix)) * 255);
-        pixels[index] = value;
+        pixels[index] = scalePixelOpenCL(pixels[index], minpix, maxpix);
+    }
+}
+
+/* Same as scaleImageOpenCL with min and max read from the device, input and
+output may be the same buffer */
+__kernel void scaleImageMinMaxOpenCL(__global const int *input, __global int *output,
+                                     __global const int *minmax, const int imageSize)
+{   
+    int index = get_global_id(0);
+    int minpix = minmax[0];
+    int maxpix = minmax[1];
+    /* Avoid accesing data beyond the end of the arrays */
+    if (index < imageSize) {
+        output[index] = scalePixelOpenCL(input[index], minpix, maxpix);
+    }
+}
+
+/* Work-group tree reduction, one atomic per group. minmax must hold the
+starting values (255, 0) and the local size must be a power of two */
+__kernel void minMaxOpenCL(__global const int *pixels, __global int *minmax, const int imageSize,
+                           __local int *localMin, __local int *localMax)
+{
+    int index = get_global_id(0);
+    int lid = get_local_id(0);
+
+    localMin[lid] = (index < imageSize) ? pixels[index] : INT_MAX;
+    localMax[lid] = (index < imageSize) ? pixels[index] : INT_MIN;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int stride = get_local_size(0) / 2; stride > 0; stride >>= 1) {
+        if (lid < stride) {
+            localMin[lid] = min(localMin[lid], localMin[lid + stride]);
+            localMax[lid] = max(localMax[lid], localMax[lid + stride]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lid == 0) {
+        atomic_min(&minmax[0], localMin[0]);
+        atomic_max(&minmax[1], localMax[0]);
     }
 }
 
@@ -21,9 +78,7 @@ __kernel void edgeDetectionOpenCL(__global int *pixels, __global int *tempImage,
     if (index < imageSize) {
         x = index % width;
 
-        if (index != 0) {
-            y = convert_int4_sat((convert_float4(index) / convert_float4(width)));
-        }
+        y = index / width;
         
         if (x < (width - 1) && y < (height - 1)
                 && (y > 0) && (x > 0)) {
@@ -44,11 +99,249 @@ __kernel void edgeDetectionOpenCL(__global int *pixels, __global int *tempImage,
                                   - pixels[(x-1) + ((y-1) * width)]
                                            - (2 * pixels[(x) + ((y-1) * width)])
                                            - pixels[(x+1) + ((y-1) * width)]);
-            tempImage[index] = convert_int4_rte(sqrt(convert_float4(xG * xG) + convert_float4(yG * yG)));
+            tempImage[index] = isqrtOpenCL((xG * xG) + (yG * yG));
+
+        } else {
+            //Pads out of bound pixels with 0
+            tempImage[index] = 0;
+        }
+    }
+}
+
+/* Approximate magnitudes of openmp/magnitude.h, selected with -magnitude.
+Same arguments and border as edgeDetectionOpenCL, only the sqrt is gone */
+void sobelGradientsOpenCL(__global const int *pixels, int index, int width, int *xG, int *yG)
+{
+    *xG = pixels[index - width + 1] + 2 * pixels[index + 1] + pixels[index + width + 1]
+        - pixels[index - width - 1] - 2 * pixels[index - 1] - pixels[index + width - 1];
+    *yG = pixels[index + width - 1] + 2 * pixels[index + width] + pixels[index + width + 1]
+        - pixels[index - width - 1] - 2 * pixels[index - width] - pixels[index - width + 1];
+}
+
+/* |xG| + |yG| */
+__kernel void edgeDetectionL1OpenCL(__global int *pixels, __global int *tempImage, const int width, const int height, const int imageSize)
+{
+    int index = get_global_id(0);
+    int xG = 0, yG = 0;
+
+    /* Avoid accesing data beyond the end of the arrays */
+    if (index < imageSize) {
+        int x = index % width;
+        int y = index / width;
+
+        if (x < (width - 1) && y < (height - 1) && (y > 0) && (x > 0)) {
+            sobelGradientsOpenCL(pixels, index, width, &xG, &yG);
+            tempImage[index] = abs(xG) + abs(yG);
+        } else {
+            //Pads out of bound pixels with 0
+            tempImage[index] = 0;
+        }
+    }
+}
 
+/* max(|xG|, |yG|) + min(|xG|, |yG|) / 2 */
+__kernel void edgeDetectionMaxMinOpenCL(__global int *pixels, __global int *tempImage, const int width, const int height, const int imageSize)
+{
+    int index = get_global_id(0);
+    int xG = 0, yG = 0;
+
+    /* Avoid accesing data beyond the end of the arrays */
+    if (index < imageSize) {
+        int x = index % width;
+        int y = index / width;
+
+        if (x < (width - 1) && y < (height - 1) && (y > 0) && (x > 0)) {
+            sobelGradientsOpenCL(pixels, index, width, &xG, &yG);
+            int ax = abs(xG);
+            int ay = abs(yG);
+            tempImage[index] = max(ax, ay) + (min(ax, ay) >> 1);
         } else {
             //Pads out of bound pixels with 0
             tempImage[index] = 0;
         }
     }
 }
+
+/* Exhaustive checks for -verify: every squared gradient an 8 bit image can
+produce, and every (value, range) pair the scaling can see */
+__kernel void magnitudeTableOpenCL(__global int *roots, const int count)
+{
+    int n = get_global_id(0);
+    if (n < count) {
+        roots[n] = isqrtOpenCL(n);
+    }
+}
+
+__kernel void scaleTableOpenCL(__global int *scaled, const int maxRange)
+{
+    int value = get_global_id(0);
+    int range = get_global_id(1) + 1;
+    if (value <= maxRange && range <= maxRange) {
+        scaled[(range - 1) * (maxRange + 1) + value] = value <= range ? scalePixelOpenCL(value, 0, range) : 0;
+    }
+}
+
+/* Canny, the stages of openmp/canny.h one kernel each. Labels are 0 none,
+1 weak and 3 strong */
+int clampCoordinate(int value, int limit)
+{
+    return value < 0 ? 0 : (value >= limit ? limit - 1 : value);
+}
+
+/* [1 4 6 4 1] along the row, border pixels repeated */
+__kernel void gaussianRowsOpenCL(__global const int *pixels, __global int *temp,
+                                 const int width, const int height, const int imageSize)
+{
+    int index = get_global_id(0);
+    if (index < imageSize) {
+        int x = index % width;
+        int row = index - x;
+        temp[index] = pixels[row + clampCoordinate(x - 2, width)]
+                    + 4 * pixels[row + clampCoordinate(x - 1, width)]
+                    + 6 * pixels[index]
+                    + 4 * pixels[row + clampCoordinate(x + 1, width)]
+                    + pixels[row + clampCoordinate(x + 2, width)];
+    }
+}
+
+/* [1 4 6 4 1] along the column, then / 256 rounded */
+__kernel void gaussianColumnsOpenCL(__global const int *temp, __global int *blurred,
+                                    const int width, const int height, const int imageSize)
+{
+    int index = get_global_id(0);
+    if (index < imageSize) {
+        int x = index % width;
+        int y = index / width;
+        blurred[index] = (temp[x + clampCoordinate(y - 2, height) * width]
+                       + 4 * temp[x + clampCoordinate(y - 1, height) * width]
+                       + 6 * temp[index]
+                       + 4 * temp[x + clampCoordinate(y + 1, height) * width]
+                       + temp[x + clampCoordinate(y + 2, height) * width] + 128) >> 8;
+    }
+}
+
+/* Squared magnitude and direction sector: 0 horizontal, 1 diagonal
+down-right, 2 vertical, 3 diagonal up-right */
+__kernel void sobelDirectionOpenCL(__global const int *pixels, __global int *magnitude,
+                                   __global uchar *sector, const int width, const int height,
+                                   const int imageSize)
+{
+    int index = get_global_id(0);
+    if (index < imageSize) {
+        int x = index % width;
+        int y = index / width;
+        if (x < (width - 1) && y < (height - 1) && (y > 0) && (x > 0)) {
+            int xG = pixels[index - width + 1] + 2 * pixels[index + 1] + pixels[index + width + 1]
+                   - pixels[index - width - 1] - 2 * pixels[index - 1] - pixels[index + width - 1];
+            int yG = pixels[index + width - 1] + 2 * pixels[index + width] + pixels[index + width + 1]
+                   - pixels[index - width - 1] - 2 * pixels[index - width] - pixels[index - width + 1];
+            int ax = abs(xG);
+            int ay = abs(yG);
+            magnitude[index] = xG * xG + yG * yG;
+            if (ay * 10000 <= ax * 4142) sector[index] = 0;
+            else if (ax * 10000 <= ay * 4142) sector[index] = 2;
+            else sector[index] = ((xG > 0) == (yG > 0)) ? 1 : 3;
+        } else {
+            magnitude[index] = 0;
+            sector[index] = 0;
+        }
+    }
+}
+
+/* Non-maximum suppression across the edge and the double threshold */
+__kernel void nonMaxSuppressionOpenCL(__global const int *magnitude, __global const uchar *sector,
+                                      __global uchar *labels, const int width, const int height,
+                                      const int imageSize, const int lowSquared, const int highSquared)
+{
+    int index = get_global_id(0);
+    if (index < imageSize) {
+        int x = index % width;
+        int y = index / width;
+        uchar label = 0;
+        if (x < (width - 1) && y < (height - 1) && (y > 0) && (x > 0)) {
+            int s = sector[index];
+            int offset = s == 0 ? 1 : (s == 1 ? width + 1 : (s == 2 ? width : -width + 1));
+            int value = magnitude[index];
+            if (value >= lowSquared && value > magnitude[index - offset] && value >= magnitude[index + offset]) {
+                label = value >= highSquared ? 3 : 1;
+            }
+        }
+        labels[index] = label;
+    }
+}
+
+/* One sweep of hysteresis. Every strong pixel follows the weak pixels
+around it depth first and promotes them, so a sweep covers whole edge
+chains. A pixel that does not fit in the stack is still promoted and is
+followed from in the next sweep; the host repeats sweeps until changed
+stays 0. Labels only grow, so races just duplicate work */
+#define HYSTERESIS_STACK 32
+
+__kernel void hysteresisOpenCL(__global uchar *labels, __global int *changed,
+                               const int width, const int imageSize)
+{
+    int index = get_global_id(0);
+    if (index < imageSize && labels[index] == 3) {
+        int offsets[8] = {-width - 1, -width, -width + 1, -1, 1, width - 1, width, width + 1};
+        int stack[HYSTERESIS_STACK];
+        int top = 0;
+        stack[top++] = index;
+        while (top > 0) {
+            int pixel = stack[--top];
+            /* Labelled pixels are never on the border, so neighbours exist */
+            for (int n = 0; n < 8; n++) {
+                int neighbour = pixel + offsets[n];
+                if (labels[neighbour] == 1) {
+                    labels[neighbour] = 3;
+                    *changed = 1;
+                    if (top < HYSTERESIS_STACK) stack[top++] = neighbour;
+                }
+            }
+        }
+    }
+}
+
+__kernel void cannyOutputOpenCL(__global const uchar *labels, __global int *output, const int imageSize)
+{
+    int index = get_global_id(0);
+    if (index < imageSize) {
+        output[index] = labels[index] == 3 ? 255 : 0;
+    }
+}
+
+/* Histogram for -normalize, openmp/normalize.h builds the table from it.
+Each work item counts pixels strided by the global size, which the host
+sets to about HISTOGRAM_PIXELS_PER_ITEM pixels per item. The lower bins,
+where gradient magnitudes fall, gather in local memory so most increments
+stay in the work-group; values are clamped to the last bin */
+#define LOCAL_HISTOGRAM_BINS 2048
+__kernel void histogramOpenCL(__global const int *pixels, __global uint *histogram, const int bins, const int imageSize)
+{
+    __local uint localHistogram[LOCAL_HISTOGRAM_BINS];
+    int lid = get_local_id(0);
+
+    for (int b = lid; b < LOCAL_HISTOGRAM_BINS; b += get_local_size(0)) {
+        localHistogram[b] = 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int index = get_global_id(0); index < imageSize; index += get_global_size(0)) {
+        int bin = clamp(pixels[index], 0, bins - 1);
+        if (bin < LOCAL_HISTOGRAM_BINS) atomic_inc(&localHistogram[bin]);
+        else atomic_inc(&histogram[bin]);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int b = lid; b < LOCAL_HISTOGRAM_BINS; b += get_local_size(0)) {
+        if (localHistogram[b] != 0) atomic_add(&histogram[b], localHistogram[b]);
+    }
+}
+
+/* Output byte of every pixel from the normalization table */
+__kernel void applyTableOpenCL(__global int *pixels, __global const uchar *table, const int bins, const int imageSize)
+{
+    int index = get_global_id(0);
+    if (index < imageSize) {
+        pixels[index] = table[clamp(pixels[index], 0, bins - 1)];
+    }
+}
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <math.h>
+#include <limits.h>
 #include <fstream>
 #include <vector>
 #include <sstream>
@@ -342,6 +343,15 @@ void Image::readHeader(ifstream &inFile){
 
 	}
 
+	//Pixels are indexed with int, larger images would overflow it
+	if(width > INT_MAX / height){
+
+		cerr << "Error: image too large, width * height must fit in an int" << endl;
+
+		exit(1002);
+
+	}
+
 	//Check if there are any comments between height/width and maxPixelValue
 	while(getline(inFile, line)){
 
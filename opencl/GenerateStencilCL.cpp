@@ -0,0 +1,143 @@
+#include <iostream>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../openmp/operators.h"
+
+using namespace std;
+
+//Writes one gradient sum with the coefficients baked in, zero terms are
+//left out and unit terms need no multiply
+template <int SIZE>
+void writeSum(FILE *fp, const char *name, const int (&coefficients)[SIZE][SIZE]){
+
+	const int R = SIZE / 2;
+
+	bool first = true;
+
+	fprintf(fp, "            int %s =", name);
+
+	for(int dy = -R; dy <= R; dy++){
+
+		for(int dx = -R; dx <= R; dx++){
+
+			int c = coefficients[dy + R][dx + R];
+
+			if(c == 0) continue;
+
+			fprintf(fp, "\n                %s ", c < 0 ? "-" : (first ? " " : "+"));
+
+			if(abs(c) != 1) fprintf(fp, "%d * ", abs(c));
+
+			fprintf(fp, "pixels[index");
+
+			if(dy != 0) fprintf(fp, " %s %s", dy < 0 ? "-" : "+", abs(dy) == 1 ? "width" : "");
+			if(abs(dy) > 1) fprintf(fp, "%d * width", abs(dy));
+			if(dx != 0) fprintf(fp, " %s %d", dx < 0 ? "-" : "+", abs(dx));
+
+			fprintf(fp, "]");
+
+			first = false;
+
+		}
+
+	}
+
+	if(first) fprintf(fp, " 0");
+
+	fprintf(fp, ";\n");
+
+}
+
+//Emits stencilOpenCL for one operator. It has the arguments of
+//edgeDetectionOpenCL and is built together with EdgeDetectionOpenCL.cl,
+//which provides isqrtOpenCL
+template <class Operator>
+void writeKernel(FILE *fp){
+
+	const int R = Operator::RADIUS;
+
+	fprintf(fp, "/* Generated by GenerateStencilCL from openmp/operators.h, %s operator\n"
+			"with radius %d. Build it together with EdgeDetectionOpenCL.cl */\n", Operator::NAME, R);
+	fprintf(fp, "__kernel void stencilOpenCL(__global int *pixels, __global int *tempImage,"
+			" const int width, const int height, const int imageSize)\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "    int index = get_global_id(0);\n\n");
+	fprintf(fp, "    /* Avoid accesing data beyond the end of the arrays */\n");
+	fprintf(fp, "    if (index < imageSize) {\n");
+	fprintf(fp, "        int x = index %% width;\n");
+	fprintf(fp, "        int y = index / width;\n\n");
+	fprintf(fp, "        if (x >= %d && x < width - %d && y >= %d && y < height - %d) {\n", R, R, R, R);
+
+	writeSum(fp, "xG", Operator::X);
+
+	if(Operator::GRADIENT){
+
+		writeSum(fp, "yG", Operator::Y);
+
+		fprintf(fp, "            tempImage[index] = isqrtOpenCL((xG * xG) + (yG * yG));\n");
+
+	}else{
+
+		fprintf(fp, "            tempImage[index] = abs(xG);\n");
+
+	}
+
+	fprintf(fp, "        } else {\n");
+	fprintf(fp, "            //Pads out of bound pixels with 0\n");
+	fprintf(fp, "            tempImage[index] = 0;\n");
+	fprintf(fp, "        }\n");
+	fprintf(fp, "    }\n");
+	fprintf(fp, "}\n");
+
+}
+
+int main(int argc, char **argv){
+
+	string usage = "Usage: GenerateStencilCL sobel|scharr|prewitt|laplacian|sobel5 output.cl\n";
+
+	StencilOperator stencil;
+
+	if(argc != 3 || !parseStencil(argv[1], stencil)){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	FILE *fp = fopen(argv[2], "w");
+
+	if(!fp){
+
+		cerr << "Error: cannot write " << argv[2] << endl;
+
+		return 1;
+
+	}
+
+	switch(stencil){
+
+	case STENCIL_SCHARR:
+		writeKernel<ScharrOperator>(fp);
+		break;
+	case STENCIL_PREWITT:
+		writeKernel<PrewittOperator>(fp);
+		break;
+	case STENCIL_LAPLACIAN:
+		writeKernel<LaplacianOperator>(fp);
+		break;
+	case STENCIL_SOBEL5:
+		writeKernel<Sobel5Operator>(fp);
+		break;
+	default:
+		writeKernel<SobelOperator>(fp);
+		break;
+
+	}
+
+	fclose(fp);
+
+	return 0;
+}
@@ -1,13 +1,14 @@
 #!/bin/bash
 echo "EDGE DETECTION - OPENCL - START"
-echo "run;image;time" > results_opencl.csv
-for (( i=1; i<=5; i++ ));
+rm -f results_opencl.csv
+for (( j=1; j<=3; j=j+1 ));
 do
-	for (( j=1; j<=3; j=j+1 ));
-	do
-		output=$(eval "time ./EdgeDetectionOpenCL image_"${j}".pgm image_"${j}"_out_opencl.pgm" 2>&1)
-		realTime=${output:8:5}
-		echo ""$i";"$j";"$output >> results_opencl.csv
-	done
+	../benchmark/Benchmark -backend opencl -image image_"${j}".pgm -runs 5 -out results_opencl.csv -- ./EdgeDetectionOpenCL image_"${j}".pgm image_"${j}"_out_opencl.pgm
+done
+g++ GenerateStencilCL.cpp -o GenerateStencilCL -O3 -fopenmp
+for operator in scharr prewitt laplacian sobel5;
+do
+	./GenerateStencilCL ${operator} stencil_${operator}.cl
+	../benchmark/Benchmark -backend opencl_${operator} -image image_1.pgm -runs 5 -out results_opencl.csv -- ./EdgeDetectionOpenCL -stencil stencil_${operator}.cl image_1.pgm image_1_out_${operator}.pgm
 done
 echo "EDGE DETECTION - OPENCL - END"
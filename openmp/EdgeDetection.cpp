@@ -1,13 +1,88 @@
 #include <iostream>
 #include <math.h>
+#include <limits.h>
 #include <fstream>
 #include <sstream>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include "stageTimer.h"
+#include "edgeKernels.h"
+#include "stencil.h"
+#include "canny.h"
+#include "blur.h"
+#include "gradient.h"
+#include "magnitude.h"
+#include "normalize.h"
+#include "tiled.h"
+#include "pyramid.h"
+#include "incremental.h"
 #include <omp.h>
 
 using namespace std;
 
+//Filled by the scoped timers of each stage when -stages is given
+StageTimes stageTimes;
+
+//Colour input is read in bands of about this many bytes
+const unsigned int RGB_BAND_BYTES = 1 << 20;
+
+//Sobel implementations selectable with -sobel
+enum SobelMethod{
+
+	SOBEL_DIRECT,
+	SOBEL_SEPARABLE,
+	SOBEL_SIMD
+
+};
+
+//Filter settings taken from the optional flags
+struct EngineOptions{
+
+	SobelMethod method;
+	StencilOperator stencil;
+
+	//Sobel magnitude, lut leaves squares for scaleSquaredImage
+	MagnitudeMode magnitude;
+
+	//Canny replaces Sobel and scaling when enabled, thresholds are magnitudes
+	bool canny;
+	int cannyLow;
+	int cannyHigh;
+
+	//Gaussian pre-smoothing before the operator, 0 turns it off
+	double blurSigma;
+
+	//Output stretch, scaleImage for minmax and normalizeImage otherwise
+	Normalization normalization;
+
+	//Write the magnitudes unscaled, 16 bit when they exceed 255
+	bool raw;
+
+	//Sobel orientation outputs, written when a file name is given
+	string orientationName;
+	string hogName;
+	int orientationBins;
+	int cellSize;
+
+	//Consecutive P5 or P6 frames in, one output frame each
+	bool stream;
+
+	//Rectangles processed instead of the whole image, each written as its
+	//own image or, with fullFrame, into a frame that is 0 elsewhere
+	vector<Region> regions;
+	bool fullFrame;
+
+	//Levels written, the image itself and pyramidLevels - 1 decimations
+	int pyramidLevels;
+	Decimation decimation;
+
+	//Tile size of -incremental, 0 computes every frame whole
+	int incrementalTile;
+
+};
+
 //Creating image class (base class)
 class Image{
 
@@ -17,27 +92,50 @@ public:
 		height(0),
 		width(0),
 		maxPixelValue(0),
+		color(false),
 		minpix(0),
 		maxpix(0),
-		imageSize(0){}
-	virtual ~Image(){}
+		imageSize(0),
+		pixels(NULL),
+		spare(NULL),
+		capacity(0),
+		bytes(NULL),
+		byteCapacity(0){}
+	virtual ~Image(){
+
+		free(pixels);
+		free(spare);
+		free(bytes);
 
-	virtual void readImage(ifstream &inFile) = 0;
-	virtual void writeImage(ofstream &outFile) = 0;
+	}
+
+	virtual void readImage(istream &inFile) = 0;
+	virtual void writeImage(ostream &outFile) = 0;
 
-	void readHeader(ifstream &inFile);
+	void readHeader(istream &inFile);
 	void scaleImage();
-	void edgeDetection(int numThreads);
+	void scaleSquaredImage();
+	void normalizeImage(const Normalization &normalization);
+	void rawImage();
+	void cropImage(const Region &region);
+	void blankImage(int w, int h);
+	void pasteImage(Image &image, int x, int y);
+	void decimateImage(Image &finer, Decimation mode, int numThreads);
+	void scaleFrom(Image &source, const Region &region, int low, int high);
+	void edgeDetection(int numThreads, EngineOptions &options);
 
 	//Accessor methods
 	int getHeight(){return height;}
 	int getWidth(){return width;}
 	int getMaxPixelValue(){return maxPixelValue;}
+	bool isColor(){return color;}
+	const int * getPixels(){return pixels;}
 
 	//Mutator methods
 	void setHeight(int h){height = h;}
 	void setWidth(int w){width = w;}
 	void setMaxPixelValue(int mpv){maxPixelValue = mpv;}
+	void setColor(bool c){color = c;}
 
 	//Member variables
 protected:
@@ -45,14 +143,26 @@ protected:
 	int height;
 	int width;
 	int maxPixelValue;
+	//P3 and P6 input, converted to grey while it is read
+	bool color;
 	int minpix;
 	int maxpix;
 	unsigned int imageSize;
 	int * pixels;
 
+	//Filters write into spare and swap it with pixels. Both buffers, and the
+	//file bytes, are kept between the frames of -stream and only grow
+	int * spare;
+	unsigned int capacity;
+	unsigned char * bytes;
+	size_t byteCapacity;
+
 	inline void findMin();
 	inline void findMax();
 
+	void allocatePixels();
+	unsigned char * byteBuffer(size_t count);
+
 };
 
 //Binary image class (derived class)
@@ -64,8 +174,27 @@ public:
 	BinaryImage(){}
 	~BinaryImage(){}
 
-	void readImage(ifstream &inFile);
-	void writeImage(ofstream &outFile);
+	void readImage(istream &inFile);
+	void readRegionRows(istream &inFile, const vector<Region> &regions, int halo);
+	void writeImage(ostream &outFile);
+
+private:
+
+	void readColorImage(istream &inFile, unsigned int bytesPerSample);
+
+};
+
+//A window of a larger image, taken from the tiles of a container or from
+//the pixels of a frame in memory. Written as a P5 image like BinaryImage
+class WindowImage: public BinaryImage{
+
+public:
+
+	WindowImage(){}
+	~WindowImage(){}
+
+	void readTiles(int fd, const TiledHeader &header, const Region &window, int numThreads);
+	void copyWindow(const int *frame, int frameWidth, int frameMaxPixelValue, const Region &window);
 
 };
 
@@ -76,8 +205,8 @@ public:
 	AsciiImage(){}
 	~AsciiImage(){}
 
-	void readImage(ifstream &infile);
-	void writeImage(ofstream &outFile);
+	void readImage(istream &infile);
+	void writeImage(ostream &outFile);
 
 };
 
@@ -96,8 +225,56 @@ bool isComment(string comment){
 	return true;
 }
 
+//Pixel buffers for imageSize pixels, frames no larger than the previous
+//ones reuse them
+void Image::allocatePixels(){
+
+	if(imageSize <= capacity) return;
+
+	free(pixels);
+	free(spare);
+
+	pixels = (int *)malloc(imageSize * sizeof(int));
+	spare = (int *)malloc(imageSize * sizeof(int));
+
+	capacity = imageSize;
+
+}
+
+//Scratch for the bytes of the file, kept like the pixel buffers
+unsigned char * Image::byteBuffer(size_t count){
+
+	if(count > byteCapacity){
+
+		free(bytes);
+
+		bytes = (unsigned char *)malloc(count);
+
+		byteCapacity = count;
+
+	}
+
+	return bytes;
+
+}
+
+//Stops with an error when region is not inside a width x height image
+void checkRegion(const Region &region, int width, int height){
+
+	if(!regionInside(region, width, height)){
+
+		cerr << "Error: the region lies outside the image." << endl;
+
+		exit(1002);
+
+	}
+
+}
+
 //Reads binary pixel values in image
-void BinaryImage::readImage(ifstream &inFile){
+void BinaryImage::readImage(istream &inFile){
+
+	ScopedStageTimer timer(stageTimes, "read");
 
 	//Check if the file stream in open
 	if(!inFile){
@@ -108,12 +285,22 @@ void BinaryImage::readImage(ifstream &inFile){
 
 	}
 
+	//Samples above 255 take two bytes, most significant first
+	unsigned int bytesPerSample = maxPixelValue > 255 ? 2 : 1;
+
+	if(color){
+
+		readColorImage(inFile, bytesPerSample);
+
+		return;
+
+	}
+
 	//Making a temp array, and putting it on the heap
-	char * byteArray = (char *)malloc((imageSize + 1) * sizeof(char));
-	//char * byteArray = new char[imageSize + 1];
+	char * byteArray = (char *)byteBuffer((imageSize * bytesPerSample + 1) * sizeof(char));
 
 	//Read the bytes of the image, and puts data in byteArray
-	inFile.read(byteArray, imageSize);
+	inFile.read(byteArray, imageSize * bytesPerSample);
 
 	//If reading in the data failed, return an error
 	if(inFile.fail()){
@@ -125,25 +312,133 @@ void BinaryImage::readImage(ifstream &inFile){
 	}
 
 	//Set the last element in array to EOF character
-	byteArray[imageSize] = '\0';
+	byteArray[imageSize * bytesPerSample] = '\0';
 
 	//Put the data read from file into pixels
-	pixels = (int *)malloc(imageSize * sizeof(int));
-	for(unsigned int i = 0; i < imageSize; i++){
+	allocatePixels();
+
+	if(bytesPerSample == 2) unpackPixels16((unsigned char *)byteArray, pixels, imageSize);
+	else unpackPixels((unsigned char *)byteArray, pixels, imageSize);
+
+}
+
+//Reads RGB triplets a band of rows at a time, each band is converted to
+//grey straight into pixels, so the colour image is never held in memory
+void BinaryImage::readColorImage(istream &inFile, unsigned int bytesPerSample){
+
+	size_t rowBytes = (size_t)width * 3 * bytesPerSample;
+	unsigned int bandRows = RGB_BAND_BYTES / rowBytes > 0 ? RGB_BAND_BYTES / rowBytes : 1;
+
+	if(bandRows > (unsigned int)height) bandRows = height;
+
+	unsigned char * band = byteBuffer(bandRows * rowBytes);
+
+	allocatePixels();
+
+	for(unsigned int firstRow = 0; firstRow < (unsigned int)height; firstRow += bandRows){
+
+		unsigned int rows = firstRow + bandRows <= (unsigned int)height ? bandRows : height - firstRow;
+
+		inFile.read((char *)band, rows * rowBytes);
+
+		if(inFile.fail()){
+
+			cerr << "Error: cannot read pixels." << endl;
+
+			exit(1000);
+
+		}
+
+		if(bytesPerSample == 2) unpackRGB16(band, pixels + firstRow * width, rows * width);
+		else unpackRGB(band, pixels + firstRow * width, rows * width);
+
+	}
+
+}
+
+//Moves past count bytes, seeking when the stream allows it so files are
+//not read at all, reading and dropping them on pipes
+void skipBytes(istream &inFile, size_t count){
+
+	if(count == 0) return;
+
+	if(!inFile.seekg(count, ios::cur)){
+
+		inFile.clear();
+
+		inFile.ignore(count);
+
+	}
+
+}
+
+//Reads only the rows the regions and their halo cover. Other rows are
+//skipped and their pixels left unset, the whole payload is consumed so a
+//stream continues with the next frame
+void BinaryImage::readRegionRows(istream &inFile, const vector<Region> &regions, int halo){
+
+	ScopedStageTimer timer(stageTimes, "read");
+
+	vector<char> needed(height, 0);
+
+	for(unsigned int r = 0; r < regions.size(); r++){
+
+		checkRegion(regions[r], width, height);
+
+		Region window = expandRegion(regions[r], halo, width, height);
+
+		for(int y = window.y; y < window.y + window.height; y++) needed[y] = 1;
+
+	}
+
+	//Samples above 255 take two bytes, most significant first
+	unsigned int bytesPerSample = maxPixelValue > 255 ? 2 : 1;
+
+	size_t rowBytes = (size_t)width * bytesPerSample;
+
+	unsigned char * row = byteBuffer(rowBytes);
+
+	allocatePixels();
+
+	size_t skipped = 0;
+
+	for(int y = 0; y < height; y++){
+
+		if(!needed[y]){
+
+			skipped += rowBytes;
+
+			continue;
+
+		}
+
+		skipBytes(inFile, skipped);
+
+		skipped = 0;
+
+		inFile.read((char *)row, rowBytes);
+
+		if(inFile.fail()){
+
+			cerr << "Error: cannot read pixels." << endl;
+
+			exit(1000);
+
+		}
 
-		pixels[i] = static_cast<int>
-		(static_cast<unsigned char>(byteArray[i]));
+		if(bytesPerSample == 2) unpackPixels16(row, pixels + (size_t)y * width, width);
+		else unpackPixels(row, pixels + (size_t)y * width, width);
 
 	}
 
-	//Delete the byteArray
-	free(byteArray);
-	//delete[] byteArray;
+	skipBytes(inFile, skipped);
 
 }
 
 //Writes binary pixels to output file
-void BinaryImage::writeImage(ofstream &outFile){
+void BinaryImage::writeImage(ostream &outFile){
+
+	ScopedStageTimer timer(stageTimes, "write");
 
 	//Check if the file stream is open
 	if(!outFile){
@@ -160,18 +455,17 @@ void BinaryImage::writeImage(ofstream &outFile){
 			height        << " "  <<
 			maxPixelValue << endl;
 
-	//Take all pixel values from pixels and writes it to output file
-	char * byteArray = new char[imageSize + 1];
-
-	for(unsigned int i = 0; i < imageSize; i++){
+	unsigned int bytesPerSample = maxPixelValue > 255 ? 2 : 1;
 
-		byteArray[i] = static_cast<char>(pixels[i]);
+	//Take all pixel values from pixels and writes it to output file
+	char * byteArray = (char *)byteBuffer((imageSize * bytesPerSample + 1) * sizeof(char));
 
-	}
+	if(bytesPerSample == 2) packPixels16(pixels, (unsigned char *)byteArray, imageSize);
+	else packPixels(pixels, (unsigned char *)byteArray, imageSize);
 
-	byteArray[imageSize] = '\0';
+	byteArray[imageSize * bytesPerSample] = '\0';
 
-	outFile.write(byteArray, imageSize);
+	outFile.write(byteArray, imageSize * bytesPerSample);
 
 	if(outFile.fail()){
 
@@ -181,13 +475,46 @@ void BinaryImage::writeImage(ofstream &outFile){
 
 	}
 
-	free(byteArray);
-	free(pixels);
-	//delete[] byteArray;
+}
+
+//The window becomes the image, tiles are read in parallel
+void WindowImage::readTiles(int fd, const TiledHeader &header, const Region &window, int numThreads){
+
+	ScopedStageTimer timer(stageTimes, "read");
+
+	width = window.width;
+	height = window.height;
+	maxPixelValue = header.maxPixelValue;
+	imageSize = width * height;
+
+	allocatePixels();
+
+	readTiledRegion(fd, header, window, pixels, numThreads);
+
+}
+
+void WindowImage::copyWindow(const int *frame, int frameWidth, int frameMaxPixelValue, const Region &window){
+
+	ScopedStageTimer timer(stageTimes, "window");
+
+	width = window.width;
+	height = window.height;
+	maxPixelValue = frameMaxPixelValue;
+	imageSize = width * height;
+
+	allocatePixels();
+
+	for(int y = 0; y < height; y++){
+
+		memcpy(pixels + (size_t)y * width, frame + (size_t)(y + window.y) * frameWidth + window.x, width * sizeof(int));
+
+	}
 
 }
 
-void AsciiImage::readImage(ifstream &inFile){
+void AsciiImage::readImage(istream &inFile){
+
+	ScopedStageTimer timer(stageTimes, "read");
 
 	//Check if the file opened properly
 	if(!inFile){
@@ -200,12 +527,31 @@ void AsciiImage::readImage(ifstream &inFile){
 
 	int pixelValue;
 
+	allocatePixels();
+
 	//Read in the Ascii values from file
-	int i = 0;
-	while(inFile >> pixelValue){
+	unsigned int i = 0;
+
+	if(color){
+
+		int green;
+		int blue;
+
+		while(i < imageSize && inFile >> pixelValue >> green >> blue){
+
+			pixels[i] = lumaPixel(pixelValue, green, blue);
+			i++;
+
+		}
+
+	}else{
+
+		while(i < imageSize && inFile >> pixelValue){
 
-		pixels[i] = pixelValue;
-		i++;
+			pixels[i] = pixelValue;
+			i++;
+
+		}
 
 	}
 
@@ -213,7 +559,9 @@ void AsciiImage::readImage(ifstream &inFile){
 }
 
 
-void AsciiImage::writeImage(ofstream &outFile){
+void AsciiImage::writeImage(ostream &outFile){
+
+	ScopedStageTimer timer(stageTimes, "write");
 
 	//Check if file is open
 	if(!outFile){
@@ -240,10 +588,11 @@ void AsciiImage::writeImage(ofstream &outFile){
 
 	}
 
-	free(pixels);
 }
 
-void Image::readHeader(ifstream &inFile){
+void Image::readHeader(istream &inFile){
+
+	ScopedStageTimer timer(stageTimes, "header");
 
 	stringstream sStream;
 
@@ -338,6 +687,15 @@ void Image::readHeader(ifstream &inFile){
 
 	}
 
+	//Pixels are indexed with int, larger images would overflow it
+	if(width > INT_MAX / height){
+
+		cerr << "Error: image too large, width * height must fit in an int" << endl;
+
+		exit(1002);
+
+	}
+
 	//Check if there are any comments between height/width and maxPixelValue
 	while(getline(inFile, line)){
 
@@ -375,7 +733,7 @@ void Image::readHeader(ifstream &inFile){
 
 	}
 
-	if(maxPixelValue < 0 || maxPixelValue > 255){
+	if(maxPixelValue < 0 || maxPixelValue > MAX_PGM_VALUE){
 
 		cerr << errorMessage << endl;
 		cerr << "Invalid max pixel value." << endl;
@@ -391,284 +749,1196 @@ void Image::readHeader(ifstream &inFile){
 //Finds the maxium pixel value in the image
 void Image::findMax(){
 
-	int maxVal = 0;
-
-	for(unsigned int i = 0; i < imageSize; i++){
-
-		if(pixels[i] > maxVal){
-
-			maxVal = pixels[i];
-
-		}
-
-	}
-
-	maxpix = maxVal;
+	maxpix = findMaximum(pixels, imageSize, 0);
 
 }
 
 //Finds the minimal pixel value of the image
 void Image::findMin(){
 
-	int minVal = 255;
+	minpix = findMinimum(pixels, imageSize, 255);
 
-	for(unsigned int i = 0; i < imageSize; i++){
+}
 
-		if(pixels[i] < minVal){
+//Scales image so that the maximum pixel value is 255
+void Image::scaleImage(){
 
-			minVal = pixels[i];
+	{
+		ScopedStageTimer timer(stageTimes, "minmax");
 
-		}
+		findMin();
 
+		findMax();
 	}
 
-	minpix = minVal;
-
-}
+	ScopedStageTimer timer(stageTimes, "scale");
 
-//Scales image so that the maximum pixel value is 255
-void Image::scaleImage(){
+	scaleOpenMP(pixels, imageSize, minpix, maxpix, omp_get_max_threads());
 
-	double calc = 0.0;
+	maxPixelValue = 255;
 
-	int newPixelValue = 0;
+}
 
-	findMin();
+//Scales the squared magnitudes of -magnitude lut. Roots are monotonic, so
+//the roots of the extreme squares are the minpix and maxpix scaleImage
+//finds on exact magnitudes and the image is the same
+void Image::scaleSquaredImage(){
 
-	findMax();
+	int minSquared = 255 * 255;
+	int maxSquared = 0;
 
-	#pragma omp parallel for
-	for(int i = 0; i < imageSize; i++){
+	{
+		ScopedStageTimer timer(stageTimes, "minmax");
 
-		calc = (double)(pixels[i] - minpix) / (maxpix - minpix);
+		findMinMaxOpenMP(pixels, imageSize, minSquared, maxSquared, omp_get_max_threads());
 
-		newPixelValue = round(calc * 255);
+		minpix = (int)sqrt((double)minSquared);
+		maxpix = (int)sqrt((double)maxSquared);
+	}
 
-		pixels[i] = newPixelValue;
+	ScopedStageTimer timer(stageTimes, "scale");
 
-	}
+	scaleSquaredOpenMP(pixels, imageSize, maxSquared, minpix, maxpix, omp_get_max_threads());
 
 	maxPixelValue = 255;
 
 }
 
-//Sobel edge detection function - detects edges and draws an outline
-void Image::edgeDetection(int numThreads){
-	
-	/*printf("Number of threads=%d\n", numThreads);
-	printf("imageSize=%d\n", imageSize);
-	printf("width=%d\n", width);
-	printf("height=%d\n", height);*/
-	
-	int rowsPerThread = height / numThreads;
-	int rowsForLastThread = height - (rowsPerThread * (numThreads - 1));
-
-	/*printf("rowsPerThread=%d\n", rowsPerThread);
-	printf("rowsForLastThread=%d\n", rowsForLastThread);*/
-	
-	//int *tempImage = new int[imageSize];
-	int *tempImage = (int *)malloc(imageSize * sizeof(int));
-	
-	#pragma omp parallel num_threads(numThreads)
+//Percentile or equalized stretch, a histogram pass then a table pass
+void Image::normalizeImage(const Normalization &normalization){
+
+	vector<unsigned int> histogram(HISTOGRAM_BINS);
+	vector<unsigned char> table(HISTOGRAM_BINS);
+
 	{
-		unsigned int i;
-		
-		int threadId = omp_get_thread_num();
-		
-		int start, end, relativeHeight;
-		
-		start = width * (threadId * rowsPerThread);
-
-		if (threadId < numThreads - 1) {
-			end = width * ((threadId + 1) * rowsPerThread);
-			relativeHeight = rowsPerThread;
-		} else {
-			end = imageSize;
-			relativeHeight = rowsForLastThread;
-		}
-		
-		int x = 0;
-		int y = threadId * rowsPerThread;
+		ScopedStageTimer timer(stageTimes, "histogram");
 
-		int xG = 0, yG = 0;
-		
-		/*printf("threadId=%d\n", threadId);
-		printf("start=%d\n", start);
-		printf("end=%d\n", end);
-		printf("y=%d\n", y);*/
-		
-		for(i = start; i < end; i++){
+		histogramOpenMP(pixels, imageSize, &histogram[0], omp_get_max_threads());
 
-			x = i % width;
+		normalizationTable(&histogram[0], imageSize, normalization, &table[0]);
+	}
 
-			if(i != 0 && x == 0){
+	ScopedStageTimer timer(stageTimes, "scale");
 
-				y++;
+	applyTableOpenMP(pixels, imageSize, &table[0], omp_get_max_threads());
 
-			}
+	maxPixelValue = 255;
+
+}
 
-			if(x < (width - 1) && y < (height - 1)
-					&& (y > 0) && (x > 0)){
+//Keeps the magnitudes for -raw, saturated to the 16 bit PGM range. The
+//largest one becomes maxval, so weak edges still give an 8 bit image
+void Image::rawImage(){
 
-				//index = x + (y * width)
-				//Finds the horizontal gradient
-				xG = (pixels[(x+1) + ((y-1) * width)]
-							 + (2 * pixels[(x+1) + (y * width)])
-							 + pixels[(x+1) + ((y+1) * width)]
-									  - pixels[(x-1) + ((y-1) * width)]
-											   - (2 * pixels[(x-1) + (y * width)])
-											   - pixels[(x-1) + ((y+1) * width)]);
+	ScopedStageTimer timer(stageTimes, "scale");
 
+	#pragma omp parallel for simd
+	for(int i = 0; i < (int)imageSize; i++){
 
-				//Finds the vertical gradient
-				yG = (pixels[(x-1) + ((y+1) * width)]
-							 + (2 * pixels[(x) + ((y + 1) * width)])
-							 + pixels[(x+1) + ((y+1) * width)]
-									  - pixels[(x-1) + ((y-1) * width)]
-											   - (2 * pixels[(x) + ((y-1) * width)])
-											   - pixels[(x+1) + ((y-1) * width)]);
+		if(pixels[i] > MAX_PGM_VALUE) pixels[i] = MAX_PGM_VALUE;
 
-				//newPixel = sqrt(xG^2 + yG^2)
-				tempImage[i] = sqrt((xG * xG) + (yG * yG));
+	}
 
-			}else{
+	maxPixelValue = findMaximum(pixels, imageSize, 1);
 
-				//Pads out of bound pixels with 0
-				tempImage[i] = 0;
+}
 
-			}
+//Keeps the pixels of region, given relative to the current image
+void Image::cropImage(const Region &region){
 
-		}
-			
-	}
+	ScopedStageTimer timer(stageTimes, "crop");
 
-	for(unsigned int i = 0; i < imageSize; i++){
+	checkRegion(region, width, height);
+
+	#pragma omp parallel for
+	for(int y = 0; y < region.height; y++){
 
-		pixels[i] = tempImage[i];
+		memcpy(spare + (size_t)y * region.width, pixels + (size_t)(y + region.y) * width + region.x,
+				region.width * sizeof(int));
 
 	}
-	
-	free(tempImage);
 
+	int *cropped = spare;
+
+	spare = pixels;
+	pixels = cropped;
+
+	width = region.width;
+	height = region.height;
+	imageSize = width * height;
 
 }
 
+//A w x h image of zeros, the frame regions are pasted into
+void Image::blankImage(int w, int h){
 
+	width = w;
+	height = h;
+	imageSize = width * height;
+	maxPixelValue = 1;
 
+	allocatePixels();
 
-bool isBinary(ifstream &inFile);
+	memset(pixels, 0, (size_t)imageSize * sizeof(int));
 
-void run(char **argv);
+}
 
-int main(int argc, char **argv){
+//Copies image in with its top left corner at x, y. The max pixel value
+//grows to cover it
+void Image::pasteImage(Image &image, int x, int y){
 
-	if(argc != 4){
+	ScopedStageTimer timer(stageTimes, "paste");
 
-		cerr << "Usage: EdgeDetection imageName.pgm output.pgm threads";
+	for(int row = 0; row < image.height; row++){
 
-		return 1;
+		memcpy(pixels + (size_t)(row + y) * width + x, image.pixels + (size_t)row * image.width,
+				image.width * sizeof(int));
 
 	}
 
-	//long start, end;
+	if(image.maxPixelValue > maxPixelValue) maxPixelValue = image.maxPixelValue;
 
-	//double total;
+}
 
-	//start = clock();
+//The next pyramid level above finer, half its width and height
+void Image::decimateImage(Image &finer, Decimation mode, int numThreads){
 
-	run(argv);
+	ScopedStageTimer timer(stageTimes, "decimate");
 
-	//end = clock();
+	width = finer.width / 2;
+	height = finer.height / 2;
+	imageSize = width * height;
+	maxPixelValue = finer.maxPixelValue;
 
-	//total = (double)(end - start)/1000;
+	allocatePixels();
 
-	//cout << "Execution time: " << total << endl;
+	decimate(mode, finer.pixels, finer.width, finer.height, pixels, numThreads);
 
-	return 0;
 }
 
+//Scales the pixels of region in source, an image of the same size, into
+//the same place here with a given range. Integer form of scalePixel
+void Image::scaleFrom(Image &source, const Region &region, int low, int high){
 
-bool isBinary(ifstream &inFile){
+	ScopedStageTimer timer(stageTimes, "scale");
 
-	char readChar = ' ';
+	int range = high - low;
 
-	string errorMessage = "Error: incorrect picture format.";
+	#pragma omp parallel for
+	for(int y = region.y; y < region.y + region.height; y++){
 
-	//If there is no character or the character is not equal to 'P'
-	//then return an error
-	if(!(inFile >> readChar) || ( readChar != 'P' )){
+		const int *in = source.pixels + (size_t)y * width + region.x;
+		int *out = pixels + (size_t)y * width + region.x;
 
-		cerr << errorMessage << endl;
-		cerr << "P" << endl;
+		#pragma omp simd
+		for(int x = 0; x < region.width; x++){
 
-		exit(1002);
+			out[x] = range > 0 ? ((in[x] - low) * 510 + range) / (2 * range) : 0;
+
+		}
 
 	}
 
-	//If there is no character or the second character is not a 2 or 5
-	//then return an error
-	if(!(inFile >> readChar) || ( readChar != '2' && readChar != '5')){
+	maxPixelValue = 255;
 
-		cerr << errorMessage << endl;
-		cerr << readChar << endl;
+}
+
+//Sobel edge detection function - detects edges and draws an outline
+void Image::edgeDetection(int numThreads, EngineOptions &options){
+
+	//Canny and the lut squares keep squared gradients in an int, which
+	//only 8 bit samples keep from overflowing
+	if(maxPixelValue > 255 && (options.canny || options.magnitude == MAGNITUDE_LUT)){
+
+		cerr << "Error: -canny and -magnitude lut need 8 bit images." << endl;
 
 		exit(1002);
 
 	}
 
-	if(readChar == '5') return true;
+	//The normalize histogram has a bin per 16 bit value, 16 bit images give
+	//magnitudes far above its last bin
+	if(maxPixelValue > 255 && options.normalization.mode != NORMALIZE_MINMAX){
 
-	return false;
+		cerr << "Error: -normalize percentile and equalize need 8 bit images." << endl;
 
-}
+		exit(1002);
 
-void run(char **argv){
+	}
 
-	ifstream inFile;
+	int *tempImage = spare;
 
-	inFile.open(argv[1], ios::binary | ios::in);
+	if(options.canny){
 
-	ofstream outFile;
+		ScopedStageTimer timer(stageTimes, "canny");
 
-	outFile.open(argv[2], ios::binary
-			            | ios::out
-						| ios::trunc);
-						
-	int numThreads = atoi(argv[3]);
+		cannyOpenMP(pixels, tempImage, width, height, options.cannyLow, options.cannyHigh, numThreads);
 
-	if(isBinary(inFile)){
+		spare = pixels;
+		pixels = tempImage;
 
-		BinaryImage binaryImage;
+		maxPixelValue = 255;
 
-		binaryImage.readHeader(inFile);
+		return;
 
-		binaryImage.readImage(inFile);
+	}
 
-		binaryImage.edgeDetection(numThreads);
+	//Orientation and HOG come out of the same Sobel pass as the magnitude
+	if(!options.orientationName.empty() || !options.hogName.empty()){
 
-		binaryImage.scaleImage();
+		if(options.blurSigma > 0){
 
-		binaryImage.writeImage(outFile);
+			ScopedStageTimer timer(stageTimes, "blur");
+
+			boxBlurOpenMP(pixels, width, height, options.blurSigma, numThreads);
+
+		}
+
+		GradientFeatures features;
+
+		features.bins = options.orientationBins;
+		features.cellSize = options.cellSize;
+
+		{
+			ScopedStageTimer timer(stageTimes, "sobel");
+
+			sobelFeatures(pixels, tempImage, width, height, features, !options.orientationName.empty(),
+					!options.hogName.empty(), numThreads);
+		}
+
+		ScopedStageTimer timer(stageTimes, "write_features");
+
+		if(!options.orientationName.empty()) writeOrientation(options.orientationName, features, width, height);
+		if(!options.hogName.empty()) writeHistograms(options.hogName, features);
+
+		spare = pixels;
+		pixels = tempImage;
+
+		return;
+
+	}
+
+	//With Sobel the blur runs fused with the separable method, which gives
+	//the same image as the others
+	if(options.blurSigma > 0 && options.stencil == STENCIL_SOBEL && options.magnitude == MAGNITUDE_EXACT){
+
+		ScopedStageTimer timer(stageTimes, "blur_sobel");
+
+		boxBlurSobelOpenMP(pixels, tempImage, width, height, options.blurSigma, numThreads);
+
+		spare = pixels;
+		pixels = tempImage;
+
+		return;
+
+	}
+
+	if(options.blurSigma > 0){
+
+		ScopedStageTimer timer(stageTimes, "blur");
+
+		boxBlurOpenMP(pixels, width, height, options.blurSigma, numThreads);
+
+	}
+
+	ScopedStageTimer timer(stageTimes, "sobel");
+
+	//Every Sobel method gives the same image, they differ in loads and
+	//arithmetic. Other operators use their specialized stencil, other
+	//magnitudes the vectorized loop of magnitude.h
+	if(options.stencil != STENCIL_SOBEL) applyStencil(options.stencil, pixels, tempImage, width, height, numThreads);
+	else if(options.magnitude != MAGNITUDE_EXACT) sobelMagnitude(options.magnitude, pixels, tempImage, width, height, numThreads);
+	else if(options.method == SOBEL_SEPARABLE) sobelSeparable(pixels, tempImage, width, height, numThreads);
+	else if(options.method == SOBEL_SIMD) sobelSimd(pixels, tempImage, width, height, numThreads);
+	else sobelOpenMP(pixels, tempImage, width, height, numThreads);
+
+	//tempImage already holds the result, swap it in instead of copying
+	spare = pixels;
+	pixels = tempImage;
+
+}
+
+bool isBinary(istream &inFile, bool &color);
+
+void run(char **argv, EngineOptions &options);
+void runStream(istream &inFile, ostream &outFile, int numThreads, EngineOptions &options);
+void runTiled(const char *fileName, ostream &outFile, int numThreads, EngineOptions &options);
+void runRegions(Image &frame, ostream &outFile, int numThreads, EngineOptions &options);
+void runPyramid(Image &base, ostream &outFile, int numThreads, EngineOptions &options);
+
+int main(int argc, char **argv){
+
+	string usage = "Usage: EdgeDetection imageName.pgm output.pgm threads [-sobel direct|separable|simd]"
+			" [-magnitude exact|l1|maxmin|lut]"
+			" [-operator sobel|scharr|prewitt|laplacian|sobel5] [-canny low high] [-blur sigma]"
+			" [-orientation bins.pgm] [-hog cells.csv|cells.json] [-bins n] [-cell px]"
+			" [-normalize minmax|percentile|equalize] [-percentile low high] [-raw] [-stream]"
+			" [-region x y width height]... [-fullframe]"
+			" [-pyramid levels] [-decimate box|gaussian] [-incremental tile]"
+			" [-stages times.csv|times.json]"
+			" [-counters]";
+
+	string stagesName;
+
+	bool hardwareCounters = false;
+
+	EngineOptions options;
+
+	options.method = SOBEL_DIRECT;
+	options.stencil = STENCIL_SOBEL;
+	options.magnitude = MAGNITUDE_EXACT;
+	options.canny = false;
+	options.blurSigma = 0.0;
+	options.normalization.mode = NORMALIZE_MINMAX;
+	options.raw = false;
+	options.stream = false;
+	options.fullFrame = false;
+	options.pyramidLevels = 1;
+	options.incrementalTile = 0;
+	options.decimation = DECIMATE_BOX;
+	options.normalization.lowPercent = 1.0;
+	options.normalization.highPercent = 99.0;
+	options.orientationBins = 9;
+	options.cellSize = 8;
+	options.cannyLow = 0;
+	options.cannyHigh = 0;
+
+	//Optional flags follow the positional arguments
+	for(int arg = 4; arg < argc; arg++){
+
+		if(strcmp(argv[arg], "-stages") == 0 && arg + 1 < argc){
+
+			stagesName = argv[++arg];
+
+		}else if(strcmp(argv[arg], "-counters") == 0){
+
+			hardwareCounters = true;
+
+		}else if(strcmp(argv[arg], "-sobel") == 0 && arg + 1 < argc){
+
+			arg++;
+
+			if(strcmp(argv[arg], "direct") == 0) options.method = SOBEL_DIRECT;
+			else if(strcmp(argv[arg], "separable") == 0) options.method = SOBEL_SEPARABLE;
+			else if(strcmp(argv[arg], "simd") == 0) options.method = SOBEL_SIMD;
+			else{
+
+				cerr << usage;
+
+				return 1;
+
+			}
+
+		}else if(strcmp(argv[arg], "-canny") == 0 && arg + 2 < argc){
+
+			options.canny = true;
+			options.cannyLow = atoi(argv[++arg]);
+			options.cannyHigh = atoi(argv[++arg]);
+
+			if(options.cannyLow < 0 || options.cannyHigh < options.cannyLow
+					|| options.cannyHigh > CANNY_MAX_THRESHOLD){
+
+				cerr << usage;
+
+				return 1;
+
+			}
+
+		}else if(strcmp(argv[arg], "-magnitude") == 0 && arg + 1 < argc){
+
+			if(!parseMagnitude(argv[++arg], options.magnitude)){
+
+				cerr << usage;
+
+				return 1;
+
+			}
+
+		}else if(strcmp(argv[arg], "-normalize") == 0 && arg + 1 < argc){
+
+			if(!parseNormalization(argv[++arg], options.normalization.mode)){
+
+				cerr << usage;
+
+				return 1;
+
+			}
+
+		}else if(strcmp(argv[arg], "-percentile") == 0 && arg + 2 < argc){
+
+			options.normalization.lowPercent = atof(argv[++arg]);
+			options.normalization.highPercent = atof(argv[++arg]);
+
+		}else if(strcmp(argv[arg], "-raw") == 0){
+
+			options.raw = true;
+
+		}else if(strcmp(argv[arg], "-stream") == 0){
+
+			options.stream = true;
+
+		}else if(strcmp(argv[arg], "-region") == 0 && arg + 4 < argc){
+
+			Region region;
+
+			region.x = atoi(argv[++arg]);
+			region.y = atoi(argv[++arg]);
+			region.width = atoi(argv[++arg]);
+			region.height = atoi(argv[++arg]);
+
+			options.regions.push_back(region);
+
+		}else if(strcmp(argv[arg], "-fullframe") == 0){
+
+			options.fullFrame = true;
+
+		}else if(strcmp(argv[arg], "-incremental") == 0 && arg + 1 < argc){
+
+			options.incrementalTile = atoi(argv[++arg]);
+
+			if(options.incrementalTile < 1){
+
+				cerr << usage;
+
+				return 1;
+
+			}
+
+		}else if(strcmp(argv[arg], "-pyramid") == 0 && arg + 1 < argc){
+
+			options.pyramidLevels = atoi(argv[++arg]);
+
+		}else if(strcmp(argv[arg], "-decimate") == 0 && arg + 1 < argc){
+
+			if(!parseDecimation(argv[++arg], options.decimation)){
+
+				cerr << usage;
+
+				return 1;
+
+			}
+
+		}else if(strcmp(argv[arg], "-orientation") == 0 && arg + 1 < argc){
+
+			options.orientationName = argv[++arg];
+
+		}else if(strcmp(argv[arg], "-hog") == 0 && arg + 1 < argc){
+
+			options.hogName = argv[++arg];
+
+		}else if(strcmp(argv[arg], "-bins") == 0 && arg + 1 < argc){
+
+			options.orientationBins = atoi(argv[++arg]);
+
+		}else if(strcmp(argv[arg], "-cell") == 0 && arg + 1 < argc){
+
+			options.cellSize = atoi(argv[++arg]);
+
+		}else if(strcmp(argv[arg], "-blur") == 0 && arg + 1 < argc){
+
+			options.blurSigma = atof(argv[++arg]);
+
+			if(options.blurSigma < 0 || options.blurSigma > MAX_BLUR_SIGMA){
+
+				cerr << usage;
+
+				return 1;
+
+			}
+
+		}else if(strcmp(argv[arg], "-operator") == 0 && arg + 1 < argc){
+
+			if(!parseStencil(argv[++arg], options.stencil)){
+
+				cerr << usage;
+
+				return 1;
+
+			}
+
+		}else{
+
+			cerr << usage;
+
+			return 1;
+
+		}
+
+	}
+
+	//Orientation is a Sobel output, other operators and Canny have none
+	bool features = !options.orientationName.empty() || !options.hogName.empty();
+
+	//Magnitudes are a Sobel setting, the features keep the exact one
+	if(options.magnitude != MAGNITUDE_EXACT && (features || options.canny || options.stencil != STENCIL_SOBEL)){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	//Canny output is binary and lut squares have their own scaling
+	bool normalize = options.normalization.mode != NORMALIZE_MINMAX;
+
+	if(normalize && (options.canny || options.magnitude == MAGNITUDE_LUT
+			|| options.normalization.lowPercent < 0 || options.normalization.highPercent > 100
+			|| options.normalization.lowPercent >= options.normalization.highPercent)){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	//Raw output replaces the scaling, Canny gives edges and not magnitudes
+	if(options.raw && (normalize || options.canny || options.magnitude == MAGNITUDE_LUT)){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	//Feature files would be overwritten by every frame of a stream
+	if(features && (options.stream || options.canny || options.stencil != STENCIL_SOBEL || options.orientationBins < 2
+			|| options.orientationBins > MAX_ORIENTATION_BINS || options.cellSize < 1)){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	//Canny hysteresis and the feature files cover the whole image
+	if(!options.regions.empty() && (features || options.canny)){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	//Incremental frames keep magnitudes and a min-max range between frames,
+	//outputs needing the whole frame or a global histogram are left out
+	if(options.incrementalTile > 0 && (!options.stream || features || options.canny || options.raw || normalize
+			|| options.magnitude == MAGNITUDE_LUT || !options.regions.empty() || options.pyramidLevels > 1)){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	//Every level would overwrite the feature files
+	if(options.pyramidLevels < 1 || (options.pyramidLevels > 1 && (features || !options.regions.empty()))){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	if(argc < 4){
+
+		cerr << usage;
+
+		return 1;
+
+	}
+
+	if(!stagesName.empty()) stageTimes.enable(hardwareCounters);
+
+	run(argv, options);
+
+	if(!stagesName.empty()) stageTimes.write(stagesName);
+
+	return 0;
+}
+
+
+//P5 and P6 are binary, P3 and P6 set color
+bool isBinary(istream &inFile, bool &color){
+
+	char readChar = ' ';
+
+	string errorMessage = "Error: incorrect picture format.";
+
+	//If there is no character or the character is not equal to 'P'
+	//then return an error
+	if(!(inFile >> readChar) || ( readChar != 'P' )){
+
+		cerr << errorMessage << endl;
+		cerr << "P" << endl;
+
+		exit(1002);
+
+	}
+
+	//If there is no character or the second character is not a 2, 3, 5 or 6
+	//then return an error
+	if(!(inFile >> readChar) || ( readChar != '2' && readChar != '3' && readChar != '5' && readChar != '6')){
+
+		cerr << errorMessage << endl;
+		cerr << readChar << endl;
+
+		exit(1002);
+
+	}
+
+	color = readChar == '3' || readChar == '6';
+
+	if(readChar == '5' || readChar == '6') return true;
+
+	return false;
+
+}
+
+//Scaling of the edge detection output selected by the options
+void scaleOutput(Image &image, EngineOptions &options){
+
+	//Canny output is already 0 or 255
+	if(options.raw) image.rawImage();
+	else if(options.magnitude == MAGNITUDE_LUT) image.scaleSquaredImage();
+	else if(options.normalization.mode != NORMALIZE_MINMAX) image.normalizeImage(options.normalization);
+	else if(!options.canny) image.scaleImage();
+
+}
+
+//Border the operator and the blur need around a region, so the region
+//pixels come out as in the whole image
+int regionHalo(EngineOptions &options){
+
+	return stencilRadius(options.stencil) + blurRadius(options.blurSigma);
+
+}
+
+//Source of the windows runRegions processes
+class WindowSource{
+
+public:
+
+	virtual ~WindowSource(){}
+
+	virtual void load(WindowImage &image, const Region &window) = 0;
+
+};
+
+//Windows of a frame already in memory
+class FrameSource: public WindowSource{
+
+public:
+
+	FrameSource(Image &f):
+		frame(f){}
+
+	void load(WindowImage &image, const Region &window){
+
+		image.copyWindow(frame.getPixels(), frame.getWidth(), frame.getMaxPixelValue(), window);
+
+	}
+
+private:
+
+	Image &frame;
+
+};
+
+//Windows read from the tiles of a container
+class TileSource: public WindowSource{
+
+public:
+
+	TileSource(int f, const TiledHeader &h, int threads):
+		fd(f),
+		header(h),
+		numThreads(threads){}
+
+	void load(WindowImage &image, const Region &window){
+
+		image.readTiles(fd, header, window, numThreads);
+
+	}
+
+private:
+
+	int fd;
+	const TiledHeader &header;
+	int numThreads;
+
+};
+
+//Edge detection and scaling of every region of a width x height image on
+//its own, in a window grown by the halo. Each region is written as an
+//image, or pasted into a frame that is written at the end
+void processRegions(WindowSource &source, int width, int height, const vector<Region> &regions,
+		ostream &outFile, int numThreads, EngineOptions &options){
+
+	int halo = regionHalo(options);
+
+	//Buffers are shared by the regions in turn
+	WindowImage image;
+	WindowImage frame;
+
+	if(options.fullFrame) frame.blankImage(width, height);
+
+	for(unsigned int r = 0; r < regions.size(); r++){
+
+		const Region &region = regions[r];
+
+		checkRegion(region, width, height);
+
+		Region window = expandRegion(region, halo, width, height);
+
+		source.load(image, window);
+
+		image.edgeDetection(numThreads, options);
+
+		Region inWindow = {region.x - window.x, region.y - window.y, region.width, region.height};
+
+		image.cropImage(inWindow);
+
+		scaleOutput(image, options);
+
+		if(options.fullFrame) frame.pasteImage(image, region.x, region.y);
+		else image.writeImage(outFile);
+
+	}
+
+	if(options.fullFrame) frame.writeImage(outFile);
+
+}
+
+//The regions of the options, or the whole image without any
+vector<Region> frameRegions(EngineOptions &options, int width, int height){
+
+	if(!options.regions.empty()) return options.regions;
+
+	Region whole = {0, 0, width, height};
+
+	return vector<Region>(1, whole);
+
+}
+
+//Reads the next frame of a stream, false at its end. With regions only
+//their rows are read from grey frames
+bool readFrame(istream &inFile, BinaryImage &frame, EngineOptions &options){
+
+	inFile >> ws;
+
+	if(inFile.peek() == EOF) return false;
+
+	bool color = false;
+
+	if(!isBinary(inFile, color)){
+
+		cerr << "Error: -stream takes P5 and P6 frames." << endl;
+
+		exit(1002);
+
+	}
+
+	frame.setColor(color);
+
+	frame.readHeader(inFile);
+
+	if(!options.regions.empty() && !color) frame.readRegionRows(inFile, options.regions, regionHalo(options));
+	else frame.readImage(inFile);
+
+	return true;
+
+}
+
+//Stream frames that change only in places. The previous input, the raw
+//magnitudes and the scaled output are kept. Each frame computes only the
+//tiles a change can reach, in windows grown by the halo, and the scaling
+//range comes from the kept min and max of every tile. When the range is
+//unchanged only the recomputed tiles are scaled again. Every frame gives
+//the image the whole frame would
+class IncrementalDetector{
+
+public:
+
+	IncrementalDetector(int tile):
+		tileSize(tile){
+
+		grid.width = 0;
+		grid.height = 0;
+
+	}
+
+	void process(Image &frame, ostream &outFile, int numThreads, EngineOptions &options);
+
+private:
+
+	int tileSize;
+	TiledHeader grid;
+	int minpix;
+	int maxpix;
+	vector<int> previous;
+	vector<char> changed;
+	vector<char> affected;
+	vector<int> tileMin;
+	vector<int> tileMax;
+	vector<Region> regions;
+	WindowImage window;
+	WindowImage magnitudes;
+	WindowImage output;
+
+};
+
+void IncrementalDetector::process(Image &frame, ostream &outFile, int numThreads, EngineOptions &options){
+
+	int width = frame.getWidth();
+	int height = frame.getHeight();
+	const int *pixels = frame.getPixels();
+
+	Region whole = {0, 0, width, height};
+
+	//The first frame, and any frame of another size, is computed whole
+	bool reset = width != grid.width || height != grid.height;
+
+	if(reset){
+
+		grid = tileGrid(width, height, tileSize);
+
+		changed.assign(grid.index.size(), 1);
+		tileMin.assign(grid.index.size(), 0);
+		tileMax.assign(grid.index.size(), 0);
+
+		previous.resize((size_t)width * height);
+
+		magnitudes.blankImage(width, height);
+		output.blankImage(width, height);
+
+		minpix = -1;
+		maxpix = -1;
 
 	}else{
 
-		AsciiImage asciiImage;
+		ScopedStageTimer timer(stageTimes, "diff");
+
+		changedTiles(pixels, &previous[0], grid, &changed[0], numThreads);
+
+	}
+
+	int halo = regionHalo(options);
+
+	affectedTiles(grid, &changed[0], halo, affected);
+
+	affectedRegions(grid, affected, regions);
+
+	for(unsigned int r = 0; r < regions.size(); r++){
+
+		const Region &region = regions[r];
+
+		Region grown = expandRegion(region, halo, width, height);
+
+		window.copyWindow(pixels, width, frame.getMaxPixelValue(), grown);
+
+		window.edgeDetection(numThreads, options);
+
+		Region inWindow = {region.x - grown.x, region.y - grown.y, region.width, region.height};
+
+		window.cropImage(inWindow);
+
+		magnitudes.pasteImage(window, region.x, region.y);
+
+	}
+
+	int low = 255;
+	int high = 0;
+
+	{
+		ScopedStageTimer timer(stageTimes, "minmax");
+
+		tileMinMax(magnitudes.getPixels(), grid, affected, tileMin, tileMax, numThreads);
+
+		for(unsigned int t = 0; t < tileMin.size(); t++){
+
+			if(tileMin[t] < low) low = tileMin[t];
+			if(tileMax[t] > high) high = tileMax[t];
+
+		}
+	}
+
+	if(low != minpix || high != maxpix){
+
+		minpix = low;
+		maxpix = high;
+
+		output.scaleFrom(magnitudes, whole, minpix, maxpix);
+
+	}else{
+
+		for(unsigned int r = 0; r < regions.size(); r++) output.scaleFrom(magnitudes, regions[r], minpix, maxpix);
+
+	}
+
+	output.writeImage(outFile);
+
+	ScopedStageTimer timer(stageTimes, "keep");
+
+	//Only the changed tiles differ from the kept input
+	#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+	for(int t = 0; t < (int)changed.size(); t++){
+
+		if(!changed[t]) continue;
+
+		Region tile = tileRegion(grid, t);
+
+		for(int y = tile.y; y < tile.y + tile.height; y++){
+
+			memcpy(&previous[(size_t)y * width + tile.x], pixels + (size_t)y * width + tile.x, tile.width * sizeof(int));
+
+		}
+
+	}
+
+}
+
+//Frames are processed in turn while a reader thread loads the next one
+//into the other image. Each image keeps its buffers, so frames of the
+//same size allocate nothing after the first two
+void runStream(istream &inFile, ostream &outFile, int numThreads, EngineOptions &options){
+
+	BinaryImage frames[2];
+
+	IncrementalDetector detector(options.incrementalTile);
+
+	int current = 0;
+
+	bool more = readFrame(inFile, frames[current], options);
+
+	while(more){
+
+		BinaryImage &next = frames[1 - current];
 
-		asciiImage.readHeader(inFile);
+		thread reader([&inFile, &next, &more, &options](){more = readFrame(inFile, next, options);});
 
-		asciiImage.readImage(inFile);
+		if(options.incrementalTile > 0){
 
-		asciiImage.edgeDetection(numThreads);
+			detector.process(frames[current], outFile, numThreads, options);
 
-		asciiImage.scaleImage();
+		}else if(!options.regions.empty()){
+
+			runRegions(frames[current], outFile, numThreads, options);
+
+		}else if(options.pyramidLevels > 1){
+
+			runPyramid(frames[current], outFile, numThreads, options);
+
+		}else{
+
+			frames[current].edgeDetection(numThreads, options);
+
+			scaleOutput(frames[current], options);
+
+			frames[current].writeImage(outFile);
+
+		}
+
+		//Downstream filters get every frame as soon as it is done
+		outFile.flush();
+
+		reader.join();
+
+		current = 1 - current;
+
+	}
+
+}
+
+//Tiled input is read only around the regions, or whole without any
+void runTiled(const char *fileName, ostream &outFile, int numThreads, EngineOptions &options){
+
+	TiledHeader header;
+
+	int fd = open(fileName, O_RDONLY);
+
+	{
+		ScopedStageTimer timer(stageTimes, "header");
+
+		if(fd < 0 || !readTiledHeader(fd, header)){
+
+			cerr << "Error: cannot read the tile index of " << fileName << endl;
+
+			exit(1002);
+
+		}
+	}
+
+	TileSource source(fd, header, numThreads);
+
+	processRegions(source, header.width, header.height, frameRegions(options, header.width, header.height),
+			outFile, numThreads, options);
+
+	close(fd);
+
+}
+
+//Regions of a frame in memory
+void runRegions(Image &frame, ostream &outFile, int numThreads, EngineOptions &options){
+
+	FrameSource source(frame);
+
+	processRegions(source, frame.getWidth(), frame.getHeight(), options.regions, outFile, numThreads, options);
+
+}
+
+//Edge maps of every pyramid level, finest first, written one after the
+//other. All levels are decimated from the loaded pixels before the base
+//is overwritten by its edges. Levels stop once they get too small for
+//Sobel
+void runPyramid(Image &base, ostream &outFile, int numThreads, EngineOptions &options){
+
+	vector<WindowImage> levels(options.pyramidLevels - 1);
+
+	Image *finer = &base;
+
+	unsigned int count = 0;
+
+	while(count < levels.size() && finer->getWidth() / 2 >= MIN_PYRAMID_SIZE
+			&& finer->getHeight() / 2 >= MIN_PYRAMID_SIZE){
+
+		levels[count].decimateImage(*finer, options.decimation, numThreads);
+
+		finer = &levels[count++];
 
-		asciiImage.writeImage(outFile);
-		
 	}
 
-	inFile.close();
-	outFile.close();
+	base.edgeDetection(numThreads, options);
+
+	scaleOutput(base, options);
+
+	base.writeImage(outFile);
+
+	for(unsigned int level = 0; level < count; level++){
+
+		levels[level].edgeDetection(numThreads, options);
+
+		scaleOutput(levels[level], options);
+
+		levels[level].writeImage(outFile);
+
+	}
 
 }
 
+void run(char **argv, EngineOptions &options){
+
+	//A - reads from stdin or writes to stdout
+	ifstream inFile;
+	ofstream outFile;
+
+	if(strcmp(argv[1], "-") != 0) inFile.open(argv[1], ios::binary | ios::in);
+
+	if(strcmp(argv[2], "-") != 0){
+
+		outFile.open(argv[2], ios::binary
+				            | ios::out
+							| ios::trunc);
+
+	}
+
+	istream &in = strcmp(argv[1], "-") != 0 ? inFile : cin;
+	ostream &out = strcmp(argv[2], "-") != 0 ? outFile : cout;
 
+	int numThreads = atoi(argv[3]);
+
+	if(strcmp(argv[1], "-") != 0 && isTiled(argv[1])){
+
+		if(options.pyramidLevels > 1){
+
+			cerr << "Error: -pyramid needs PGM input." << endl;
+
+			exit(1002);
+
+		}
+
+		runTiled(argv[1], out, numThreads, options);
+
+		return;
+
+	}
+
+	if(options.stream){
+
+		runStream(in, out, numThreads, options);
+
+		return;
+
+	}
+
+	bool color = false;
+
+	if(isBinary(in, color)){
+
+		BinaryImage binaryImage;
+
+		binaryImage.setColor(color);
+
+		binaryImage.readHeader(in);
+
+		if(!options.regions.empty()){
+
+			if(color) binaryImage.readImage(in);
+			else binaryImage.readRegionRows(in, options.regions, regionHalo(options));
+
+			runRegions(binaryImage, out, numThreads, options);
+
+			return;
+
+		}
+
+		binaryImage.readImage(in);
+
+		if(options.pyramidLevels > 1){
+
+			runPyramid(binaryImage, out, numThreads, options);
+
+			return;
+
+		}
+
+		binaryImage.edgeDetection(numThreads, options);
+
+		scaleOutput(binaryImage, options);
+
+		binaryImage.writeImage(out);
+
+	}else{
+
+		AsciiImage asciiImage;
+
+		asciiImage.setColor(color);
+
+		asciiImage.readHeader(in);
+
+		asciiImage.readImage(in);
+
+		if(!options.regions.empty()){
+
+			runRegions(asciiImage, out, numThreads, options);
+
+			return;
+
+		}
+
+		if(options.pyramidLevels > 1){
+
+			runPyramid(asciiImage, out, numThreads, options);
+
+			return;
+
+		}
+
+		asciiImage.edgeDetection(numThreads, options);
+
+		scaleOutput(asciiImage, options);
+
+		asciiImage.writeImage(out);
+
+	}
+
+}
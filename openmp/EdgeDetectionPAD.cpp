@@ -1,15 +1,21 @@
 #include <iostream>
 #include <math.h>
+#include <limits.h>
 #include <fstream>
 #include <sstream>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+#include "stageTimer.h"
 #include <omp.h>
 
 #define PAD 8
 
 using namespace std;
 
+//Filled by the scoped timers of each stage when -stages is given
+StageTimes stageTimes;
+
 //Creating image class (base class)
 class Image{
 
@@ -101,6 +107,8 @@ bool isComment(string comment){
 //Reads binary pixel values in image
 void BinaryImage::readImage(ifstream &inFile){
 
+	ScopedStageTimer timer(stageTimes, "read");
+
 	//Check if the file stream in open
 	if(!inFile){
 
@@ -151,6 +159,8 @@ void BinaryImage::readImage(ifstream &inFile){
 //Writes binary pixels to output file
 void BinaryImage::writeImage(ofstream &outFile){
 
+	ScopedStageTimer timer(stageTimes, "write");
+
 	//Check if the file stream is open
 	if(!outFile){
 
@@ -197,6 +207,8 @@ void BinaryImage::writeImage(ofstream &outFile){
 
 void AsciiImage::readImage(ifstream &inFile){
 
+	ScopedStageTimer timer(stageTimes, "read");
+
 	//Check if the file opened properly
 	if(!inFile){
 
@@ -223,6 +235,8 @@ void AsciiImage::readImage(ifstream &inFile){
 
 void AsciiImage::writeImage(ofstream &outFile){
 
+	ScopedStageTimer timer(stageTimes, "write");
+
 	//Check if file is open
 	if(!outFile){
 
@@ -253,6 +267,8 @@ void AsciiImage::writeImage(ofstream &outFile){
 
 void Image::readHeader(ifstream &inFile){
 
+	ScopedStageTimer timer(stageTimes, "header");
+
 	stringstream sStream;
 
 	string line;
@@ -346,6 +362,15 @@ void Image::readHeader(ifstream &inFile){
 
 	}
 
+	//Pixels are indexed with int, larger images would overflow it
+	if(width > INT_MAX / height){
+
+		cerr << "Error: image too large, width * height must fit in an int" << endl;
+
+		exit(1002);
+
+	}
+
 	//Check if there are any comments between height/width and maxPixelValue
 	while(getline(inFile, line)){
 
@@ -437,20 +462,23 @@ void Image::findMin(){
 //Scales image so that the maximum pixel value is 255
 void Image::scaleImage(){
 
-	double calc = 0.0;
+	{
+		ScopedStageTimer timer(stageTimes, "minmax");
 
-	int newPixelValue = 0;
+		findMin();
 
-	findMin();
+		findMax();
+	}
 
-	findMax();
+	ScopedStageTimer timer(stageTimes, "scale");
 
 	#pragma omp parallel for
 	for(int i = 0; i < imageSize; i++){
 
-		calc = (double)(pixels[i][0] - minpix) / (maxpix - minpix);
+		//Declared in the loop so every thread has its own copy
+		double calc = (double)(pixels[i][0] - minpix) / (maxpix - minpix);
 
-		newPixelValue = round(calc * 255);
+		int newPixelValue = round(calc * 255);
 
 		pixels[i][0] = newPixelValue;
 
@@ -462,6 +490,8 @@ void Image::scaleImage(){
 
 //Sobel edge detection function - detects edges and draws an outline
 void Image::edgeDetection(int numThreads){
+
+	ScopedStageTimer timer(stageTimes, "sobel");
 	
 	/*printf("Number of threads=%d\n", numThreads);
 	printf("imageSize=%d\n", imageSize);
@@ -511,7 +541,8 @@ void Image::edgeDetection(int numThreads){
 
 			x = i % width;
 
-			if(i != 0 && x == 0){
+			//y already holds the first row of the band, only later rows advance it
+			if(i != (unsigned int)start && x == 0){
 
 				y++;
 
@@ -571,27 +602,46 @@ void run(char **argv);
 
 int main(int argc, char **argv){
 
-	if(argc != 4){
+	string usage = "Usage: EdgeDetection imageName.pgm output.pgm threads [-stages times.csv|times.json] [-counters]";
 
-		cerr << "Usage: EdgeDetection imageName.pgm output.pgm threads";
+	string stagesName;
 
-		return 1;
+	bool hardwareCounters = false;
+
+	//Optional flags follow the positional arguments
+	for(int arg = 4; arg < argc; arg++){
+
+		if(strcmp(argv[arg], "-stages") == 0 && arg + 1 < argc){
+
+			stagesName = argv[++arg];
+
+		}else if(strcmp(argv[arg], "-counters") == 0){
+
+			hardwareCounters = true;
+
+		}else{
+
+			cerr << usage;
+
+			return 1;
+
+		}
 
 	}
 
-	//long start, end;
+	if(argc < 4){
 
-	//double total;
+		cerr << usage;
 
-	//start = clock();
+		return 1;
 
-	run(argv);
+	}
 
-	//end = clock();
+	if(!stagesName.empty()) stageTimes.enable(hardwareCounters);
 
-	//total = (double)(end - start)/1000;
+	run(argv);
 
-	//cout << "Execution time: " << total << endl;
+	if(!stagesName.empty()) stageTimes.write(stagesName);
 
 	return 0;
 }
@@ -0,0 +1,236 @@
+#ifndef BLUR_H_
+#define BLUR_H_
+
+//Adding header files
+#include <math.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "edgeKernels.h"
+
+//Gaussian pre-smoothing approximated by three box blurs, each run as a
+//horizontal and a vertical running sum. A running sum costs one add and
+//one subtract per pixel whatever the box size, so the cost stays the same
+//for any sigma. Border pixels are repeated and every pass rounds to the
+//nearest integer, so results do not depend on the thread count.
+
+const int BLUR_PASSES = 3;
+
+//Largest sigma accepted, its boxes are about 100 wide. boxDivide stays
+//exact for 16 bit samples up to boxes 255 wide
+const double MAX_BLUR_SIGMA = 50.0;
+
+//ceil(2^32 / size), boxDivide(sum, it) is sum / size without a division,
+//exact while sum * size < 2^32
+inline long long boxReciprocal(int size){
+
+	return ((1LL << 32) + size - 1) / size;
+
+}
+
+inline int boxDivide(int sum, long long reciprocal){
+
+	return (int)((sum * reciprocal) >> 32);
+
+}
+
+//Box widths whose three passes have the variance of the Gaussian, the
+//first ones lower odd width and the rest the next odd width
+inline void boxSizes(double sigma, int *sizes){
+
+	double ideal = sqrt(12.0 * sigma * sigma / BLUR_PASSES + 1.0);
+
+	int lower = (int)floor(ideal);
+
+	if(lower % 2 == 0) lower--;
+
+	int upper = lower + 2;
+
+	double idealLower = (12.0 * sigma * sigma - BLUR_PASSES * lower * lower - 4.0 * BLUR_PASSES * lower
+			- 3.0 * BLUR_PASSES) / (-4.0 * lower - 4.0);
+
+	int countLower = (int)round(idealLower);
+
+	for(int i = 0; i < BLUR_PASSES; i++) sizes[i] = i < countLower ? lower : upper;
+
+}
+
+//Distance the blur reaches, the box radii of the passes added up. Pixels
+//further than this from an edge of a window blur as in the whole image
+inline int blurRadius(double sigma){
+
+	if(sigma <= 0) return 0;
+
+	int sizes[BLUR_PASSES];
+
+	boxSizes(sigma, sizes);
+
+	int radius = 0;
+
+	for(int i = 0; i < BLUR_PASSES; i++) radius += sizes[i] / 2;
+
+	return radius;
+
+}
+
+//Running sum along every row of rows firstRow to lastRow - 1
+inline void boxRows(const int *in, int *out, int width, int firstRow, int lastRow, int radius){
+
+	long long reciprocal = boxReciprocal(2 * radius + 1);
+
+	for(int y = firstRow; y < lastRow; y++){
+
+		const int *row = in + y * width;
+		int *blurred = out + y * width;
+
+		int sum = (radius + 1) * row[0];
+
+		for(int i = 1; i <= radius; i++) sum += row[i < width ? i : width - 1];
+
+		for(int x = 0; x < width; x++){
+
+			blurred[x] = boxDivide(sum + radius, reciprocal);
+
+			int add = x + radius + 1;
+			int remove = x - radius;
+
+			sum += row[add < width ? add : width - 1] - row[remove > 0 ? remove : 0];
+
+		}
+
+	}
+
+}
+
+//Running sums down columns firstColumn to lastColumn - 1, one sum per
+//column kept in sums so the inner loop runs along the row and vectorizes
+inline void boxColumns(const int *in, int *out, int width, int height, int firstColumn, int lastColumn,
+		int radius, int *sums){
+
+	long long reciprocal = boxReciprocal(2 * radius + 1);
+	int columns = lastColumn - firstColumn;
+
+	const int *first = in + firstColumn;
+
+	#pragma omp simd
+	for(int x = 0; x < columns; x++) sums[x] = (radius + 1) * first[x];
+
+	for(int i = 1; i <= radius; i++){
+
+		const int *row = first + (i < height ? i : height - 1) * width;
+
+		#pragma omp simd
+		for(int x = 0; x < columns; x++) sums[x] += row[x];
+
+	}
+
+	for(int y = 0; y < height; y++){
+
+		int add = y + radius + 1;
+		int remove = y - radius;
+
+		const int *addRow = first + (add < height ? add : height - 1) * width;
+		const int *removeRow = first + (remove > 0 ? remove : 0) * width;
+		int *blurred = out + y * width + firstColumn;
+
+		#pragma omp simd
+		for(int x = 0; x < columns; x++){
+
+			blurred[x] = boxDivide(sums[x] + radius, reciprocal);
+
+			sums[x] += addRow[x] - removeRow[x];
+
+		}
+
+	}
+
+}
+
+//The three box passes, called from inside a parallel region. Rows are
+//split between the threads for the horizontal sums and columns for the
+//vertical ones. pixels and temp are both overwritten, the result ends in
+//pixels
+inline void boxBlurPasses(int *pixels, int *temp, int width, int height, const int *sizes){
+
+	int threads = omp_get_num_threads();
+	int threadId = omp_get_thread_num();
+
+	int rowsPerThread = height / threads;
+	int firstRow = threadId * rowsPerThread;
+	int lastRow = threadId < threads - 1 ? firstRow + rowsPerThread : height;
+
+	int columnsPerThread = width / threads;
+	int firstColumn = threadId * columnsPerThread;
+	int lastColumn = threadId < threads - 1 ? firstColumn + columnsPerThread : width;
+
+	int *sums = (int *)malloc((lastColumn - firstColumn + 1) * sizeof(int));
+
+	for(int pass = 0; pass < BLUR_PASSES; pass++){
+
+		int radius = sizes[pass] / 2;
+
+		if(radius == 0) continue;
+
+		boxRows(pixels, temp, width, firstRow, lastRow, radius);
+
+		#pragma omp barrier
+
+		boxColumns(temp, pixels, width, height, firstColumn, lastColumn, radius, sums);
+
+		#pragma omp barrier
+
+	}
+
+	free(sums);
+
+}
+
+//Blurs pixels in place
+inline void boxBlurOpenMP(int *pixels, int width, int height, double sigma, int numThreads){
+
+	int sizes[BLUR_PASSES];
+
+	boxSizes(sigma, sizes);
+
+	int *temp = (int *)malloc(width * height * sizeof(int));
+
+	#pragma omp parallel num_threads(numThreads)
+	boxBlurPasses(pixels, temp, width, height, sizes);
+
+	free(temp);
+
+}
+
+//Blur fused with the separable Sobel in one parallel region: the threads
+//go from the last vertical pass straight into Sobel on their own band of
+//rows, with no fork and join in between. pixels is blurred in place
+inline void boxBlurSobelOpenMP(int *pixels, int *out, int width, int height, double sigma, int numThreads){
+
+	int sizes[BLUR_PASSES];
+
+	boxSizes(sigma, sizes);
+
+	int *temp = (int *)malloc(width * height * sizeof(int));
+
+	#pragma omp parallel num_threads(numThreads)
+	{
+		boxBlurPasses(pixels, temp, width, height, sizes);
+
+		int threads = omp_get_num_threads();
+		int threadId = omp_get_thread_num();
+
+		int rowsPerThread = height / threads;
+		int firstRow = threadId * rowsPerThread;
+		int lastRow = threadId < threads - 1 ? firstRow + rowsPerThread : height;
+
+		int *buffer = (int *)malloc(6 * width * sizeof(int));
+
+		sobelSeparableRows(pixels, out, width, height, firstRow, lastRow, buffer);
+
+		free(buffer);
+	}
+
+	free(temp);
+
+}
+
+#endif /* BLUR_H_ */
@@ -0,0 +1,274 @@
+#ifndef CANNY_H_
+#define CANNY_H_
+
+//Adding header files
+#include <stdlib.h>
+#include <vector>
+#include <omp.h>
+
+//Canny edge detection on plain int arrays:
+//  1. 5x5 binomial blur, [1 4 6 4 1] / 16 in each direction
+//  2. Sobel giving the squared magnitude and the direction in 4 sectors
+//  3. non-maximum suppression along the direction and the double threshold
+//  4. hysteresis, weak pixels 8-connected to a strong one become edges
+//Every stage is a parallel pass over rows. Magnitudes stay squared, no
+//sqrt is needed to compare them, so the thresholds are squared instead.
+//The result is 255 on edges and 0 elsewhere. opencl/EdgeDetectionOpenCL.cl
+//has the same stages as kernels and gives the same image.
+
+const unsigned char CANNY_NONE = 0;
+const unsigned char CANNY_WEAK = 1;
+const unsigned char CANNY_STRONG = 3;
+
+//Largest gradient magnitude of an 8 bit image, sqrt(2) * 4 * 255. Higher
+//thresholds are rejected, their squares would overflow an int
+const int CANNY_MAX_THRESHOLD = 1442;
+
+//Horizontal then vertical blur with the border pixels repeated, rounded to
+//the nearest integer. temp holds width * height ints
+inline void gaussianBlur(const int *pixels, int *temp, int *out, int width, int height, int numThreads){
+
+	#pragma omp parallel num_threads(numThreads)
+	{
+		#pragma omp for schedule(static)
+		for(int y = 0; y < height; y++){
+
+			const int *row = pixels + y * width;
+			int *blurred = temp + y * width;
+
+			for(int x = 0; x < width; x++){
+
+				int left2 = row[x < 2 ? 0 : x - 2];
+				int left1 = row[x < 1 ? 0 : x - 1];
+				int right1 = row[x + 1 >= width ? width - 1 : x + 1];
+				int right2 = row[x + 2 >= width ? width - 1 : x + 2];
+
+				blurred[x] = left2 + 4 * left1 + 6 * row[x] + 4 * right1 + right2;
+
+			}
+
+		}
+
+		#pragma omp for schedule(static)
+		for(int y = 0; y < height; y++){
+
+			const int *above2 = temp + (y < 2 ? 0 : y - 2) * width;
+			const int *above1 = temp + (y < 1 ? 0 : y - 1) * width;
+			const int *middle = temp + y * width;
+			const int *below1 = temp + (y + 1 >= height ? height - 1 : y + 1) * width;
+			const int *below2 = temp + (y + 2 >= height ? height - 1 : y + 2) * width;
+			int *row = out + y * width;
+
+			#pragma omp simd
+			for(int x = 0; x < width; x++){
+
+				row[x] = (above2[x] + 4 * above1[x] + 6 * middle[x] + 4 * below1[x] + below2[x] + 128) >> 8;
+
+			}
+
+		}
+	}
+
+}
+
+//Gradient direction in 4 sectors from the signs and the ratio of the
+//gradients, tan(22.5) ~ 0.4142 kept in integers:
+//0 horizontal, 1 diagonal down-right, 2 vertical, 3 diagonal up-right
+inline int gradientSector(int xG, int yG){
+
+	int ax = abs(xG);
+	int ay = abs(yG);
+
+	if(ay * 10000 <= ax * 4142) return 0;
+	if(ax * 10000 <= ay * 4142) return 2;
+
+	return (xG > 0) == (yG > 0) ? 1 : 3;
+
+}
+
+//Squared Sobel magnitude and sector of every pixel, 0 on the border
+inline void sobelDirection(const int *pixels, int *magnitude, unsigned char *sector,
+		int width, int height, int numThreads){
+
+	#pragma omp parallel for num_threads(numThreads) schedule(static)
+	for(int y = 0; y < height; y++){
+
+		int *row = magnitude + y * width;
+		unsigned char *sectors = sector + y * width;
+
+		if(y == 0 || y == height - 1 || width < 3){
+
+			for(int x = 0; x < width; x++){
+
+				row[x] = 0;
+				sectors[x] = 0;
+
+			}
+
+			continue;
+
+		}
+
+		const int *above = pixels + (y - 1) * width;
+		const int *middle = pixels + y * width;
+		const int *below = pixels + (y + 1) * width;
+
+		row[0] = row[width - 1] = 0;
+		sectors[0] = sectors[width - 1] = 0;
+
+		for(int x = 1; x < width - 1; x++){
+
+			int xG = above[x+1] + 2 * middle[x+1] + below[x+1]
+					- above[x-1] - 2 * middle[x-1] - below[x-1];
+
+			int yG = below[x-1] + 2 * below[x] + below[x+1]
+					- above[x-1] - 2 * above[x] - above[x+1];
+
+			row[x] = xG * xG + yG * yG;
+			sectors[x] = gradientSector(xG, yG);
+
+		}
+
+	}
+
+}
+
+//Keeps a pixel only if it is a maximum across the edge, ties go to the
+//pixel before it, then labels it strong, weak or none
+inline void nonMaxSuppression(const int *magnitude, const unsigned char *sector, unsigned char *labels,
+		int width, int height, int lowSquared, int highSquared, int numThreads){
+
+	//Offsets of the neighbour ahead along each sector, the other is its mirror
+	const int offsets[4] = {1, width + 1, width, -width + 1};
+
+	#pragma omp parallel for num_threads(numThreads) schedule(static)
+	for(int y = 0; y < height; y++){
+
+		unsigned char *row = labels + y * width;
+
+		for(int x = 0; x < width; x++){
+
+			int index = x + y * width;
+
+			if(y == 0 || y == height - 1 || x == 0 || x == width - 1){
+
+				row[x] = CANNY_NONE;
+
+				continue;
+
+			}
+
+			int value = magnitude[index];
+			int offset = offsets[sector[index]];
+
+			if(value < lowSquared || value <= magnitude[index - offset] || value < magnitude[index + offset]){
+
+				row[x] = CANNY_NONE;
+
+			}else{
+
+				row[x] = value >= highSquared ? CANNY_STRONG : CANNY_WEAK;
+
+			}
+
+		}
+
+	}
+
+}
+
+//Grows the strong pixels through the weak ones one frontier at a time.
+//A weak pixel is claimed with an atomic or, so every pixel enters the
+//frontier once however many threads reach it
+inline void hysteresis(unsigned char *labels, int width, int height, int numThreads){
+
+	std::vector<int> frontier;
+
+	#pragma omp parallel num_threads(numThreads)
+	{
+		std::vector<int> local;
+
+		#pragma omp for schedule(static) nowait
+		for(int i = 0; i < width * height; i++){
+
+			if(labels[i] == CANNY_STRONG) local.push_back(i);
+
+		}
+
+		#pragma omp critical
+		frontier.insert(frontier.end(), local.begin(), local.end());
+	}
+
+	const int offsets[8] = {-width - 1, -width, -width + 1, -1, 1, width - 1, width, width + 1};
+
+	while(!frontier.empty()){
+
+		std::vector<int> next;
+
+		#pragma omp parallel num_threads(numThreads)
+		{
+			std::vector<int> local;
+
+			#pragma omp for schedule(static) nowait
+			for(int f = 0; f < (int)frontier.size(); f++){
+
+				//Labelled pixels are never on the border, so neighbours exist
+				for(int n = 0; n < 8; n++){
+
+					int neighbour = frontier[f] + offsets[n];
+
+					if(labels[neighbour] != CANNY_WEAK) continue;
+
+					unsigned char old;
+
+					#pragma omp atomic capture
+					{old = labels[neighbour]; labels[neighbour] |= CANNY_STRONG;}
+
+					if(old == CANNY_WEAK) local.push_back(neighbour);
+
+				}
+
+			}
+
+			#pragma omp critical
+			next.insert(next.end(), local.begin(), local.end());
+		}
+
+		frontier.swap(next);
+
+	}
+
+}
+
+//Full pipeline, out gets 255 on edges. low and high are gradient magnitudes
+inline void cannyOpenMP(const int *pixels, int *out, int width, int height, int low, int high, int numThreads){
+
+	unsigned int imageSize = width * height;
+
+	int *blurred = (int *)malloc(imageSize * sizeof(int));
+	unsigned char *sector = (unsigned char *)malloc(imageSize);
+	unsigned char *labels = (unsigned char *)malloc(imageSize);
+
+	//out is free until the end, it holds the blur temporaries then the magnitudes
+	gaussianBlur(pixels, out, blurred, width, height, numThreads);
+
+	sobelDirection(blurred, out, sector, width, height, numThreads);
+
+	nonMaxSuppression(out, sector, labels, width, height, low * low, high * high, numThreads);
+
+	hysteresis(labels, width, height, numThreads);
+
+	#pragma omp parallel for simd num_threads(numThreads)
+	for(int i = 0; i < (int)imageSize; i++){
+
+		out[i] = labels[i] == CANNY_STRONG ? 255 : 0;
+
+	}
+
+	free(blurred);
+	free(sector);
+	free(labels);
+
+}
+
+#endif /* CANNY_H_ */
@@ -1,16 +1,11 @@
 #!/bin/bash
 echo "EDGE DETECTION - OMP - START"
-echo "threads;run;image;time" > results_omp.csv
+rm -f results_omp.csv
 for (( i=2; i<=8; i=i*2 ));
 do
-	for (( j=1; j<=5; j=j+1 ));
+	for (( j=1; j<=3; j=j+1 ));
 	do
-		for (( k=1; k<=3; k=k+1 ));
-		do
-			output=$(eval "time ./EdgeDetection image_"${k}".pgm image_"${k}"_out.pgm" ${i} 2>&1)
-			realTime=${output:8:5}
-			echo ""$i";"$j";"$k";"$output >> results_omp.csv
-		done
+		../benchmark/Benchmark -backend openmp -config "${i}" -image image_"${j}".pgm -runs 5 -out results_omp.csv -- ./EdgeDetection image_"${j}".pgm image_"${j}"_out.pgm "${i}"
 	done
 done
 echo "EDGE DETECTION - OMP - END"
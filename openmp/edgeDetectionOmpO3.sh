@@ -1,16 +1,11 @@
 #!/bin/bash
 echo "EDGE DETECTION - OMP O3 - START"
-echo "threads;run;image;time" > results_omp_o3.csv
+rm -f results_omp_o3.csv
 for (( i=2; i<=8; i=i*2 ));
 do
-	for (( j=1; j<=5; j=j+1 ));
+	for (( j=1; j<=3; j=j+1 ));
 	do
-		for (( k=1; k<=3; k=k+1 ));
-		do
-			output=$(eval "time ./EdgeDetectionO3 image_"${k}".pgm image_"${k}"_out.pgm" ${i} 2>&1)
-			realTime=${output:8:5}
-			echo ""$i";"$j";"$k";"$output >> results_omp_o3.csv
-		done
+		../benchmark/Benchmark -backend openmp_o3 -config "${i}" -image image_"${j}".pgm -runs 5 -out results_omp_o3.csv -- ./EdgeDetectionO3 image_"${j}".pgm image_"${j}"_out.pgm "${i}"
 	done
 done
 echo "EDGE DETECTION - OMP O3 - END"
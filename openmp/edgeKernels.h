@@ -0,0 +1,419 @@
+#ifndef EDGEKERNELS_H_
+#define EDGEKERNELS_H_
+
+//Adding header files
+#include <math.h>
+#include <stdlib.h>
+#include <omp.h>
+
+//Pixel loops of the engine on plain int arrays. The Image methods call
+//these, and the microbenchmarks time them, so both run the same code.
+//Sobel kernels write 0 on the one pixel border of the image.
+
+//8 bit samples to pixels, the conversion done by BinaryImage::readImage
+inline void unpackPixels(const unsigned char *bytes, int *pixels, unsigned int count){
+
+	for(unsigned int i = 0; i < count; i++){
+
+		pixels[i] = bytes[i];
+
+	}
+
+}
+
+//Pixels to 8 bit samples, the conversion done by BinaryImage::writeImage
+inline void packPixels(const int *pixels, unsigned char *bytes, unsigned int count){
+
+	for(unsigned int i = 0; i < count; i++){
+
+		bytes[i] = static_cast<unsigned char>(pixels[i]);
+
+	}
+
+}
+
+//Largest sample of a PGM, samples above 255 take two bytes
+const int MAX_PGM_VALUE = 65535;
+
+//16 bit big-endian samples to pixels, the byte swap vectorizes
+inline void unpackPixels16(const unsigned char *bytes, int *pixels, unsigned int count){
+
+	#pragma omp simd
+	for(int i = 0; i < (int)count; i++){
+
+		pixels[i] = (bytes[2 * i] << 8) | bytes[2 * i + 1];
+
+	}
+
+}
+
+//Pixels to 16 bit big-endian samples, saturated to 0 and MAX_PGM_VALUE
+inline void packPixels16(const int *pixels, unsigned char *bytes, unsigned int count){
+
+	#pragma omp simd
+	for(int i = 0; i < (int)count; i++){
+
+		int value = pixels[i] < 0 ? 0 : (pixels[i] > MAX_PGM_VALUE ? MAX_PGM_VALUE : pixels[i]);
+
+		bytes[2 * i] = value >> 8;
+		bytes[2 * i + 1] = value & 0xff;
+
+	}
+
+}
+
+//Integer BT.601 luma weights of colour input, they sum to 1 << LUMA_SHIFT
+const int LUMA_RED = 77;
+const int LUMA_GREEN = 150;
+const int LUMA_BLUE = 29;
+const int LUMA_SHIFT = 8;
+
+//Grey value of one RGB sample, rounded. Fits an int for 16 bit samples
+inline int lumaPixel(int red, int green, int blue){
+
+	return (LUMA_RED * red + LUMA_GREEN * green + LUMA_BLUE * blue + (1 << (LUMA_SHIFT - 1))) >> LUMA_SHIFT;
+
+}
+
+//Interleaved 8 bit RGB triplets to grey pixels. The stride 3 loads are
+//deinterleaved with vector shuffles, so the grey image is produced
+//without a separate conversion pass
+inline void unpackRGB(const unsigned char *bytes, int *pixels, unsigned int count){
+
+	#pragma omp simd
+	for(int i = 0; i < (int)count; i++){
+
+		pixels[i] = lumaPixel(bytes[3 * i], bytes[3 * i + 1], bytes[3 * i + 2]);
+
+	}
+
+}
+
+//Interleaved 16 bit big-endian RGB triplets to grey pixels
+inline void unpackRGB16(const unsigned char *bytes, int *pixels, unsigned int count){
+
+	#pragma omp simd
+	for(int i = 0; i < (int)count; i++){
+
+		const unsigned char *sample = bytes + 6 * i;
+
+		pixels[i] = lumaPixel((sample[0] << 8) | sample[1], (sample[2] << 8) | sample[3],
+				(sample[4] << 8) | sample[5]);
+
+	}
+
+}
+
+//Gradient magnitude of an interior pixel, truncated to int like the
+//sequential version. The squares are taken in double, 16 bit images give
+//gradients whose squares overflow an int
+inline int sobelPixel(const int *pixels, int x, int y, int width){
+
+	//Finds the horizontal gradient
+	int xG = (pixels[(x+1) + ((y-1) * width)]
+				 + (2 * pixels[(x+1) + (y * width)])
+				 + pixels[(x+1) + ((y+1) * width)]
+						  - pixels[(x-1) + ((y-1) * width)]
+								   - (2 * pixels[(x-1) + (y * width)])
+								   - pixels[(x-1) + ((y+1) * width)]);
+
+	//Finds the vertical gradient
+	int yG = (pixels[(x-1) + ((y+1) * width)]
+				 + (2 * pixels[(x) + ((y + 1) * width)])
+				 + pixels[(x+1) + ((y+1) * width)]
+						  - pixels[(x-1) + ((y-1) * width)]
+								   - (2 * pixels[(x) + ((y-1) * width)])
+								   - pixels[(x+1) + ((y-1) * width)]);
+
+	//newPixel = sqrt(xG^2 + yG^2)
+	return sqrt((double)xG * xG + (double)yG * yG);
+
+}
+
+//Sobel over rows firstRow to lastRow - 1
+inline void sobelRows(const int *pixels, int *out, int width, int height, int firstRow, int lastRow){
+
+	for(int y = firstRow; y < lastRow; y++){
+
+		for(int x = 0; x < width; x++){
+
+			if(x < (width - 1) && y < (height - 1)
+					&& (y > 0) && (x > 0)){
+
+				out[x + (y * width)] = sobelPixel(pixels, x, y, width);
+
+			}else{
+
+				//Pads out of bound pixels with 0
+				out[x + (y * width)] = 0;
+
+			}
+
+		}
+
+	}
+
+}
+
+inline void sobelScalar(const int *pixels, int *out, int width, int height){
+
+	sobelRows(pixels, out, width, height, 0, height);
+
+}
+
+//One band of rows per thread, the last thread also takes the remainder
+inline void sobelOpenMP(const int *pixels, int *out, int width, int height, int numThreads){
+
+	#pragma omp parallel num_threads(numThreads)
+	{
+		//The runtime may start fewer threads than requested
+		int threads = omp_get_num_threads();
+		int threadId = omp_get_thread_num();
+
+		int rowsPerThread = height / threads;
+		int firstRow = threadId * rowsPerThread;
+		int lastRow = threadId < threads - 1 ? firstRow + rowsPerThread : height;
+
+		sobelRows(pixels, out, width, height, firstRow, lastRow);
+	}
+
+}
+
+//Rows spread over the threads with the interior of every row vectorized,
+//the three source rows are walked with unit stride and no border tests
+inline void sobelSimd(const int *pixels, int *out, int width, int height, int numThreads){
+
+	#pragma omp parallel for num_threads(numThreads) schedule(static)
+	for(int y = 0; y < height; y++){
+
+		int *row = out + y * width;
+
+		if(y == 0 || y == height - 1 || width < 3){
+
+			for(int x = 0; x < width; x++) row[x] = 0;
+
+			continue;
+
+		}
+
+		const int *above = pixels + (y - 1) * width;
+		const int *middle = pixels + y * width;
+		const int *below = pixels + (y + 1) * width;
+
+		row[0] = 0;
+		row[width - 1] = 0;
+
+		#pragma omp simd
+		for(int x = 1; x < width - 1; x++){
+
+			int xG = above[x+1] + 2 * middle[x+1] + below[x+1]
+					- above[x-1] - 2 * middle[x-1] - below[x-1];
+
+			int yG = below[x-1] + 2 * below[x] + below[x+1]
+					- above[x-1] - 2 * above[x] - above[x+1];
+
+			row[x] = (int)sqrt((double)xG * xG + (double)yG * yG);
+
+		}
+
+	}
+
+}
+
+//Horizontal pass of the separable Sobel on one source row, [1 2 1] for
+//the vertical gradient and [-1 0 1] for the horizontal one
+inline void separableRow(const int *row, int *smooth, int *diff, int width){
+
+	#pragma omp simd
+	for(int x = 1; x < width - 1; x++){
+
+		smooth[x] = row[x-1] + 2 * row[x] + row[x+1];
+		diff[x] = row[x+1] - row[x-1];
+
+	}
+
+}
+
+//Separable Sobel over rows firstRow to lastRow - 1. Sobel is [1 2 1]^T x
+//[-1 0 1], so each source row is filtered horizontally once into a ring of
+//three smooth and three diff rows, and the vertical pass combines them:
+//xG = diff above + 2 * diff + diff below, yG = smooth below - smooth above.
+//buffer holds 6 * width ints. Results are identical to sobelRows
+inline void sobelSeparableRows(const int *pixels, int *out, int width, int height,
+		int firstRow, int lastRow, int *buffer){
+
+	int *smooth[3] = {buffer, buffer + width, buffer + 2 * width};
+	int *diff[3] = {buffer + 3 * width, buffer + 4 * width, buffer + 5 * width};
+
+	//Next source row to filter into the ring
+	int next = -1;
+
+	for(int y = firstRow; y < lastRow; y++){
+
+		int *row = out + y * width;
+
+		if(y == 0 || y == height - 1 || width < 3){
+
+			for(int x = 0; x < width; x++) row[x] = 0;
+
+			continue;
+
+		}
+
+		if(next < y - 1) next = y - 1;
+
+		for(; next <= y + 1; next++){
+
+			separableRow(pixels + next * width, smooth[next % 3], diff[next % 3], width);
+
+		}
+
+		const int *smoothAbove = smooth[(y - 1) % 3];
+		const int *smoothBelow = smooth[(y + 1) % 3];
+		const int *diffAbove = diff[(y - 1) % 3];
+		const int *diffMiddle = diff[y % 3];
+		const int *diffBelow = diff[(y + 1) % 3];
+
+		row[0] = 0;
+		row[width - 1] = 0;
+
+		#pragma omp simd
+		for(int x = 1; x < width - 1; x++){
+
+			int xG = diffAbove[x] + 2 * diffMiddle[x] + diffBelow[x];
+			int yG = smoothBelow[x] - smoothAbove[x];
+
+			row[x] = (int)sqrt((double)xG * xG + (double)yG * yG);
+
+		}
+
+	}
+
+}
+
+//Separable Sobel, one band of rows and one ring buffer per thread
+inline void sobelSeparable(const int *pixels, int *out, int width, int height, int numThreads){
+
+	#pragma omp parallel num_threads(numThreads)
+	{
+		int threads = omp_get_num_threads();
+		int threadId = omp_get_thread_num();
+
+		int rowsPerThread = height / threads;
+		int firstRow = threadId * rowsPerThread;
+		int lastRow = threadId < threads - 1 ? firstRow + rowsPerThread : height;
+
+		int *buffer = (int *)malloc(6 * width * sizeof(int));
+
+		sobelSeparableRows(pixels, out, width, height, firstRow, lastRow, buffer);
+
+		free(buffer);
+	}
+
+}
+
+//Lowest pixel, starting from initial as findMin does
+inline int findMinimum(const int *pixels, unsigned int count, int initial){
+
+	int minVal = initial;
+
+	for(unsigned int i = 0; i < count; i++){
+
+		if(pixels[i] < minVal) minVal = pixels[i];
+
+	}
+
+	return minVal;
+
+}
+
+//Highest pixel, starting from initial as findMax does
+inline int findMaximum(const int *pixels, unsigned int count, int initial){
+
+	int maxVal = initial;
+
+	for(unsigned int i = 0; i < count; i++){
+
+		if(pixels[i] > maxVal) maxVal = pixels[i];
+
+	}
+
+	return maxVal;
+
+}
+
+//Both extremes in a single pass, reduced across threads
+inline void findMinMaxOpenMP(const int *pixels, unsigned int count, int &minpix, int &maxpix, int numThreads){
+
+	int minVal = minpix;
+	int maxVal = maxpix;
+
+	#pragma omp parallel for num_threads(numThreads) reduction(min:minVal) reduction(max:maxVal)
+	for(int i = 0; i < (int)count; i++){
+
+		if(pixels[i] < minVal) minVal = pixels[i];
+		if(pixels[i] > maxVal) maxVal = pixels[i];
+
+	}
+
+	minpix = minVal;
+	maxpix = maxVal;
+
+}
+
+//Scaled value of one pixel, 0 when the image is flat
+inline int scalePixel(int value, int minpix, int maxpix){
+
+	if(maxpix <= minpix) return 0;
+
+	double calc = (double)(value - minpix) / (maxpix - minpix);
+
+	return round(calc * 255);
+
+}
+
+inline void scaleScalar(int *pixels, unsigned int count, int minpix, int maxpix){
+
+	for(unsigned int i = 0; i < count; i++){
+
+		pixels[i] = scalePixel(pixels[i], minpix, maxpix);
+
+	}
+
+}
+
+inline void scaleOpenMP(int *pixels, unsigned int count, int minpix, int maxpix, int numThreads){
+
+	#pragma omp parallel for num_threads(numThreads)
+	for(int i = 0; i < (int)count; i++){
+
+		pixels[i] = scalePixel(pixels[i], minpix, maxpix);
+
+	}
+
+}
+
+//round((value - min) / range * 255) in integers, (a * 510 + range) / (2 * range)
+//gives the same result and vectorizes without double conversions
+inline void scaleSimd(int *pixels, unsigned int count, int minpix, int maxpix, int numThreads){
+
+	int range = maxpix - minpix;
+
+	if(range <= 0){
+
+		for(unsigned int i = 0; i < count; i++) pixels[i] = 0;
+
+		return;
+
+	}
+
+	#pragma omp parallel for simd num_threads(numThreads)
+	for(int i = 0; i < (int)count; i++){
+
+		pixels[i] = ((pixels[i] - minpix) * 510 + range) / (2 * range);
+
+	}
+
+}
+
+#endif /* EDGEKERNELS_H_ */
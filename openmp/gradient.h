@@ -0,0 +1,255 @@
+#ifndef GRADIENT_H_
+#define GRADIENT_H_
+
+//Adding header files
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+//Sobel that keeps the gradient direction. Each pixel gets the usual
+//magnitude, an unsigned orientation bin over [0, 180) degrees and, for
+//HOG, its magnitude added to the histogram of its cell. Everything comes
+//out of the same pass over the image. Each thread fills its own partial
+//histograms and they are summed at the end, so no atomics are needed.
+
+const int MAX_ORIENTATION_BINS = 180;
+
+//Orientation bins, per pixel orientation and per cell histograms. The
+//vectors are left empty for outputs that were not asked for
+struct GradientFeatures{
+
+	int bins;
+	int cellSize;
+	int cellsX;
+	int cellsY;
+	std::vector<unsigned char> orientation;
+	std::vector<unsigned int> histograms;
+
+};
+
+//Bin of a gradient, the number of bin boundaries it lies past. The
+//gradient is folded into the upper half plane first, so an angle is past
+//boundary k when the cross product with the boundary is positive. Angles
+//on a boundary belong to the lower bin, a zero gradient to bin 0
+inline int orientationBin(int xG, int yG, const float *boundaryCos, const float *boundarySin, int bins){
+
+	if(yG < 0 || (yG == 0 && xG < 0)){
+
+		xG = -xG;
+		yG = -yG;
+
+	}
+
+	int bin = 0;
+
+	for(int k = 1; k < bins; k++){
+
+		bin += boundaryCos[k] * yG - boundarySin[k] * xG > 0.0f;
+
+	}
+
+	return bin;
+
+}
+
+//Magnitude into out, orientation and cell histograms into features as
+//requested. features.bins and cellSize must be set
+inline void sobelFeatures(const int *pixels, int *out, int width, int height, GradientFeatures &features,
+		bool orientation, bool hog, int numThreads){
+
+	int bins = features.bins;
+	int cellSize = features.cellSize;
+
+	std::vector<float> boundaryCos(bins);
+	std::vector<float> boundarySin(bins);
+
+	for(int k = 0; k < bins; k++){
+
+		boundaryCos[k] = cos(M_PI * k / bins);
+		boundarySin[k] = sin(M_PI * k / bins);
+
+	}
+
+	features.cellsX = (width + cellSize - 1) / cellSize;
+	features.cellsY = (height + cellSize - 1) / cellSize;
+
+	unsigned int histogramSize = features.cellsX * features.cellsY * bins;
+
+	if(orientation) features.orientation.assign(width * height, 0);
+	if(hog) features.histograms.assign(histogramSize, 0);
+
+	unsigned char *orientations = orientation ? &features.orientation[0] : NULL;
+
+	std::vector<unsigned int *> partials;
+
+	#pragma omp parallel num_threads(numThreads)
+	{
+		int threads = omp_get_num_threads();
+		int threadId = omp_get_thread_num();
+
+		#pragma omp single
+		partials.assign(threads, (unsigned int *)NULL);
+
+		unsigned int *partial = NULL;
+
+		if(hog){
+
+			partial = (unsigned int *)calloc(histogramSize, sizeof(unsigned int));
+
+			partials[threadId] = partial;
+
+		}
+
+		int rowsPerThread = height / threads;
+		int firstRow = threadId * rowsPerThread;
+		int lastRow = threadId < threads - 1 ? firstRow + rowsPerThread : height;
+
+		for(int y = firstRow; y < lastRow; y++){
+
+			int *row = out + y * width;
+			unsigned char *binRow = orientations ? orientations + y * width : NULL;
+			unsigned int *cellRow = partial ? partial + (y / cellSize) * features.cellsX * bins : NULL;
+
+			//Border pixels have no gradient, magnitude and bin stay 0
+			if(y == 0 || y == height - 1){
+
+				for(int x = 0; x < width; x++) row[x] = 0;
+
+				continue;
+
+			}
+
+			row[0] = 0;
+			row[width - 1] = 0;
+
+			const int *above = pixels + (y - 1) * width;
+			const int *middle = pixels + y * width;
+			const int *below = pixels + (y + 1) * width;
+
+			for(int x = 1; x < width - 1; x++){
+
+				int xG = above[x+1] + 2 * middle[x+1] + below[x+1]
+						- above[x-1] - 2 * middle[x-1] - below[x-1];
+
+				int yG = below[x-1] + 2 * below[x] + below[x+1]
+						- above[x-1] - 2 * above[x] - above[x+1];
+
+				int magnitude = (int)sqrt((double)xG * xG + (double)yG * yG);
+
+				row[x] = magnitude;
+
+				int bin = orientationBin(xG, yG, &boundaryCos[0], &boundarySin[0], bins);
+
+				if(binRow) binRow[x] = bin;
+				if(cellRow) cellRow[(x / cellSize) * bins + bin] += magnitude;
+
+			}
+
+		}
+
+		#pragma omp barrier
+
+		//Partial histograms summed entry by entry across the threads
+		if(hog){
+
+			#pragma omp for schedule(static)
+			for(int i = 0; i < (int)histogramSize; i++){
+
+				unsigned int sum = 0;
+
+				for(int t = 0; t < threads; t++) sum += partials[t][i];
+
+				features.histograms[i] = sum;
+
+			}
+
+			free(partial);
+
+		}
+	}
+
+}
+
+//Orientation bins as a PGM with the last bin as the max pixel value
+inline void writeOrientation(const std::string &fileName, const GradientFeatures &features, int width, int height){
+
+	std::ofstream outFile(fileName.c_str(), std::ios::binary | std::ios::out | std::ios::trunc);
+
+	if(!outFile){
+
+		std::cerr << "Error: cannot write " << fileName << std::endl;
+
+		exit(1000);
+
+	}
+
+	outFile << "P5" << " " << width << " " << height << " " << features.bins - 1 << std::endl;
+
+	outFile.write((const char *)&features.orientation[0], features.orientation.size());
+
+}
+
+//One record per cell, a JSON object per line for .json names and a
+//semicolon separated CSV otherwise
+inline void writeHistograms(const std::string &fileName, const GradientFeatures &features){
+
+	bool json = fileName.size() >= 5 && fileName.compare(fileName.size() - 5, 5, ".json") == 0;
+
+	FILE *fp = fopen(fileName.c_str(), "w");
+
+	if(!fp){
+
+		std::cerr << "Error: cannot write " << fileName << std::endl;
+
+		exit(1000);
+
+	}
+
+	if(!json){
+
+		fprintf(fp, "cell_x;cell_y");
+
+		for(int b = 0; b < features.bins; b++) fprintf(fp, ";bin_%d", b);
+
+		fprintf(fp, "\n");
+
+	}
+
+	for(int cy = 0; cy < features.cellsY; cy++){
+
+		for(int cx = 0; cx < features.cellsX; cx++){
+
+			const unsigned int *histogram = &features.histograms[(cy * features.cellsX + cx) * features.bins];
+
+			if(json){
+
+				fprintf(fp, "{\"cell_x\": %d, \"cell_y\": %d, \"histogram\": [", cx, cy);
+
+				for(int b = 0; b < features.bins; b++) fprintf(fp, b == 0 ? "%u" : ", %u", histogram[b]);
+
+				fprintf(fp, "]}\n");
+
+			}else{
+
+				fprintf(fp, "%d;%d", cx, cy);
+
+				for(int b = 0; b < features.bins; b++) fprintf(fp, ";%u", histogram[b]);
+
+				fprintf(fp, "\n");
+
+			}
+
+		}
+
+	}
+
+	fclose(fp);
+
+}
+
+#endif /* GRADIENT_H_ */
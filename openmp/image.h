@@ -4,6 +4,7 @@
 //Adding header files
 #include <iostream>
 #include <math.h>
+#include <limits.h>
 #include <fstream>
 #include <sstream>
 #include <time.h>
@@ -341,6 +342,15 @@ void Image::readHeader(ifstream &inFile){
 
 	}
 
+	//Pixels are indexed with int, larger images would overflow it
+	if(width > INT_MAX / height){
+
+		cerr << "Error: image too large, width * height must fit in an int" << endl;
+
+		exit(1002);
+
+	}
+
 	//Check if there are any comments between height/width and maxPixelValue
 	while(getline(inFile, line)){
 
@@ -432,10 +442,6 @@ void Image::findMin(){
 //Scales image so that the maximum pixel value is 255
 void Image::scaleImage(){
 
-	double calc = 0.0;
-
-	int newPixelValue = 0;
-
 	findMin();
 
 	findMax();
@@ -443,9 +449,10 @@ void Image::scaleImage(){
 	#pragma omp parallel for
 	for(int i = 0; i < imageSize; i++){
 
-		calc = (double)(pixels[i] - minpix) / (maxpix - minpix);
+		//Declared in the loop so every thread has its own copy
+		double calc = (double)(pixels[i] - minpix) / (maxpix - minpix);
 
-		newPixelValue = round(calc * 255);
+		int newPixelValue = round(calc * 255);
 
 		pixels[i] = newPixelValue;
 
@@ -504,7 +511,8 @@ void Image::edgeDetection(int numThreads){
 
 			x = i % width;
 
-			if(i != 0 && x == 0){
+			//y already holds the first row of the band, only later rows advance it
+			if(i != (unsigned int)start && x == 0){
 
 				y++;
 
@@ -0,0 +1,163 @@
+#ifndef INCREMENTAL_H_
+#define INCREMENTAL_H_
+
+//Adding header files
+#include <vector>
+#include <omp.h>
+#include "tiled.h"
+
+//Change tracking for -incremental. A frame is split into square tiles
+//and compared with the previous one tile by tile. Only the output tiles
+//within the operator halo of a changed tile are computed again, the min
+//and max of every output tile are kept so the scaling range is found
+//without a pass over the frame.
+
+//Tile grid of a width x height frame, reusing the container layout
+inline TiledHeader tileGrid(int width, int height, int tileSize){
+
+	TiledHeader grid;
+
+	grid.width = width;
+	grid.height = height;
+	grid.maxPixelValue = 0;
+	grid.tileSize = tileSize;
+
+	initTiledHeader(grid);
+
+	return grid;
+
+}
+
+//Sets changed[t] when tile t of current differs from previous. Rows are
+//compared with an OR of XORs that vectorizes, a tile stops at its first
+//differing row
+inline void changedTiles(const int *current, const int *previous, const TiledHeader &grid, char *changed,
+		int numThreads){
+
+	int tiles = grid.tilesX * grid.tilesY;
+
+	#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+	for(int t = 0; t < tiles; t++){
+
+		Region tile = tileRegion(grid, t);
+
+		int diff = 0;
+
+		for(int y = tile.y; y < tile.y + tile.height && diff == 0; y++){
+
+			const int *a = current + (size_t)y * grid.width + tile.x;
+			const int *b = previous + (size_t)y * grid.width + tile.x;
+
+			#pragma omp simd reduction(|:diff)
+			for(int x = 0; x < tile.width; x++) diff |= a[x] ^ b[x];
+
+		}
+
+		changed[t] = diff != 0;
+
+	}
+
+}
+
+//Output tiles whose pixels read a changed tile, those within halo of it
+inline void affectedTiles(const TiledHeader &grid, const char *changed, int halo, std::vector<char> &affected){
+
+	affected.assign(grid.tilesX * grid.tilesY, 0);
+
+	//Tiles a halo reaches on each side
+	int reach = (halo + grid.tileSize - 1) / grid.tileSize;
+
+	for(int t = 0; t < grid.tilesX * grid.tilesY; t++){
+
+		if(!changed[t]) continue;
+
+		int tx = t % grid.tilesX;
+		int ty = t / grid.tilesX;
+
+		for(int y = ty - reach; y <= ty + reach; y++){
+
+			for(int x = tx - reach; x <= tx + reach; x++){
+
+				if(x >= 0 && y >= 0 && x < grid.tilesX && y < grid.tilesY) affected[y * grid.tilesX + x] = 1;
+
+			}
+
+		}
+
+	}
+
+}
+
+//Runs of affected tiles along every tile row, as pixel rectangles
+inline void affectedRegions(const TiledHeader &grid, const std::vector<char> &affected, std::vector<Region> &regions){
+
+	regions.clear();
+
+	for(int ty = 0; ty < grid.tilesY; ty++){
+
+		int tx = 0;
+
+		while(tx < grid.tilesX){
+
+			if(!affected[ty * grid.tilesX + tx]){
+
+				tx++;
+
+				continue;
+
+			}
+
+			Region first = tileRegion(grid, ty * grid.tilesX + tx);
+
+			while(tx < grid.tilesX && affected[ty * grid.tilesX + tx]) tx++;
+
+			Region last = tileRegion(grid, ty * grid.tilesX + tx - 1);
+
+			Region run = {first.x, first.y, last.x + last.width - first.x, first.height};
+
+			regions.push_back(run);
+
+		}
+
+	}
+
+}
+
+//Min and max of every tile that is set in affected
+inline void tileMinMax(const int *pixels, const TiledHeader &grid, const std::vector<char> &affected,
+		std::vector<int> &tileMin, std::vector<int> &tileMax, int numThreads){
+
+	int tiles = grid.tilesX * grid.tilesY;
+
+	#pragma omp parallel for schedule(dynamic) num_threads(numThreads)
+	for(int t = 0; t < tiles; t++){
+
+		if(!affected[t]) continue;
+
+		Region tile = tileRegion(grid, t);
+
+		int minVal = pixels[(size_t)tile.y * grid.width + tile.x];
+		int maxVal = minVal;
+
+		for(int y = tile.y; y < tile.y + tile.height; y++){
+
+			const int *row = pixels + (size_t)y * grid.width + tile.x;
+
+			#pragma omp simd reduction(min:minVal) reduction(max:maxVal)
+			for(int x = 0; x < tile.width; x++){
+
+				if(row[x] < minVal) minVal = row[x];
+				if(row[x] > maxVal) maxVal = row[x];
+
+			}
+
+		}
+
+		tileMin[t] = minVal;
+		tileMax[t] = maxVal;
+
+	}
+
+}
+
+#endif /* INCREMENTAL_H_ */
@@ -0,0 +1,252 @@
+#ifndef MAGNITUDE_H_
+#define MAGNITUDE_H_
+
+//Adding header files
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <omp.h>
+#include "edgeKernels.h"
+
+//Sobel gradient magnitudes other than the exact sqrt(xG^2 + yG^2). Each
+//mode is a struct with a static function, so sobelMagnitudeRows is
+//specialized per mode and the row loop vectorizes with integer operations
+//only:
+//  l1      |xG| + |yG|, up to 41% above the exact value on diagonals
+//  maxmin  max + min / 2, from exact to 12% above
+//  lut     xG^2 + yG^2, the sqrt is deferred to the scaling pass where a
+//          table gives the scaled value of every square, same image as exact
+//benchmark/MagnitudeAccuracy reports the error of every mode against exact.
+
+struct ExactMagnitude{
+
+	static constexpr const char *NAME = "exact";
+
+	static inline int of(int xG, int yG){return (int)sqrt((double)xG * xG + (double)yG * yG);}
+
+};
+
+struct L1Magnitude{
+
+	static constexpr const char *NAME = "l1";
+
+	static inline int of(int xG, int yG){return abs(xG) + abs(yG);}
+
+};
+
+//Alpha max plus beta min with alpha 1 and beta 1/2
+struct MaxMinMagnitude{
+
+	static constexpr const char *NAME = "maxmin";
+
+	static inline int of(int xG, int yG){
+
+		int ax = abs(xG);
+		int ay = abs(yG);
+
+		return (ax > ay ? ax : ay) + ((ax < ay ? ax : ay) >> 1);
+
+	}
+
+};
+
+struct SquaredMagnitude{
+
+	static constexpr const char *NAME = "lut";
+
+	static inline int of(int xG, int yG){return xG * xG + yG * yG;}
+
+};
+
+enum MagnitudeMode{
+
+	MAGNITUDE_EXACT,
+	MAGNITUDE_L1,
+	MAGNITUDE_MAXMIN,
+	MAGNITUDE_LUT
+
+};
+
+inline bool parseMagnitude(const char *name, MagnitudeMode &mode){
+
+	if(strcmp(name, ExactMagnitude::NAME) == 0) mode = MAGNITUDE_EXACT;
+	else if(strcmp(name, L1Magnitude::NAME) == 0) mode = MAGNITUDE_L1;
+	else if(strcmp(name, MaxMinMagnitude::NAME) == 0) mode = MAGNITUDE_MAXMIN;
+	else if(strcmp(name, SquaredMagnitude::NAME) == 0) mode = MAGNITUDE_LUT;
+	else return false;
+
+	return true;
+
+}
+
+//Magnitude of one gradient chosen at run time, the scalar form
+inline int magnitudePixel(int xG, int yG, MagnitudeMode mode){
+
+	switch(mode){
+
+	case MAGNITUDE_L1:
+		return L1Magnitude::of(xG, yG);
+	case MAGNITUDE_MAXMIN:
+		return MaxMinMagnitude::of(xG, yG);
+	case MAGNITUDE_LUT:
+		return SquaredMagnitude::of(xG, yG);
+	default:
+		return ExactMagnitude::of(xG, yG);
+
+	}
+
+}
+
+//Sobel over rows firstRow to lastRow - 1 with the mode inlined in the
+//vectorized interior loop
+template <class Magnitude>
+inline void sobelMagnitudeRows(const int *pixels, int *out, int width, int height, int firstRow, int lastRow){
+
+	for(int y = firstRow; y < lastRow; y++){
+
+		int *row = out + y * width;
+
+		if(y == 0 || y == height - 1 || width < 3){
+
+			for(int x = 0; x < width; x++) row[x] = 0;
+
+			continue;
+
+		}
+
+		const int *above = pixels + (y - 1) * width;
+		const int *middle = pixels + y * width;
+		const int *below = pixels + (y + 1) * width;
+
+		row[0] = 0;
+		row[width - 1] = 0;
+
+		#pragma omp simd
+		for(int x = 1; x < width - 1; x++){
+
+			int xG = above[x+1] + 2 * middle[x+1] + below[x+1]
+					- above[x-1] - 2 * middle[x-1] - below[x-1];
+
+			int yG = below[x-1] + 2 * below[x] + below[x+1]
+					- above[x-1] - 2 * above[x] - above[x+1];
+
+			row[x] = Magnitude::of(xG, yG);
+
+		}
+
+	}
+
+}
+
+//Scalar Sobel with the mode picked per pixel, the reference for the others
+inline void sobelMagnitudeScalar(const int *pixels, int *out, int width, int height, MagnitudeMode mode){
+
+	for(int y = 0; y < height; y++){
+
+		for(int x = 0; x < width; x++){
+
+			if(x == 0 || y == 0 || x == width - 1 || y == height - 1){
+
+				out[x + y * width] = 0;
+
+				continue;
+
+			}
+
+			int xG = pixels[(x+1) + (y-1) * width] + 2 * pixels[(x+1) + y * width] + pixels[(x+1) + (y+1) * width]
+					- pixels[(x-1) + (y-1) * width] - 2 * pixels[(x-1) + y * width] - pixels[(x-1) + (y+1) * width];
+
+			int yG = pixels[(x-1) + (y+1) * width] + 2 * pixels[x + (y+1) * width] + pixels[(x+1) + (y+1) * width]
+					- pixels[(x-1) + (y-1) * width] - 2 * pixels[x + (y-1) * width] - pixels[(x+1) + (y-1) * width];
+
+			out[x + y * width] = magnitudePixel(xG, yG, mode);
+
+		}
+
+	}
+
+}
+
+template <class Magnitude>
+inline void sobelMagnitudeOpenMP(const int *pixels, int *out, int width, int height, int numThreads){
+
+	#pragma omp parallel num_threads(numThreads)
+	{
+		int threads = omp_get_num_threads();
+		int threadId = omp_get_thread_num();
+
+		int rowsPerThread = height / threads;
+		int firstRow = threadId * rowsPerThread;
+		int lastRow = threadId < threads - 1 ? firstRow + rowsPerThread : height;
+
+		sobelMagnitudeRows<Magnitude>(pixels, out, width, height, firstRow, lastRow);
+	}
+
+}
+
+//Vectorized Sobel for a mode chosen at run time
+inline void sobelMagnitude(MagnitudeMode mode, const int *pixels, int *out, int width, int height, int numThreads){
+
+	switch(mode){
+
+	case MAGNITUDE_L1:
+		sobelMagnitudeOpenMP<L1Magnitude>(pixels, out, width, height, numThreads);
+		break;
+	case MAGNITUDE_MAXMIN:
+		sobelMagnitudeOpenMP<MaxMinMagnitude>(pixels, out, width, height, numThreads);
+		break;
+	case MAGNITUDE_LUT:
+		sobelMagnitudeOpenMP<SquaredMagnitude>(pixels, out, width, height, numThreads);
+		break;
+	default:
+		sobelMagnitudeOpenMP<ExactMagnitude>(pixels, out, width, height, numThreads);
+		break;
+
+	}
+
+}
+
+//Scaled output of every square up to maxSquared, scalePixel(floor(sqrt(n)))
+//for entry n. Squares with the same root form a run, so the table is
+//filled one run at a time and no sqrt is taken per entry. The Sobel border
+//is 0, so minpix is 0 and every entry fits a byte
+inline void squaredScaleTable(std::vector<unsigned char> &table, int maxSquared, int minpix, int maxpix){
+
+	table.resize(maxSquared + 1);
+
+	for(long long root = 0; root * root <= maxSquared; root++){
+
+		long long first = root * root;
+		long long last = (root + 1) * (root + 1) - 1;
+
+		if(last > maxSquared) last = maxSquared;
+
+		memset(&table[first], scalePixel(root, minpix, maxpix), last - first + 1);
+
+	}
+
+}
+
+//Scales squared magnitudes in place with a table lookup per pixel.
+//maxSquared bounds the squares, minpix and maxpix are the roots the exact
+//version would have found
+inline void scaleSquaredOpenMP(int *pixels, unsigned int count, int maxSquared, int minpix, int maxpix,
+		int numThreads){
+
+	std::vector<unsigned char> table;
+
+	squaredScaleTable(table, maxSquared, minpix, maxpix);
+
+	const unsigned char *scaled = &table[0];
+
+	#pragma omp parallel for simd num_threads(numThreads)
+	for(int i = 0; i < (int)count; i++){
+
+		pixels[i] = scaled[pixels[i]];
+
+	}
+
+}
+
+#endif /* MAGNITUDE_H_ */
@@ -0,0 +1,171 @@
+#ifndef NORMALIZE_H_
+#define NORMALIZE_H_
+
+//Adding header files
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+//Output normalizations other than the min-max stretch of scaleImage:
+//  percentile  stretch between two percentiles, clipping what lies outside,
+//              so a few hot pixels no longer squeeze the rest of the range
+//  equalize    histogram equalization, every output level gets about the
+//              same number of pixels
+//Both take one histogram pass and one table lookup pass. Each thread fills
+//a private histogram that is merged at the end. opencl/normalize.h has a
+//copy of the table code for the OpenCL host.
+
+//Values are clamped into the histogram, Sobel magnitudes of 8 bit images
+//stay far below it
+const int HISTOGRAM_BINS = 1 << 16;
+
+enum NormalizeMode{
+
+	NORMALIZE_MINMAX,
+	NORMALIZE_PERCENTILE,
+	NORMALIZE_EQUALIZE
+
+};
+
+//Mode and the clipping percentiles of the percentile mode
+struct Normalization{
+
+	NormalizeMode mode;
+	double lowPercent;
+	double highPercent;
+
+};
+
+inline bool parseNormalization(const char *name, NormalizeMode &mode){
+
+	if(strcmp(name, "minmax") == 0) mode = NORMALIZE_MINMAX;
+	else if(strcmp(name, "percentile") == 0) mode = NORMALIZE_PERCENTILE;
+	else if(strcmp(name, "equalize") == 0) mode = NORMALIZE_EQUALIZE;
+	else return false;
+
+	return true;
+
+}
+
+inline int histogramBin(int value){
+
+	return value < 0 ? 0 : (value >= HISTOGRAM_BINS ? HISTOGRAM_BINS - 1 : value);
+
+}
+
+//histogram holds HISTOGRAM_BINS counts and is overwritten
+inline void histogramOpenMP(const int *pixels, unsigned int count, unsigned int *histogram, int numThreads){
+
+	memset(histogram, 0, HISTOGRAM_BINS * sizeof(unsigned int));
+
+	#pragma omp parallel num_threads(numThreads)
+	{
+		std::vector<unsigned int> local(HISTOGRAM_BINS, 0);
+
+		//Only the range this thread saw is merged
+		int lowest = HISTOGRAM_BINS;
+		int highest = -1;
+
+		#pragma omp for schedule(static) nowait
+		for(int i = 0; i < (int)count; i++){
+
+			int bin = histogramBin(pixels[i]);
+
+			local[bin]++;
+
+			if(bin < lowest) lowest = bin;
+			if(bin > highest) highest = bin;
+
+		}
+
+		#pragma omp critical
+		for(int bin = lowest; bin <= highest; bin++) histogram[bin] += local[bin];
+	}
+
+}
+
+//Smallest value with more than rank pixels at or below it
+inline int histogramRank(const unsigned int *histogram, double rank){
+
+	double cumulative = 0;
+
+	for(int bin = 0; bin < HISTOGRAM_BINS; bin++){
+
+		cumulative += histogram[bin];
+
+		if(cumulative > rank) return bin;
+
+	}
+
+	return HISTOGRAM_BINS - 1;
+
+}
+
+//Output byte of every histogram bin. The stretch of the min-max and
+//percentile modes rounds like scalePixel, so minmax gives the scaleImage
+//image whenever the minimum is below 255
+inline void normalizationTable(const unsigned int *histogram, unsigned int count, const Normalization &normalization,
+		unsigned char *table){
+
+	memset(table, 0, HISTOGRAM_BINS);
+
+	if(count == 0) return;
+
+	int lowest = histogramRank(histogram, 0);
+	int highest = histogramRank(histogram, count - 1);
+
+	if(normalization.mode == NORMALIZE_EQUALIZE){
+
+		//Cumulative count mapped onto 0 to 255, the lowest value goes to 0
+		double below = histogram[lowest];
+		double range = count - below;
+		double cumulative = 0;
+
+		for(int bin = lowest; bin <= highest; bin++){
+
+			cumulative += histogram[bin];
+
+			table[bin] = range > 0 ? (unsigned char)floor((cumulative - below) * 255.0 / range + 0.5) : 0;
+
+		}
+
+		for(int bin = highest + 1; bin < HISTOGRAM_BINS; bin++) table[bin] = table[highest];
+
+		return;
+
+	}
+
+	int low = lowest;
+	int high = highest;
+
+	if(normalization.mode == NORMALIZE_PERCENTILE){
+
+		low = histogramRank(histogram, count * normalization.lowPercent / 100.0);
+		high = histogramRank(histogram, count * normalization.highPercent / 100.0 - 1);
+
+	}
+
+	int range = high - low;
+
+	for(int bin = 0; bin < HISTOGRAM_BINS; bin++){
+
+		if(range <= 0 || bin <= low) table[bin] = 0;
+		else if(bin >= high) table[bin] = 255;
+		else table[bin] = ((bin - low) * 510 + range) / (2 * range);
+
+	}
+
+}
+
+inline void applyTableOpenMP(int *pixels, unsigned int count, const unsigned char *table, int numThreads){
+
+	#pragma omp parallel for simd num_threads(numThreads)
+	for(int i = 0; i < (int)count; i++){
+
+		pixels[i] = table[histogramBin(pixels[i])];
+
+	}
+
+}
+
+#endif /* NORMALIZE_H_ */
@@ -0,0 +1,115 @@
+#ifndef OPERATORS_H_
+#define OPERATORS_H_
+
+//Adding header files
+#include <string.h>
+
+//Edge operator tables. Each operator holds its radius and its coefficients
+//as constexpr arrays indexed [dy + RADIUS][dx + RADIUS]. Gradient operators
+//give sqrt(xG^2 + yG^2), the others |xG|. The static constexpr members rely
+//on C++17 inline variables. There is no OpenMP here, stencil.h builds the
+//loops from these tables and opencl/GenerateStencilCL emits the OpenCL
+//kernels from them.
+
+struct SobelOperator{
+
+	static constexpr const char *NAME = "sobel";
+	static constexpr int RADIUS = 1;
+	static constexpr bool GRADIENT = true;
+	static constexpr int X[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
+	static constexpr int Y[3][3] = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}};
+
+};
+
+//Rotationally more accurate weights than Sobel
+struct ScharrOperator{
+
+	static constexpr const char *NAME = "scharr";
+	static constexpr int RADIUS = 1;
+	static constexpr bool GRADIENT = true;
+	static constexpr int X[3][3] = {{-3, 0, 3}, {-10, 0, 10}, {-3, 0, 3}};
+	static constexpr int Y[3][3] = {{-3, -10, -3}, {0, 0, 0}, {3, 10, 3}};
+
+};
+
+struct PrewittOperator{
+
+	static constexpr const char *NAME = "prewitt";
+	static constexpr int RADIUS = 1;
+	static constexpr bool GRADIENT = true;
+	static constexpr int X[3][3] = {{-1, 0, 1}, {-1, 0, 1}, {-1, 0, 1}};
+	static constexpr int Y[3][3] = {{-1, -1, -1}, {0, 0, 0}, {1, 1, 1}};
+
+};
+
+//Second derivative, a single kernel so Y is unused
+struct LaplacianOperator{
+
+	static constexpr const char *NAME = "laplacian";
+	static constexpr int RADIUS = 1;
+	static constexpr bool GRADIENT = false;
+	static constexpr int X[3][3] = {{0, 1, 0}, {1, -4, 1}, {0, 1, 0}};
+	static constexpr int Y[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+
+};
+
+//[1 4 6 4 1] smoothing with a [-1 -2 0 2 1] derivative, at most 48 times
+//the largest sample per gradient, stencilRows squares them in double
+struct Sobel5Operator{
+
+	static constexpr const char *NAME = "sobel5";
+	static constexpr int RADIUS = 2;
+	static constexpr bool GRADIENT = true;
+	static constexpr int X[5][5] = {{-1, -2, 0, 2, 1}, {-4, -8, 0, 8, 4}, {-6, -12, 0, 12, 6},
+			{-4, -8, 0, 8, 4}, {-1, -2, 0, 2, 1}};
+	static constexpr int Y[5][5] = {{-1, -4, -6, -4, -1}, {-2, -8, -12, -8, -2}, {0, 0, 0, 0, 0},
+			{2, 8, 12, 8, 2}, {1, 4, 6, 4, 1}};
+
+};
+
+//Operators selectable at run time
+enum StencilOperator{
+
+	STENCIL_SOBEL,
+	STENCIL_SCHARR,
+	STENCIL_PREWITT,
+	STENCIL_LAPLACIAN,
+	STENCIL_SOBEL5
+
+};
+
+//Maps an operator name to its enum, false for unknown names
+inline bool parseStencil(const char *name, StencilOperator &stencil){
+
+	if(strcmp(name, SobelOperator::NAME) == 0) stencil = STENCIL_SOBEL;
+	else if(strcmp(name, ScharrOperator::NAME) == 0) stencil = STENCIL_SCHARR;
+	else if(strcmp(name, PrewittOperator::NAME) == 0) stencil = STENCIL_PREWITT;
+	else if(strcmp(name, LaplacianOperator::NAME) == 0) stencil = STENCIL_LAPLACIAN;
+	else if(strcmp(name, Sobel5Operator::NAME) == 0) stencil = STENCIL_SOBEL5;
+	else return false;
+
+	return true;
+
+}
+
+//Pixels an operator reads on each side of the output pixel
+inline int stencilRadius(StencilOperator stencil){
+
+	switch(stencil){
+
+	case STENCIL_SCHARR:
+		return ScharrOperator::RADIUS;
+	case STENCIL_PREWITT:
+		return PrewittOperator::RADIUS;
+	case STENCIL_LAPLACIAN:
+		return LaplacianOperator::RADIUS;
+	case STENCIL_SOBEL5:
+		return Sobel5Operator::RADIUS;
+	default:
+		return SobelOperator::RADIUS;
+
+	}
+
+}
+
+#endif /* OPERATORS_H_ */
@@ -0,0 +1,162 @@
+#ifndef PYRAMID_H_
+#define PYRAMID_H_
+
+//Adding header files
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+//Decimation by two for image pyramids. Each level has half the width and
+//height of the one below, so all the levels above the base add a third of
+//its pixels. Odd last rows and columns are dropped:
+//  box       mean of every 2x2 block
+//  gaussian  [1 4 6 4 1] / 16 in both directions centred on every second
+//            pixel, the REDUCE step of a Gaussian pyramid. Border pixels
+//            are repeated
+//Both round to the nearest integer, so levels do not depend on the thread
+//count.
+
+//Levels smaller than this in either direction have no interior for Sobel
+const int MIN_PYRAMID_SIZE = 3;
+
+enum Decimation{
+
+	DECIMATE_BOX,
+	DECIMATE_GAUSSIAN
+
+};
+
+inline bool parseDecimation(const char *name, Decimation &mode){
+
+	if(strcmp(name, "box") == 0) mode = DECIMATE_BOX;
+	else if(strcmp(name, "gaussian") == 0) mode = DECIMATE_GAUSSIAN;
+	else return false;
+
+	return true;
+
+}
+
+//out is width / 2 x height / 2
+inline void decimateBox(const int *in, int width, int height, int *out, int numThreads){
+
+	int outWidth = width / 2;
+	int outHeight = height / 2;
+
+	#pragma omp parallel for num_threads(numThreads)
+	for(int y = 0; y < outHeight; y++){
+
+		const int *top = in + (size_t)(2 * y) * width;
+		const int *bottom = top + width;
+		int *row = out + (size_t)y * outWidth;
+
+		#pragma omp simd
+		for(int x = 0; x < outWidth; x++){
+
+			row[x] = (top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1] + 2) >> 2;
+
+		}
+
+	}
+
+}
+
+//Five taps around pixel c of a row, repeating the border pixels
+inline int reduceClamped(const int *in, int width, int c){
+
+	const int weights[5] = {1, 4, 6, 4, 1};
+
+	int sum = 0;
+
+	for(int k = -2; k <= 2; k++){
+
+		int i = c + k < 0 ? 0 : (c + k >= width ? width - 1 : c + k);
+
+		sum += weights[k + 2] * in[i];
+
+	}
+
+	return sum;
+
+}
+
+//Horizontal pass of one row, five taps around every second pixel. Sums
+//keep the 16 scale, the vertical pass divides once
+inline void reduceRow(const int *in, int width, int *out, int outWidth){
+
+	//Columns whose taps stay inside the row, 2x - 2 >= 0 and 2x + 2 < width
+	int last = (width - 3) / 2;
+
+	if(last > outWidth - 1) last = outWidth - 1;
+
+	out[0] = reduceClamped(in, width, 0);
+
+	#pragma omp simd
+	for(int x = 1; x <= last; x++){
+
+		const int *p = in + 2 * x;
+
+		out[x] = p[-2] + 4 * p[-1] + 6 * p[0] + 4 * p[1] + p[2];
+
+	}
+
+	for(int x = last + 1 > 1 ? last + 1 : 1; x < outWidth; x++) out[x] = reduceClamped(in, width, 2 * x);
+
+}
+
+//out is width / 2 x height / 2
+inline void decimateGaussian(const int *in, int width, int height, int *out, int numThreads){
+
+	int outWidth = width / 2;
+	int outHeight = height / 2;
+
+	//Horizontal sums of every input row
+	int *rows = (int *)malloc((size_t)outWidth * height * sizeof(int));
+
+	#pragma omp parallel num_threads(numThreads)
+	{
+		#pragma omp for
+		for(int y = 0; y < height; y++){
+
+			reduceRow(in + (size_t)y * width, width, rows + (size_t)y * outWidth, outWidth);
+
+		}
+
+		#pragma omp for
+		for(int y = 0; y < outHeight; y++){
+
+			const int *taps[5];
+
+			for(int k = -2; k <= 2; k++){
+
+				int i = 2 * y + k < 0 ? 0 : (2 * y + k >= height ? height - 1 : 2 * y + k);
+
+				taps[k + 2] = rows + (size_t)i * outWidth;
+
+			}
+
+			int *row = out + (size_t)y * outWidth;
+
+			#pragma omp simd
+			for(int x = 0; x < outWidth; x++){
+
+				int sum = taps[0][x] + 4 * taps[1][x] + 6 * taps[2][x] + 4 * taps[3][x] + taps[4][x];
+
+				row[x] = (sum + 128) >> 8;
+
+			}
+
+		}
+	}
+
+	free(rows);
+
+}
+
+inline void decimate(Decimation mode, const int *in, int width, int height, int *out, int numThreads){
+
+	if(mode == DECIMATE_GAUSSIAN) decimateGaussian(in, width, height, out, numThreads);
+	else decimateBox(in, width, height, out, numThreads);
+
+}
+
+#endif /* PYRAMID_H_ */
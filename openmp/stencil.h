@@ -0,0 +1,115 @@
+#ifndef STENCIL_H_
+#define STENCIL_H_
+
+//Adding header files
+#include <math.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "operators.h"
+
+//Edge operators as compile time stencils. stencilRows is specialized on
+//the tables of operators.h: the loops over the window are unrolled and
+//zero coefficients disappear. Pixels closer than RADIUS to the border
+//are 0.
+
+//Stencil over rows firstRow to lastRow - 1
+template <class Operator>
+inline void stencilRows(const int *pixels, int *out, int width, int height, int firstRow, int lastRow){
+
+	const int R = Operator::RADIUS;
+
+	for(int y = firstRow; y < lastRow; y++){
+
+		int *row = out + y * width;
+
+		if(y < R || y >= height - R || width <= 2 * R){
+
+			for(int x = 0; x < width; x++) row[x] = 0;
+
+			continue;
+
+		}
+
+		for(int x = 0; x < R; x++){
+
+			row[x] = 0;
+			row[width - 1 - x] = 0;
+
+		}
+
+		const int *center = pixels + y * width;
+
+		#pragma omp simd
+		for(int x = R; x < width - R; x++){
+
+			int xG = 0;
+			int yG = 0;
+
+			for(int dy = -R; dy <= R; dy++){
+
+				for(int dx = -R; dx <= R; dx++){
+
+					int value = center[x + dx + dy * width];
+
+					xG += Operator::X[dy + R][dx + R] * value;
+
+					if(Operator::GRADIENT) yG += Operator::Y[dy + R][dx + R] * value;
+
+				}
+
+			}
+
+			if(Operator::GRADIENT) row[x] = (int)sqrt((double)xG * xG + (double)yG * yG);
+			else row[x] = abs(xG);
+
+		}
+
+	}
+
+}
+
+//One band of rows per thread, like sobelOpenMP
+template <class Operator>
+inline void stencilOpenMP(const int *pixels, int *out, int width, int height, int numThreads){
+
+	#pragma omp parallel num_threads(numThreads)
+	{
+		int threads = omp_get_num_threads();
+		int threadId = omp_get_thread_num();
+
+		int rowsPerThread = height / threads;
+		int firstRow = threadId * rowsPerThread;
+		int lastRow = threadId < threads - 1 ? firstRow + rowsPerThread : height;
+
+		stencilRows<Operator>(pixels, out, width, height, firstRow, lastRow);
+	}
+
+}
+
+//Run time dispatch to the specialized stencils
+inline void applyStencil(StencilOperator stencil, const int *pixels, int *out, int width, int height,
+		int numThreads){
+
+	switch(stencil){
+
+	case STENCIL_SCHARR:
+		stencilOpenMP<ScharrOperator>(pixels, out, width, height, numThreads);
+		break;
+	case STENCIL_PREWITT:
+		stencilOpenMP<PrewittOperator>(pixels, out, width, height, numThreads);
+		break;
+	case STENCIL_LAPLACIAN:
+		stencilOpenMP<LaplacianOperator>(pixels, out, width, height, numThreads);
+		break;
+	case STENCIL_SOBEL5:
+		stencilOpenMP<Sobel5Operator>(pixels, out, width, height, numThreads);
+		break;
+	default:
+		stencilOpenMP<SobelOperator>(pixels, out, width, height, numThreads);
+		break;
+
+	}
+
+}
+
+#endif /* STENCIL_H_ */
@@ -0,0 +1,398 @@
+#ifndef TILED_H_
+#define TILED_H_
+
+//Adding header files
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <omp.h>
+#include "edgeKernels.h"
+
+//Tiled container for images too large to read whole. The header is
+//followed by an index with the offset, stored size and compression of
+//every tile, then the tiles. A tile holds its pixels row by row, 1 or 2
+//big-endian bytes per sample like P5. The tiles on the right and bottom
+//edges are cut to the image size. Any set of tiles can be read without
+//touching the rest of the file, each with its own pread, so tiles are
+//read in parallel. All numbers are little-endian:
+//  8   "EDTILE1" and a 0 byte
+//  4   width, height, max pixel value, tile size
+//  16  per tile, row major: offset (8), stored size (4), compression (4)
+//benchmark/TiledConvert converts PGM images to and from the container.
+
+const char TILED_MAGIC[8] = {'E', 'D', 'T', 'I', 'L', 'E', '1', '\0'};
+const int TILED_HEADER_BYTES = 24;
+const int TILED_ENTRY_BYTES = 16;
+const int DEFAULT_TILE_SIZE = 256;
+
+//Tiles are stored raw, or with PackBits when that is smaller
+enum TileCompression{
+
+	TILE_RAW = 0,
+	TILE_PACKBITS = 1
+
+};
+
+struct TileEntry{
+
+	unsigned long long offset;
+	unsigned int size;
+	unsigned int compression;
+
+};
+
+struct TiledHeader{
+
+	int width;
+	int height;
+	int maxPixelValue;
+	int tileSize;
+	int tilesX;
+	int tilesY;
+	std::vector<TileEntry> index;
+
+};
+
+//A rectangle of the image, in pixels
+struct Region{
+
+	int x;
+	int y;
+	int width;
+	int height;
+
+};
+
+inline bool regionInside(const Region &region, int width, int height){
+
+	return region.x >= 0 && region.y >= 0 && region.width > 0 && region.height > 0
+			&& region.x <= width - region.width && region.y <= height - region.height;
+
+}
+
+//region grown by margin on every side, kept inside the image
+inline Region expandRegion(const Region &region, int margin, int width, int height){
+
+	Region grown;
+
+	grown.x = region.x > margin ? region.x - margin : 0;
+	grown.y = region.y > margin ? region.y - margin : 0;
+	grown.width = (region.x + region.width + margin < width ? region.x + region.width + margin : width) - grown.x;
+	grown.height = (region.y + region.height + margin < height ? region.y + region.height + margin : height) - grown.y;
+
+	return grown;
+
+}
+
+inline void putLittle(unsigned char *bytes, unsigned long long value, int count){
+
+	for(int i = 0; i < count; i++) bytes[i] = (value >> (8 * i)) & 0xff;
+
+}
+
+inline unsigned long long getLittle(const unsigned char *bytes, int count){
+
+	unsigned long long value = 0;
+
+	for(int i = 0; i < count; i++) value |= (unsigned long long)bytes[i] << (8 * i);
+
+	return value;
+
+}
+
+inline int tileSampleBytes(const TiledHeader &header){
+
+	return header.maxPixelValue > 255 ? 2 : 1;
+
+}
+
+//Pixel rectangle of tile t
+inline Region tileRegion(const TiledHeader &header, int t){
+
+	Region tile;
+
+	tile.x = (t % header.tilesX) * header.tileSize;
+	tile.y = (t / header.tilesX) * header.tileSize;
+	tile.width = header.width - tile.x < header.tileSize ? header.width - tile.x : header.tileSize;
+	tile.height = header.height - tile.y < header.tileSize ? header.height - tile.y : header.tileSize;
+
+	return tile;
+
+}
+
+//Sets tilesX, tilesY and an empty index from the other header fields
+inline void initTiledHeader(TiledHeader &header){
+
+	header.tilesX = (header.width + header.tileSize - 1) / header.tileSize;
+	header.tilesY = (header.height + header.tileSize - 1) / header.tileSize;
+
+	TileEntry empty = {0, 0, TILE_RAW};
+
+	header.index.assign((size_t)header.tilesX * header.tilesY, empty);
+
+}
+
+//PackBits: a control byte n below 128 is followed by n + 1 literal bytes,
+//257 - n copies of the next byte otherwise. Runs of at least 3 are coded
+inline void packBits(const unsigned char *in, size_t count, std::vector<unsigned char> &out){
+
+	out.clear();
+
+	size_t i = 0;
+
+	while(i < count){
+
+		size_t run = 1;
+
+		while(i + run < count && run < 128 && in[i + run] == in[i]) run++;
+
+		if(run >= 3){
+
+			out.push_back((unsigned char)(257 - run));
+			out.push_back(in[i]);
+
+			i += run;
+
+			continue;
+
+		}
+
+		//Literals up to the next run of 3
+		size_t literal = 0;
+
+		while(i + literal < count && literal < 128){
+
+			if(i + literal + 2 < count && in[i + literal] == in[i + literal + 1]
+					&& in[i + literal] == in[i + literal + 2]) break;
+
+			literal++;
+
+		}
+
+		out.push_back((unsigned char)(literal - 1));
+		out.insert(out.end(), in + i, in + i + literal);
+
+		i += literal;
+
+	}
+
+}
+
+//False when the data does not decode to exactly count bytes
+inline bool unpackBits(const unsigned char *in, size_t size, unsigned char *out, size_t count){
+
+	size_t i = 0;
+	size_t o = 0;
+
+	while(i < size){
+
+		int control = in[i++];
+
+		if(control < 128){
+
+			size_t literal = control + 1;
+
+			if(i + literal > size || o + literal > count) return false;
+
+			memcpy(out + o, in + i, literal);
+
+			i += literal;
+			o += literal;
+
+		}else{
+
+			size_t run = 257 - control;
+
+			if(i >= size || o + run > count) return false;
+
+			memset(out + o, in[i++], run);
+
+			o += run;
+
+		}
+
+	}
+
+	return o == count;
+
+}
+
+//Header and index of an open container, false when it is not one
+inline bool readTiledHeader(int fd, TiledHeader &header){
+
+	unsigned char bytes[TILED_HEADER_BYTES];
+
+	if(pread(fd, bytes, TILED_HEADER_BYTES, 0) != TILED_HEADER_BYTES
+			|| memcmp(bytes, TILED_MAGIC, sizeof(TILED_MAGIC)) != 0) return false;
+
+	header.width = (int)getLittle(bytes + 8, 4);
+	header.height = (int)getLittle(bytes + 12, 4);
+	header.maxPixelValue = (int)getLittle(bytes + 16, 4);
+	header.tileSize = (int)getLittle(bytes + 20, 4);
+
+	if(header.width <= 0 || header.height <= 0 || header.tileSize <= 0
+			|| header.maxPixelValue < 0 || header.maxPixelValue > 65535) return false;
+
+	initTiledHeader(header);
+
+	size_t indexBytes = header.index.size() * TILED_ENTRY_BYTES;
+
+	std::vector<unsigned char> index(indexBytes);
+
+	if(pread(fd, &index[0], indexBytes, TILED_HEADER_BYTES) != (ssize_t)indexBytes) return false;
+
+	for(size_t t = 0; t < header.index.size(); t++){
+
+		const unsigned char *entry = &index[t * TILED_ENTRY_BYTES];
+
+		header.index[t].offset = getLittle(entry, 8);
+		header.index[t].size = (unsigned int)getLittle(entry + 8, 4);
+		header.index[t].compression = (unsigned int)getLittle(entry + 12, 4);
+
+	}
+
+	return true;
+
+}
+
+//Header and index at the start of the file, the tiles go after them
+inline bool writeTiledHeader(FILE *fp, const TiledHeader &header){
+
+	std::vector<unsigned char> bytes(TILED_HEADER_BYTES + header.index.size() * TILED_ENTRY_BYTES);
+
+	memcpy(&bytes[0], TILED_MAGIC, sizeof(TILED_MAGIC));
+
+	putLittle(&bytes[8], header.width, 4);
+	putLittle(&bytes[12], header.height, 4);
+	putLittle(&bytes[16], header.maxPixelValue, 4);
+	putLittle(&bytes[20], header.tileSize, 4);
+
+	for(size_t t = 0; t < header.index.size(); t++){
+
+		unsigned char *entry = &bytes[TILED_HEADER_BYTES + t * TILED_ENTRY_BYTES];
+
+		putLittle(entry, header.index[t].offset, 8);
+		putLittle(entry + 8, header.index[t].size, 4);
+		putLittle(entry + 12, header.index[t].compression, 4);
+
+	}
+
+	return fseek(fp, 0, SEEK_SET) == 0 && fwrite(&bytes[0], 1, bytes.size(), fp) == bytes.size();
+
+}
+
+//True when the file starts with the container magic
+inline bool isTiled(const char *fileName){
+
+	char magic[sizeof(TILED_MAGIC)];
+
+	FILE *fp = fopen(fileName, "rb");
+
+	if(!fp) return false;
+
+	bool tiled = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, TILED_MAGIC, sizeof(magic)) == 0;
+
+	fclose(fp);
+
+	return tiled;
+
+}
+
+//Samples of tile t into samples, which holds the whole tile
+inline bool readTile(int fd, const TiledHeader &header, int t, unsigned char *samples,
+		std::vector<unsigned char> &stored){
+
+	Region tile = tileRegion(header, t);
+
+	size_t count = (size_t)tile.width * tile.height * tileSampleBytes(header);
+
+	const TileEntry &entry = header.index[t];
+
+	if(entry.compression == TILE_RAW){
+
+		return entry.size == count && pread(fd, samples, count, entry.offset) == (ssize_t)count;
+
+	}
+
+	stored.resize(entry.size);
+
+	if(entry.compression != TILE_PACKBITS || entry.size == 0
+			|| pread(fd, &stored[0], entry.size, entry.offset) != (ssize_t)entry.size) return false;
+
+	return unpackBits(&stored[0], entry.size, samples, count);
+
+}
+
+//Pixels of region from every tile it touches, one tile per loop
+//iteration. region must lie inside the image, pixels holds its pixels
+inline void readTiledRegion(int fd, const TiledHeader &header, const Region &region, int *pixels,
+		int numThreads){
+
+	int firstX = region.x / header.tileSize;
+	int firstY = region.y / header.tileSize;
+	int lastX = (region.x + region.width - 1) / header.tileSize;
+	int lastY = (region.y + region.height - 1) / header.tileSize;
+
+	int columns = lastX - firstX + 1;
+	int count = columns * (lastY - firstY + 1);
+
+	int sampleBytes = tileSampleBytes(header);
+
+	bool failed = false;
+
+	#pragma omp parallel num_threads(numThreads)
+	{
+		std::vector<unsigned char> samples((size_t)header.tileSize * header.tileSize * sampleBytes);
+		std::vector<unsigned char> stored;
+
+		#pragma omp for schedule(dynamic)
+		for(int i = 0; i < count; i++){
+
+			int t = (firstY + i / columns) * header.tilesX + firstX + i % columns;
+
+			if(!readTile(fd, header, t, &samples[0], stored)){
+
+				#pragma omp atomic write
+				failed = true;
+
+				continue;
+
+			}
+
+			Region tile = tileRegion(header, t);
+
+			//Overlap of the tile and the region
+			int x0 = tile.x > region.x ? tile.x : region.x;
+			int y0 = tile.y > region.y ? tile.y : region.y;
+			int x1 = tile.x + tile.width < region.x + region.width ? tile.x + tile.width : region.x + region.width;
+			int y1 = tile.y + tile.height < region.y + region.height ? tile.y + tile.height : region.y + region.height;
+
+			for(int y = y0; y < y1; y++){
+
+				const unsigned char *row = &samples[((size_t)(y - tile.y) * tile.width + x0 - tile.x) * sampleBytes];
+				int *out = pixels + (size_t)(y - region.y) * region.width + x0 - region.x;
+
+				if(sampleBytes == 2) unpackPixels16(row, out, x1 - x0);
+				else unpackPixels(row, out, x1 - x0);
+
+			}
+
+		}
+	}
+
+	if(failed){
+
+		std::cerr << "Error: cannot read tiles." << std::endl;
+
+		exit(1000);
+
+	}
+
+}
+
+#endif /* TILED_H_ */
@@ -1,13 +1,35 @@
 #include <iostream>
 #include <math.h>
+#include <limits.h>
 #include <fstream>
 #include <vector>
 #include <sstream>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+#include "stageTimer.h"
 
 using namespace std;
 
+//Filled by the scoped timers of each stage when -stages is given
+StageTimes stageTimes;
+
+//Largest sample of a PGM, samples above 255 take two bytes
+const int MAX_PGM_VALUE = 65535;
+
+//Integer BT.601 luma weights of colour input, they sum to 1 << LUMA_SHIFT
+const int LUMA_RED = 77;
+const int LUMA_GREEN = 150;
+const int LUMA_BLUE = 29;
+const int LUMA_SHIFT = 8;
+
+//Grey value of one RGB sample, rounded
+int lumaPixel(int red, int green, int blue){
+
+	return (LUMA_RED * red + LUMA_GREEN * green + LUMA_BLUE * blue + (1 << (LUMA_SHIFT - 1))) >> LUMA_SHIFT;
+
+}
+
 //Creating image class (base class)
 class Image{
 
@@ -17,6 +39,7 @@ public:
 		height(0),
 		width(0),
 		maxPixelValue(0),
+		color(false),
 		minpix(0),
 		maxpix(0),
 		imageSize(0){}
@@ -27,17 +50,20 @@ public:
 
 	void readHeader(ifstream &inFile);
 	void scaleImage();
+	void rawImage();
 	void edgeDection();
 
 	//Accessor methods
 	int getHeight(){return height;}
 	int getWidth(){return width;}
 	int getMaxPixelValue(){return maxPixelValue;}
+	bool isColor(){return color;}
 
 	//Mutator methods
 	void setHeight(int h){height = h;}
 	void setWidth(int w){width = w;}
 	void setMaxPixelValue(int mpv){maxPixelValue = mpv;}
+	void setColor(bool c){color = c;}
 
 	//Member variables
 protected:
@@ -45,6 +71,8 @@ protected:
 	int height;
 	int width;
 	int maxPixelValue;
+	//P3 and P6 input, converted to grey while it is read
+	bool color;
 	int minpix;
 	int maxpix;
 	unsigned int imageSize;
@@ -99,6 +127,8 @@ bool isComment(string comment){
 //Reads binary pixel values in image
 void BinaryImage::readImage(ifstream &inFile){
 
+	ScopedStageTimer timer(stageTimes, "read");
+
 	//Check if the file stream in open
 	if(!inFile){
 
@@ -108,11 +138,21 @@ void BinaryImage::readImage(ifstream &inFile){
 
 	}
 
+	//Samples above 255 take two bytes, most significant first
+	unsigned int bytesPerSample = maxPixelValue > 255 ? 2 : 1;
+
+	//RGB triplets carry three samples per pixel
+	unsigned int samplesPerPixel = color ? 3 : 1;
+
+	//Up to 6 bytes per pixel, counted in size_t as they overflow 32 bits
+	//on large 16 bit colour images
+	size_t byteCount = (size_t)imageSize * samplesPerPixel * bytesPerSample;
+
 	//Making a temp array, and putting it on the heap
-	char * byteArray = new char[imageSize + 1];
+	char * byteArray = new char[byteCount + 1];
 
 	//Read the bytes of the image, and puts data in byteArray
-	inFile.read(byteArray, imageSize);
+	inFile.read(byteArray, byteCount);
 
 	//If reading in the data failed, return an error
 	if(inFile.fail()){
@@ -124,13 +164,45 @@ void BinaryImage::readImage(ifstream &inFile){
 	}
 
 	//Set the last element in array to EOF character
-	byteArray[imageSize] = '\0';
+	byteArray[byteCount] = '\0';
 
 	//Put the data read from file into pixels
 	for(unsigned int i = 0; i < imageSize; i++){
 
-		pixels.push_back(static_cast<int>
-		(static_cast<unsigned char>(byteArray[i])));
+		if(color){
+
+			int rgb[3];
+
+			for(int c = 0; c < 3; c++){
+
+				size_t sample = 3 * (size_t)i + c;
+
+				if(bytesPerSample == 2){
+
+					rgb[c] = (static_cast<unsigned char>(byteArray[2 * sample]) << 8)
+							| static_cast<unsigned char>(byteArray[2 * sample + 1]);
+
+				}else{
+
+					rgb[c] = static_cast<unsigned char>(byteArray[sample]);
+
+				}
+
+			}
+
+			pixels.push_back(lumaPixel(rgb[0], rgb[1], rgb[2]));
+
+		}else if(bytesPerSample == 2){
+
+			pixels.push_back((static_cast<unsigned char>(byteArray[2 * (size_t)i]) << 8)
+					| static_cast<unsigned char>(byteArray[2 * (size_t)i + 1]));
+
+		}else{
+
+			pixels.push_back(static_cast<int>
+			(static_cast<unsigned char>(byteArray[i])));
+
+		}
 
 	}
 
@@ -142,6 +214,8 @@ void BinaryImage::readImage(ifstream &inFile){
 //Writes binary pixels to output file
 void BinaryImage::writeImage(ofstream &outFile){
 
+	ScopedStageTimer timer(stageTimes, "write");
+
 	//Check if the file stream is open
 	if(!outFile){
 
@@ -157,18 +231,34 @@ void BinaryImage::writeImage(ofstream &outFile){
 			height        << " "  <<
 			maxPixelValue << endl;
 
+	unsigned int bytesPerSample = maxPixelValue > 255 ? 2 : 1;
+
+	size_t byteCount = (size_t)imageSize * bytesPerSample;
+
 	//Take all pixel values from pixels and writes it to output file
-	char * byteArray = new char[imageSize + 1];
+	char * byteArray = new char[byteCount + 1];
 
 	for(unsigned int i = 0; i < imageSize; i++){
 
-		byteArray[i] = static_cast<char>(pixels[i]);
+		if(bytesPerSample == 2){
+
+			//Big-endian, saturated to the 16 bit range
+			int value = pixels[i] < 0 ? 0 : (pixels[i] > MAX_PGM_VALUE ? MAX_PGM_VALUE : pixels[i]);
+
+			byteArray[2 * (size_t)i] = static_cast<char>(value >> 8);
+			byteArray[2 * (size_t)i + 1] = static_cast<char>(value & 0xff);
+
+		}else{
+
+			byteArray[i] = static_cast<char>(pixels[i]);
+
+		}
 
 	}
 
-	byteArray[imageSize] = '\0';
+	byteArray[byteCount] = '\0';
 
-	outFile.write(byteArray, imageSize);
+	outFile.write(byteArray, byteCount);
 
 	if(outFile.fail()){
 
@@ -184,6 +274,8 @@ void BinaryImage::writeImage(ofstream &outFile){
 
 void AsciiImage::readImage(ifstream &inFile){
 
+	ScopedStageTimer timer(stageTimes, "read");
+
 	//Check if the file opened properly
 	if(!inFile){
 
@@ -196,9 +288,24 @@ void AsciiImage::readImage(ifstream &inFile){
 	int pixelValue;
 
 	//Read in the Ascii values from file
-	while(inFile >> pixelValue){
+	if(color){
+
+		int green;
+		int blue;
+
+		while(inFile >> pixelValue >> green >> blue){
+
+			pixels.push_back(lumaPixel(pixelValue, green, blue));
+
+		}
+
+	}else{
+
+		while(inFile >> pixelValue){
 
-		pixels.push_back(pixelValue);
+			pixels.push_back(pixelValue);
+
+		}
 
 	}
 
@@ -208,6 +315,8 @@ void AsciiImage::readImage(ifstream &inFile){
 
 void AsciiImage::writeImage(ofstream &outFile){
 
+	ScopedStageTimer timer(stageTimes, "write");
+
 	//Check if file is open
 	if(!outFile){
 
@@ -237,6 +346,8 @@ void AsciiImage::writeImage(ofstream &outFile){
 
 void Image::readHeader(ifstream &inFile){
 
+	ScopedStageTimer timer(stageTimes, "header");
+
 	stringstream sStream;
 
 	string line;
@@ -330,6 +441,15 @@ void Image::readHeader(ifstream &inFile){
 
 	}
 
+	//Pixels are indexed with int, larger images would overflow it
+	if(width > INT_MAX / height){
+
+		cerr << "Error: image too large, width * height must fit in an int" << endl;
+
+		exit(1002);
+
+	}
+
 	//Check if there are any comments between height/width and maxPixelValue
 	while(getline(inFile, line)){
 
@@ -367,7 +487,7 @@ void Image::readHeader(ifstream &inFile){
 
 	}
 
-	if(maxPixelValue < 0 || maxPixelValue > 255){
+	if(maxPixelValue < 0 || maxPixelValue > MAX_PGM_VALUE){
 
 		cerr << errorMessage << endl;
 		cerr << "Invalid max pixel value." << endl;
@@ -425,9 +545,15 @@ void Image::scaleImage(){
 
 	int newPixelValue = 0;
 
-	findMin();
+	{
+		ScopedStageTimer timer(stageTimes, "minmax");
+
+		findMin();
+
+		findMax();
+	}
 
-	findMax();
+	ScopedStageTimer timer(stageTimes, "scale");
 
 	for(unsigned int i = 0; i < imageSize; i++){
 
@@ -443,9 +569,31 @@ void Image::scaleImage(){
 
 }
 
+//Keeps the magnitudes for -raw, saturated to the 16 bit PGM range. The
+//largest one becomes maxval, so weak edges still give an 8 bit image
+void Image::rawImage(){
+
+	ScopedStageTimer timer(stageTimes, "scale");
+
+	int maxVal = 1;
+
+	for(unsigned int i = 0; i < imageSize; i++){
+
+		if(pixels[i] > MAX_PGM_VALUE) pixels[i] = MAX_PGM_VALUE;
+
+		if(pixels[i] > maxVal) maxVal = pixels[i];
+
+	}
+
+	maxPixelValue = maxVal;
+
+}
+
 //Sobel edge detection function - detects edges and draws an outline
 void Image::edgeDection(){
 
+	ScopedStageTimer timer(stageTimes, "sobel");
+
 	int x = 0, y = 0;
 
 	int xG = 0, yG = 0;
@@ -483,8 +631,9 @@ void Image::edgeDection(){
 										   - (2 * pixels[(x) + ((y-1) * width)])
 										   - pixels[(x+1) + ((y-1) * width)]);
 
-			//newPixel = sqrt(xG^2 + yG^2)
-			tempImage[i] = sqrt((xG * xG) + (yG * yG));
+			//newPixel = sqrt(xG^2 + yG^2), squared in double since the
+			//gradients of 16 bit images overflow an int when squared
+			tempImage[i] = sqrt((double)xG * xG + (double)yG * yG);
 
 		}else{
 
@@ -504,39 +653,66 @@ void Image::edgeDection(){
 
 }
 
-bool isBinary(ifstream &inFile);
+bool isBinary(ifstream &inFile, bool &color);
 
-void run(char **argv);
+void run(char **argv, bool raw);
 
 int main(int argc, char **argv){
 
-	if(argc != 3){
+	string usage = "Usage: EdgeDetection imageName.pgm output.pgm [-raw] [-stages times.csv|times.json] [-counters]";
 
-		cerr << "Usage: EdgeDetection imageName.pgm output.pgm";
+	string stagesName;
 
-		return 1;
+	bool hardwareCounters = false;
+
+	//Write the magnitudes unscaled, 16 bit when they exceed 255
+	bool raw = false;
+
+	//Optional flags follow the positional arguments
+	for(int arg = 3; arg < argc; arg++){
+
+		if(strcmp(argv[arg], "-stages") == 0 && arg + 1 < argc){
+
+			stagesName = argv[++arg];
+
+		}else if(strcmp(argv[arg], "-raw") == 0){
+
+			raw = true;
+
+		}else if(strcmp(argv[arg], "-counters") == 0){
+
+			hardwareCounters = true;
+
+		}else{
+
+			cerr << usage;
+
+			return 1;
+
+		}
 
 	}
 
-	//long start, end;
+	if(argc < 3){
 
-	//double total;
+		cerr << usage;
 
-	//start = clock();
+		return 1;
 
-	run(argv);
+	}
 
-	//end = clock();
+	if(!stagesName.empty()) stageTimes.enable(hardwareCounters);
 
-	//total = (double)(end - start)/1000;
+	run(argv, raw);
 
-	//cout << "Execution time: " << total << endl;
+	if(!stagesName.empty()) stageTimes.write(stagesName);
 
 	return 0;
 }
 
 
-bool isBinary(ifstream &inFile){
+//P5 and P6 are binary, P3 and P6 set color
+bool isBinary(ifstream &inFile, bool &color){
 
 	char readChar = ' ';
 
@@ -553,9 +729,9 @@ bool isBinary(ifstream &inFile){
 
 	}
 
-	//If there is no character or the second character is not a 2 or 5
+	//If there is no character or the second character is not a 2, 3, 5 or 6
 	//then return an error
-	if(!(inFile >> readChar) || ( readChar != '2' && readChar != '5')){
+	if(!(inFile >> readChar) || ( readChar != '2' && readChar != '3' && readChar != '5' && readChar != '6')){
 
 		cerr << errorMessage << endl;
 		cerr << readChar << endl;
@@ -564,13 +740,15 @@ bool isBinary(ifstream &inFile){
 
 	}
 
-	if(readChar == '5') return true;
+	color = readChar == '3' || readChar == '6';
+
+	if(readChar == '5' || readChar == '6') return true;
 
 	return false;
 
 }
 
-void run(char **argv){
+void run(char **argv, bool raw){
 
 	ifstream inFile;
 
@@ -582,17 +760,22 @@ void run(char **argv){
 			            | ios::out
 						| ios::trunc);
 
-	if(isBinary(inFile)){
+	bool color = false;
+
+	if(isBinary(inFile, color)){
 
 		BinaryImage binaryImage;
 
+		binaryImage.setColor(color);
+
 		binaryImage.readHeader(inFile);
 
 		binaryImage.readImage(inFile);
 
 		binaryImage.edgeDection();
 
-		binaryImage.scaleImage();
+		if(raw) binaryImage.rawImage();
+		else binaryImage.scaleImage();
 
 		binaryImage.writeImage(outFile);
 
@@ -600,13 +783,16 @@ void run(char **argv){
 
 		AsciiImage asciiImage;
 
+		asciiImage.setColor(color);
+
 		asciiImage.readHeader(inFile);
 
 		asciiImage.readImage(inFile);
 
 		asciiImage.edgeDection();
 
-		asciiImage.scaleImage();
+		if(raw) asciiImage.rawImage();
+		else asciiImage.scaleImage();
 
 		asciiImage.writeImage(outFile);
 
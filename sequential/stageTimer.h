@@ -0,0 +1,229 @@
+#ifndef STAGETIMER_H_
+#define STAGETIMER_H_
+
+//Adding header files
+#include <iostream>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+using namespace std;
+
+//Wall time and, with -counters, hardware counters of each pipeline stage.
+//Counters are opened with perf_event_open for the calling thread only, so
+//work done by OpenMP worker threads shows up in the time but not the counts
+class StageTimes{
+
+public:
+
+	//Hardware events read at the start and end of every stage
+	enum{CYCLES = 0, INSTRUCTIONS = 1, CACHE_MISSES = 2, COUNTER_COUNT = 3};
+
+	StageTimes():
+		enabled(false),
+		counters(false){
+
+		for(int c = 0; c < COUNTER_COUNT; c++) fds[c] = -1;
+
+	}
+	~StageTimes(){
+
+		for(int c = 0; c < COUNTER_COUNT; c++){
+			if(fds[c] >= 0) close(fds[c]);
+		}
+
+	}
+
+	//Starts collecting, counters are skipped with a warning when the kernel
+	//does not allow them (see /proc/sys/kernel/perf_event_paranoid)
+	void enable(bool hardwareCounters){
+
+		enabled = true;
+
+		if(!hardwareCounters) return;
+
+		unsigned long long configs[COUNTER_COUNT] = {PERF_COUNT_HW_CPU_CYCLES,
+				PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+
+		counters = true;
+
+		for(int c = 0; c < COUNTER_COUNT; c++){
+
+			struct perf_event_attr attr;
+
+			memset(&attr, 0, sizeof(attr));
+
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.size = sizeof(attr);
+			attr.config = configs[c];
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+
+			fds[c] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+
+			if(fds[c] < 0) counters = false;
+
+		}
+
+		if(!counters){
+
+			cerr << "Warning: hardware counters are not available, only times are reported." << endl;
+
+		}
+
+	}
+
+	//Current value of every counter, zeros without counters
+	void readCounters(long long *values){
+
+		for(int c = 0; c < COUNTER_COUNT; c++){
+
+			values[c] = 0;
+
+			if(counters && read(fds[c], &values[c], sizeof(long long)) != sizeof(long long)) values[c] = 0;
+
+		}
+
+	}
+
+	void add(const char *name, double seconds, const long long *deltas){
+
+		Stage stage;
+
+		stage.name = name;
+		stage.milliseconds = seconds * 1e3;
+
+		for(int c = 0; c < COUNTER_COUNT; c++) stage.counts[c] = deltas[c];
+
+		stages.push_back(stage);
+
+	}
+
+	//Files ending in .json are written as JSON, any other name as a
+	//semicolon separated CSV. Counter columns are -1 without -counters
+	void write(const string &fileName){
+
+		bool json = fileName.size() >= 5 && fileName.compare(fileName.size() - 5, 5, ".json") == 0;
+
+		FILE *fp = fopen(fileName.c_str(), "w");
+
+		if(!fp){
+
+			cerr << "Error: cannot write stage times " << fileName << endl;
+
+			exit(1);
+
+		}
+
+		if(json) fprintf(fp, "{\n\t\"stages\": [\n");
+		else fprintf(fp, "stage;ms;cycles;instructions;cache_misses\n");
+
+		for(unsigned int s = 0; s < stages.size(); s++){
+
+			long long counts[COUNTER_COUNT];
+
+			for(int c = 0; c < COUNTER_COUNT; c++) counts[c] = counters ? stages[s].counts[c] : -1;
+
+			if(json){
+
+				fprintf(fp, "\t\t{\"stage\": \"%s\", \"ms\": %.6f, \"cycles\": %lld, \"instructions\": %lld,"
+						" \"cache_misses\": %lld}%s\n", stages[s].name.c_str(), stages[s].milliseconds,
+						counts[CYCLES], counts[INSTRUCTIONS], counts[CACHE_MISSES],
+						s + 1 < stages.size() ? "," : "");
+
+			}else{
+
+				fprintf(fp, "%s;%.6f;%lld;%lld;%lld\n", stages[s].name.c_str(), stages[s].milliseconds,
+						counts[CYCLES], counts[INSTRUCTIONS], counts[CACHE_MISSES]);
+
+			}
+
+		}
+
+		if(json) fprintf(fp, "\t]\n}\n");
+
+		fclose(fp);
+
+	}
+
+	bool enabled;
+
+private:
+
+	struct Stage{
+
+		string name;
+		double milliseconds;
+		long long counts[COUNTER_COUNT];
+
+	};
+
+	vector<Stage> stages;
+
+	bool counters;
+	int fds[COUNTER_COUNT];
+
+};
+
+//Times the scope it is declared in and adds it to times under name,
+//does nothing unless times is enabled
+class ScopedStageTimer{
+
+public:
+
+	ScopedStageTimer(StageTimes &t, const char *n):
+		times(t),
+		name(n),
+		start(0.0){
+
+		if(!times.enabled) return;
+
+		times.readCounters(startCounts);
+
+		start = now();
+
+	}
+	~ScopedStageTimer(){
+
+		if(!times.enabled) return;
+
+		double elapsed = now() - start;
+
+		long long counts[StageTimes::COUNTER_COUNT];
+
+		times.readCounters(counts);
+
+		for(int c = 0; c < StageTimes::COUNTER_COUNT; c++) counts[c] -= startCounts[c];
+
+		times.add(name, elapsed, counts);
+
+	}
+
+private:
+
+	//Monotonic wall clock in seconds
+	static double now(){
+
+		struct timespec ts;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+
+		return ts.tv_sec + ts.tv_nsec * 1e-9;
+
+	}
+
+	StageTimes &times;
+	const char *name;
+	double start;
+	long long startCounts[StageTimes::COUNTER_COUNT];
+
+};
+
+#endif /* STAGETIMER_H_ */